@@ -110,6 +110,28 @@ static const struct node_mapping *lookup_map(const char *type)
 	return NULL;
 }
 
+/* optional functions of a user-defined type, besides parse, dump and free */
+static const char *known_hooks[] = {
+	"bdump",	/* dump into a struct dump_buffer */
+	"batch",	/* parse an array at once, free must do nothing */
+	"hash",		/* hash of a value, equal values hash the same */
+	"equal",	/* nonzero if two values are equal */
+	"pack",		/* move storage into a struct config_pack */
+	"bounded",	/* parse into a char[cap], -ENOSPC if it does not fit */
+	NULL,
+};
+
+static string lookup_hook(const struct node_mapping *map, const char *name)
+{
+	const struct node_hook_list *cur;
+	for (cur = map->hooks; cur; cur = cur->next) {
+		if (!strcmp(cur->name, name)) {
+			return cur->func;
+		}
+	}
+	return NULL;
+}
+
 static const struct node_type_def_list *lookup_enum(const char *name)
 {
 	const struct node_type_def_list *l;
@@ -327,6 +349,428 @@ static void verify_def_union(const struct node_alter_list *list,
 	}
 }
 
+/* the structs config_apply_* can reach by scalar struct members */
+static void mark_applied(struct node_type_def_list *def)
+{
+	const struct node_member_list *memb;
+
+	if (def->struct_def.applied) {
+		return;
+	}
+	def->struct_def.applied = 1;
+	for (memb = def->struct_def.members; memb; memb = memb->next) {
+		if (memb->type == NODE_MEMBER_DEF_STRUCT &&
+				memb->vec.type == NODE_TYPE_SCALE) {
+			mark_applied((struct node_type_def_list *)
+					lookup_struct(memb->type_name));
+		}
+	}
+}
+
+static void mark_applied_list(struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		if (list->type == NODE_TYPE_DEF_STRUCT &&
+				list->struct_def.exported) {
+			mark_applied(list);
+		}
+	}
+}
+
+static void check_unshared_alters(string root,
+		const struct node_alter_list *list);
+
+/*
+ * A subtree moved by config_reparse_* must own all of its storage, copies of
+ * a shared struct do not.
+ */
+static void check_unshared_members(string root,
+		const struct node_member_list *list)
+{
+	const struct node_type_def_list *def;
+
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_MEMBER_DEF_STRUCT:
+			def = lookup_struct(list->type_name);
+			if (def->struct_def.shared) {
+				fprintf(stderr, "struct %s: incremental, but "
+						"reaches shared struct %s\n",
+						root, def->struct_def.name);
+				exit(EXIT_FAILURE);
+			}
+			check_unshared_members(root, def->struct_def.members);
+			break;
+		case NODE_MEMBER_DEF_UNION:
+			def = lookup_union(list->type_name);
+			check_unshared_alters(root, def->union_def.alters);
+			break;
+		case NODE_MEMBER_DEF_UNNAMED_UNION:
+			check_unshared_alters(root, list->alters);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void check_unshared_alters(string root,
+		const struct node_alter_list *list)
+{
+	const struct node_type_def_list *def;
+
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_ALTER_DEF_STRUCT:
+			def = lookup_struct(list->type_name);
+			if (def->struct_def.shared) {
+				fprintf(stderr, "struct %s: incremental, but "
+						"reaches shared struct %s\n",
+						root, def->struct_def.name);
+				exit(EXIT_FAILURE);
+			}
+			check_unshared_members(root, def->struct_def.members);
+			break;
+		case NODE_ALTER_DEF_UNNAMED_STRUCT:
+			check_unshared_members(root, list->members);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * the structs config_reparse_* can reuse: reached by struct members and
+ * arrays of them, union alternatives are always reconverted
+ */
+static void mark_reparsed(struct node_type_def_list *def)
+{
+	const struct node_member_list *memb;
+
+	if (def->struct_def.reparsed) {
+		return;
+	}
+	def->struct_def.reparsed = 1;
+	for (memb = def->struct_def.members; memb; memb = memb->next) {
+		if (memb->type == NODE_MEMBER_DEF_STRUCT) {
+			mark_reparsed((struct node_type_def_list *)
+					lookup_struct(memb->type_name));
+		}
+	}
+}
+
+static void mark_reparsed_list(struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		if (list->type != NODE_TYPE_DEF_STRUCT ||
+				!list->struct_def.incremental) {
+			continue;
+		}
+		if (list->struct_def.shared) {
+			fprintf(stderr, "struct %s: shared and incremental "
+					"can not be combined\n",
+					list->struct_def.name);
+			exit(EXIT_FAILURE);
+		}
+		check_unshared_members(list->struct_def.name,
+				list->struct_def.members);
+		mark_reparsed(list);
+	}
+}
+
+static void check_arena_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		if (list->type != NODE_TYPE_DEF_STRUCT) {
+			continue;
+		}
+		if (list->struct_def.allocator && !list->struct_def.exported) {
+			fprintf(stderr, "struct %s: allocator, but not exported\n",
+					list->struct_def.name);
+			exit(EXIT_FAILURE);
+		}
+		if (!list->struct_def.arena) {
+			continue;
+		}
+		if (!list->struct_def.exported) {
+			fprintf(stderr, "struct %s: arena, but not exported\n",
+					list->struct_def.name);
+			exit(EXIT_FAILURE);
+		}
+		if (list->struct_def.incremental) {
+			fprintf(stderr, "struct %s: arena and incremental "
+					"can not be combined\n",
+					list->struct_def.name);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/*
+ * [<= cap] of a type without a bounded hook is a variable length array of
+ * up to cap elements, its length being <name>_len.
+ */
+static void resolve_bounded(struct node_vec_def *vec, string in_name,
+		string prim_type)
+{
+	const struct node_mapping *map;
+
+	if (vec->type != NODE_TYPE_BOUNDED) {
+		return;
+	}
+	map = prim_type ? lookup_map(prim_type) : NULL;
+	if (map && lookup_hook(map, "bounded")) {
+		return;
+	}
+	if (vec->spill) {
+		fprintf(stderr, "member %s: only a value of a type with a "
+				"bounded hook can spill\n", in_name);
+		exit(EXIT_FAILURE);
+	}
+	vec->type = NODE_TYPE_VAR_ARR;
+	vec->len_str = make_message("%s_len", in_name);
+}
+
+static void resolve_bounded_alters(struct node_alter_list *alt);
+
+static void resolve_bounded_members(struct node_member_list *memb)
+{
+	for (; memb; memb = memb->next) {
+		if (memb->type == NODE_MEMBER_DEF_UNNAMED_UNION) {
+			resolve_bounded_alters(memb->alters);
+			continue;
+		}
+		resolve_bounded(&memb->vec, memb->in_name,
+				memb->type == NODE_MEMBER_DEF_PRIM ?
+				memb->type_name : NULL);
+	}
+}
+
+static void resolve_bounded_alters(struct node_alter_list *alt)
+{
+	for (; alt; alt = alt->next) {
+		if (alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			resolve_bounded_members(alt->members);
+			continue;
+		}
+		resolve_bounded(&alt->vec, alt->in_name,
+				alt->type == NODE_ALTER_DEF_PRIM ?
+				alt->type_name : NULL);
+	}
+}
+
+static void resolve_bounded_list(struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		if (list->type == NODE_TYPE_DEF_STRUCT) {
+			resolve_bounded_members(list->struct_def.members);
+		} else if (list->type == NODE_TYPE_DEF_UNION) {
+			resolve_bounded_alters(list->union_def.alters);
+		}
+	}
+}
+
+/* whether a member of type decl in storage vec allocates when converted */
+static int allocates(const struct node_vec_def *vec, string prim_type)
+{
+	if (vec->type == NODE_TYPE_VAR_ARR && !vec->cap) {
+		return 1;
+	}
+	if (vec->type == NODE_TYPE_BOUNDED && vec->spill) {
+		return 1;
+	}
+	/* a type with storage of its own can be packed or bounded */
+	return prim_type && vec->type != NODE_TYPE_BOUNDED &&
+		(lookup_hook(lookup_map(prim_type), "pack") ||
+		 lookup_hook(lookup_map(prim_type), "bounded"));
+}
+
+static void check_bound(string name, string in_name, string prim_type,
+		const struct node_vec_def *vec)
+{
+	if (vec->type == NODE_TYPE_BOUNDED && (!prim_type ||
+				!lookup_hook(lookup_map(prim_type), "bounded"))) {
+		fprintf(stderr, "member %s.%s: its type has no bounded hook\n",
+				name, in_name);
+		exit(EXIT_FAILURE);
+	}
+	if ((vec->type == NODE_TYPE_BOUNDED ||
+				vec->type == NODE_TYPE_VAR_ARR) &&
+			vec->cap < 0) {
+		fprintf(stderr, "member %s.%s: capacity is negative\n",
+				name, in_name);
+		exit(EXIT_FAILURE);
+	}
+	if (vec->type == NODE_TYPE_BOUNDED && !vec->cap) {
+		fprintf(stderr, "member %s.%s: capacity is 0\n",
+				name, in_name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+struct fixed_path {
+	const struct fixed_path *up;
+	string name;
+};
+
+static void check_fixed_alters(string top, const struct node_alter_list *alt,
+		string name, const struct fixed_path *path);
+static void check_fixed_struct(string top, string name,
+		const struct fixed_path *path);
+
+/*
+ * Checks the bounds of the members of the struct or union name, and with
+ * top, the name of a fixed struct, that none of them allocates.
+ */
+static void check_fixed_members(string top,
+		const struct node_member_list *memb, string name,
+		const struct fixed_path *path)
+{
+	const struct node_type_def_list *def;
+	const struct fixed_path *p;
+	struct fixed_path here = {path, name};
+
+	for (p = path; p; p = p->up) {
+		if (!strcmp(p->name, name)) {
+			fprintf(stderr, "struct %s: fixed, but %s reaches "
+					"itself\n", top, name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (; memb; memb = memb->next) {
+		if (memb->type == NODE_MEMBER_DEF_UNNAMED_UNION) {
+			check_fixed_alters(top, memb->alters, name, &here);
+			continue;
+		}
+		check_bound(name, memb->in_name,
+				memb->type == NODE_MEMBER_DEF_PRIM ?
+				memb->type_name : NULL, &memb->vec);
+		if (!top) {
+			continue;
+		}
+		if (allocates(&memb->vec, memb->type == NODE_MEMBER_DEF_PRIM ?
+					memb->type_name : NULL)) {
+			fprintf(stderr, "struct %s: fixed, but %s.%s "
+					"allocates\n", top, name, memb->in_name);
+			exit(EXIT_FAILURE);
+		}
+		if (memb->type == NODE_MEMBER_DEF_STRUCT) {
+			check_fixed_struct(top, memb->type_name, &here);
+		} else if (memb->type == NODE_MEMBER_DEF_UNION) {
+			def = lookup_union(memb->type_name);
+			check_fixed_alters(top, def->union_def.alters,
+					memb->type_name, &here);
+		}
+	}
+}
+
+static void check_fixed_alters(string top, const struct node_alter_list *alt,
+		string name, const struct fixed_path *path)
+{
+	for (; alt; alt = alt->next) {
+		if (alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			check_fixed_members(top, alt->members, name, path);
+			continue;
+		}
+		check_bound(name, alt->in_name,
+				alt->type == NODE_ALTER_DEF_PRIM ?
+				alt->type_name : NULL, &alt->vec);
+		if (!top) {
+			continue;
+		}
+		if (allocates(&alt->vec, alt->type == NODE_ALTER_DEF_PRIM ?
+					alt->type_name : NULL)) {
+			fprintf(stderr, "struct %s: fixed, but %s.%s "
+					"allocates\n", top, name, alt->in_name);
+			exit(EXIT_FAILURE);
+		}
+		if (alt->type == NODE_ALTER_DEF_STRUCT) {
+			check_fixed_struct(top, alt->type_name, path);
+		}
+	}
+}
+
+static void check_fixed_struct(string top, string name,
+		const struct fixed_path *path)
+{
+	const struct node_type_def_list *def = lookup_struct(name);
+
+	if (def->struct_def.shared) {
+		fprintf(stderr, "struct %s: fixed, but %s is shared\n",
+				top, name);
+		exit(EXIT_FAILURE);
+	}
+	check_fixed_members(top, def->struct_def.members, name, path);
+}
+
+static void check_fixed_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		if (list->type == NODE_TYPE_DEF_UNION) {
+			check_fixed_alters(NULL, list->union_def.alters,
+					list->union_def.name, NULL);
+			continue;
+		}
+		if (list->type != NODE_TYPE_DEF_STRUCT) {
+			continue;
+		}
+		check_fixed_members(list->struct_def.fixed ?
+				list->struct_def.name : NULL,
+				list->struct_def.members,
+				list->struct_def.name, NULL);
+		if (!list->struct_def.fixed) {
+			continue;
+		}
+		if (list->struct_def.shared || list->struct_def.incremental) {
+			fprintf(stderr, "struct %s: fixed can not be combined "
+					"with shared or incremental\n",
+					list->struct_def.name);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static int is_reparsed(string struct_name)
+{
+	return lookup_struct(struct_name)->struct_def.reparsed;
+}
+
+static void verify_mapping_list(const struct node_mapping *list)
+{
+	const struct node_hook_list *hook;
+	const char * const *known;
+
+	const char *unknown = "type %s has an unknown hook %s\n";
+	const char *batch = "type %s: hook batch needs exactly one C type\n";
+	const char *bounded = "type %s: hook bounded needs exactly one C "
+		"type\n";
+
+	for (; list; list = list->next) {
+		if (lookup_hook(list, "batch") && (!list->mapped_types ||
+					list->mapped_types->next)) {
+			fprintf(stderr, batch, list->name);
+			exit(EXIT_FAILURE);
+		}
+		if (lookup_hook(list, "bounded") && (!list->mapped_types ||
+					list->mapped_types->next)) {
+			fprintf(stderr, bounded, list->name);
+			exit(EXIT_FAILURE);
+		}
+		for (hook = list->hooks; hook; hook = hook->next) {
+			for (known = known_hooks; *known; ++known) {
+				if (!strcmp(*known, hook->name)) {
+					break;
+				}
+			}
+			if (!*known) {
+				fprintf(stderr, unknown, list->name, hook->name);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+}
+
 static void verify_def_list(const struct node_type_def_list *list)
 {
 	for (; list; list = list->next) {
@@ -372,36 +816,60 @@ static void decl_elem(const char *name, const struct node_vec_def *vec)
 		out_hdr("%s[%s];\n", name, vec->len_str);
 		break;
 	case NODE_TYPE_VAR_ARR:
-		out_hdr("*%s;\n", name);
+		if (vec->cap) {
+			out_hdr("%s[%ld];\n", name, vec->cap);
+		} else {
+			out_hdr("*%s;\n", name);
+		}
 		break;
+	case NODE_TYPE_BOUNDED:
+		break;	/* see decl_prim */
 	}
 }
 
 static void decl_elem_post(const struct node_vec_def *vec, int l)
 {
 	switch (vec->type) {
+	case NODE_TYPE_SCALE:
+	case NODE_TYPE_FIX_INT:
+	case NODE_TYPE_FIX_STR:
+	case NODE_TYPE_BOUNDED:
+		break;
 	case NODE_TYPE_VAR_ARR:
 		ohi(l, "long %s;\n", vec->len_str);
 		break;
 	}
 }
 
+/* a member of a prim type, a bounded one is kept in a char[cap] */
+static void decl_prim(string type_name, const struct string_list *pname,
+		const struct node_vec_def *vec, int l)
+{
+	const struct string_list *ptype;
+
+	ptype = lookup_map(type_name)->mapped_types;
+	if (vec->type == NODE_TYPE_BOUNDED) {
+		ohi(l, "char %s[%ld];\n", pname->str, vec->cap);
+		if (vec->spill) {
+			ohi(l, "%s %s_spill;\n", ptype->str, pname->str);
+		}
+		return;
+	}
+	for (; pname; pname = pname->next, ptype = ptype->next) {
+		ohi(l, "%s ", ptype->str);
+		decl_elem(pname->str, vec);
+	}
+	decl_elem_post(vec, l);
+}
+
 static void decl_member_list(const struct node_member_list *ml, int l)
 {
-	const struct string_list *pname, *ptype;
-	const struct node_mapping *map;
+	const struct string_list *pname;
 	const struct node_type_def_list *rel_union;
 	for (; ml; ml = ml->next) {
 		switch (ml->type) {
 		case NODE_MEMBER_DEF_PRIM:
-			map = lookup_map(ml->type_name);
-			pname = ml->mapped;
-			ptype = map->mapped_types;
-			for (; pname; pname = pname->next, ptype = ptype->next) {
-				ohi(l, "%s ", ptype->str);
-				decl_elem(pname->str, &ml->vec);
-			}
-			decl_elem_post(&ml->vec, l);
+			decl_prim(ml->type_name, ml->mapped, &ml->vec, l);
 			break;
 		case NODE_MEMBER_DEF_ENUM:
 			pname = ml->mapped;
@@ -439,25 +907,19 @@ static void decl_member_list(const struct node_member_list *ml, int l)
 
 static void decl_alter_list(const struct node_alter_list *al, int l)
 {
-	const struct string_list *pname, *ptype;
-	const struct node_mapping *map;
+	const struct string_list *pname;
 
 	for (; al; al = al->next) {
 		if ((al->type == NODE_ALTER_DEF_PRIM && len_string_list(al->mapped) > 1) ||
-				al->vec.type == NODE_TYPE_VAR_ARR) {
+				al->vec.type == NODE_TYPE_VAR_ARR ||
+				(al->vec.type == NODE_TYPE_BOUNDED &&
+				 al->vec.spill)) {
 			ohi(l, "struct {\n");
 			++l;
 		}
 		switch (al->type) {
 		case NODE_ALTER_DEF_PRIM:
-			map = lookup_map(al->type_name);
-			pname = al->mapped;
-			ptype = map->mapped_types;
-			for (; pname; pname = pname->next, ptype = ptype->next) {
-				ohi(l, "%s ", ptype->str);
-				decl_elem(pname->str, &al->vec);
-			}
-			decl_elem_post(&al->vec, l);
+			decl_prim(al->type_name, al->mapped, &al->vec, l);
 			break;
 		case NODE_ALTER_DEF_ENUM:
 			pname = al->mapped;
@@ -478,7 +940,9 @@ static void decl_alter_list(const struct node_alter_list *al, int l)
 			break;
 		}
 		if ((al->type == NODE_ALTER_DEF_PRIM && len_string_list(al->mapped) > 1) ||
-				al->vec.type == NODE_TYPE_VAR_ARR) {
+				al->vec.type == NODE_TYPE_VAR_ARR ||
+				(al->vec.type == NODE_TYPE_BOUNDED &&
+				 al->vec.spill)) {
 			--l;
 			ohi(l, "};\n");
 		}
@@ -514,6 +978,9 @@ static void decl_def_list(const struct node_type_def_list *list)
 					"struct dump_context *ctx, "
 					"const enum %s *value);\n",
 					name, name);
+			out_src("static void bdump__enum_%s(struct dump_buffer *buf, "
+					"const enum %s *value);\n",
+					name, name);
 			out_src("\n");
 			out_src("\n");
 			break;
@@ -521,6 +988,18 @@ static void decl_def_list(const struct node_type_def_list *list)
 			name = list->struct_def.name;
 			out_hdr("struct %s {\n", name);
 			decl_member_list(list->struct_def.members, 1);
+			if (list->struct_def.shared) {
+				ohi(1, "int config2c_shared;\n");
+			}
+			if (list->struct_def.reparsed) {
+				ohi(1, "uint64_t config2c_fp;\n");
+			}
+			if (list->struct_def.arena) {
+				ohi(1, "struct config_arena *config2c_arena;\n");
+			}
+			if (list->struct_def.allocator) {
+				ohi(1, "struct config_allocator *config2c_alloc;\n");
+			}
 			out_hdr("};\n");
 			out_hdr("\n");
 			out_hdr("\n");
@@ -529,11 +1008,47 @@ static void decl_def_list(const struct node_type_def_list *list)
 					"struct %s *value, "
 					"const struct node_value *input);\n",
 					name, name);
-			out_src("static void free__struct_%s(struct %s *value);\n",
-					name, name);
+			out_src("static void free__struct_%s("
+					"struct pass_to_conv *ctx, "
+					"struct %s *value);\n", name, name);
+			if (list->struct_def.applied) {
+				out_src("static int apply__struct_%s("
+						"struct pass_to_conv *ctx, "
+						"struct %s *target, "
+						"const struct node_value *input);\n",
+						name, name);
+			}
+			if (list->struct_def.reparsed) {
+				out_src("static int reparse__struct_%s("
+						"struct pass_to_conv *ctx, "
+						"struct %s *value, "
+						"const struct %s *old, "
+						"const struct node_value *input);\n",
+						name, name, name);
+				out_src("static void unshare__struct_%s("
+						"struct pass_to_conv *ctx, "
+						"struct %s *value, "
+						"const struct %s *old);\n",
+						name, name, name);
+			}
 			out_src("static void dump__struct_%s(put_func func, "
 					"struct dump_context *ctx, int l, "
 					"const struct %s *value);\n", name, name);
+			out_src("static void bdump__struct_%s(struct dump_buffer *buf, "
+					"int l, const struct %s *value);\n",
+					name, name);
+			out_src("static uint64_t hash__struct_%s("
+					"struct config_hash *tree, "
+					"const struct %s *value);\n", name, name);
+			out_src("static int equal__struct_%s(const struct %s *a, "
+					"const struct %s *b);\n", name, name, name);
+			out_src("static void diff__struct_%s("
+					"struct config_diff *d, long ia, long ib, "
+					"const struct %s *a, const struct %s *b);\n",
+					name, name, name);
+			out_src("static void pack__struct_%s("
+					"struct config_pack *p, "
+					"struct %s *value);\n", name, name);
 			out_src("\n");
 			out_src("\n");
 			break;
@@ -554,12 +1069,35 @@ static void decl_def_list(const struct node_type_def_list *list)
 					"union %s *value, enum %s *type, "
 					"const struct node_value *input);\n", 
 					name, name, ename);
-			out_src("static void free__union_%s(union %s *value, enum %s *type);\n",
-					name, name, ename);
+			out_src("static void free__union_%s("
+					"struct pass_to_conv *ctx, union %s *value, "
+					"enum %s *type);\n", name, name, ename);
 			out_src("static void dump__union_%s(put_func func, "
 					"struct dump_context *ctx, int l, "
 					"const union %s *value, const enum %s *type_value);\n",
 					name, name, ename);
+			out_src("static void bdump__union_%s(struct dump_buffer *buf, "
+					"int l, const union %s *value, "
+					"const enum %s *type_value);\n",
+					name, name, ename);
+			out_src("static uint64_t hash__union_%s("
+					"struct config_hash *tree, "
+					"const union %s *value, "
+					"const enum %s *type_value);\n",
+					name, name, ename);
+			out_src("static int equal__union_%s(const union %s *a, "
+					"const enum %s *a_type, const union %s *b, "
+					"const enum %s *b_type);\n",
+					name, name, ename, name, ename);
+			out_src("static void diff__union_%s("
+					"struct config_diff *d, long ia, long ib, "
+					"const union %s *a, const enum %s *a_type, "
+					"const union %s *b, const enum %s *b_type);\n",
+					name, name, ename, name, ename);
+			out_src("static void pack__union_%s("
+					"struct config_pack *p, union %s *value, "
+					"enum %s *type_value);\n",
+					name, name, ename);
 			out_src("\n");
 			out_src("\n");
 			break;
@@ -597,6 +1135,27 @@ struct type_decl {
 	string type_name;
 };
 
+/*
+ * The pointers to a value passed to the functions of its type, prefix being
+ * "&value->" and alike. A bounded value is passed as a pointer to its mapped
+ * type pointing to the inline storage, or to the spilled value if any.
+ */
+static void out_value_ref(string prefix, string sub,
+		const struct node_vec_def *vec, const struct type_decl *decl,
+		const struct string_list *vars)
+{
+	if (vec->type != NODE_TYPE_BOUNDED) {
+		out_str_list(0, prefix, sub, vars);
+		return;
+	}
+	out_src("&(%s){", lookup_map(decl->type_name)->mapped_types->str);
+	if (vec->spill) {
+		out_src("%s%s_spill ? %s%s_spill : ", prefix + 1, vars->str,
+				prefix + 1, vars->str);
+	}
+	out_src("%s%s}", prefix + 1, vars->str);
+}
+
 static void helper_free_scale(const struct type_decl *decl,
 		const struct string_list *vars, int l)
 {
@@ -605,18 +1164,18 @@ static void helper_free_scale(const struct type_decl *decl,
 	switch (decl->type) {
 	case TYPE_DECL_PRIM:
 		free_func = lookup_map(decl->type_name)->free_func;
-		osi(l, "%s(", free_func);
+		osi(l, "%s(ctx, ", free_func);
 		out_str_list(0, "&value->", "", vars);
 		out_src(");\n");
 		break;
 	case TYPE_DECL_ENUM:
 		break;
 	case TYPE_DECL_STRUCT:
-		osi(l, "free__struct_%s(&value->%s);\n",
+		osi(l, "free__struct_%s(ctx, &value->%s);\n",
 				decl->type_name, vars->str);
 		break;
 	case TYPE_DECL_UNION:
-		osi(l, "free__union_%s(", decl->type_name);
+		osi(l, "free__union_%s(ctx, ", decl->type_name);
 		out_str_list(0, "&value->", "", vars);
 		out_src(");\n");
 		break;
@@ -644,18 +1203,18 @@ static void helper_free_array(const struct node_vec_def *vec,
 	switch (decl->type) {
 	case TYPE_DECL_PRIM:
 		free_func = lookup_map(decl->type_name)->free_func;
-		osi(l + 1, "%s(", free_func);
+		osi(l + 1, "%s(ctx, ", free_func);
 		out_str_list(0, "&value->", "[i]", vars);
 		out_src(");\n");
 		break;
 	case TYPE_DECL_ENUM:
 		break;
 	case TYPE_DECL_STRUCT:
-		osi(l + 1, "free__struct_%s(&value->%s[i]);\n",
+		osi(l + 1, "free__struct_%s(ctx, &value->%s[i]);\n",
 				decl->type_name, vars->str);
 		break;
 	case TYPE_DECL_UNION:
-		osi(l + 1, "free__union_%s(", decl->type_name);
+		osi(l + 1, "free__union_%s(ctx, ", decl->type_name);
 		out_str_list(0, "&value->", "[i]", vars);
 		out_src(");\n");
 		break;
@@ -663,9 +1222,11 @@ static void helper_free_array(const struct node_vec_def *vec,
 
 	osi(l, "}\n"); /* for */
 
-	if (vec->type == NODE_TYPE_VAR_ARR) {
+	if (vec->type == NODE_TYPE_VAR_ARR && !vec->cap) {
 		for (var = vars; var; var = var->next) {
-			osi(l, "free(value->%s);\n", var->str);
+			osi(l, "conv_free(ctx, value->%s, value->%s * "
+					"sizeof(*value->%s));\n",
+					var->str, vec->len_str, var->str);
 		}
 	}
 }
@@ -678,21 +1239,83 @@ static void helper_free(const struct node_vec_def *vec,
 	case NODE_TYPE_SCALE:
 		helper_free_scale(decl, vars, l);
 		break;
+	case NODE_TYPE_BOUNDED:
+		if (vec->spill) {
+			osi(l, "if (value->%s_spill) {\n", vars->str);
+			osi(l + 1, "%s(ctx, &value->%s_spill);\n",
+					lookup_map(decl->type_name)->free_func,
+					vars->str);
+			osi(l, "}\n"); /* if */
+		}
+		break;
 	default:
 		helper_free_array(vec, decl, vars, l);
 		break;
 	}
 }
 
-struct parse_opts {
-	enum {
-		PARSE_STRUCT,
-		PARSE_UNION,
-	} mode;
-	union {
-		struct {
-			long idx;
-			string opt_var;
+/*
+ * Frees the storage of a member of value which it does not share with the
+ * same member of old, see unshare_struct.
+ */
+static void helper_unshare(const struct node_vec_def *vec,
+		const struct type_decl *decl,
+		const struct string_list *vars, int l)
+{
+	if (decl->type != TYPE_DECL_STRUCT || !is_reparsed(decl->type_name)) {
+		helper_free(vec, decl, vars, l);
+		return;
+	}
+	switch (vec->type) {
+	case NODE_TYPE_SCALE:
+		osi(l, "unshare__struct_%s(ctx, &value->%s, &old->%s);\n",
+				decl->type_name, vars->str, vars->str);
+		break;
+	case NODE_TYPE_FIX_INT:
+		osi(l, "for (i = 0; i < %ld; ++i) {\n", vec->len_int);
+		osi(l + 1, "unshare__struct_%s(ctx, &value->%s[i], "
+				"&old->%s[i]);\n",
+				decl->type_name, vars->str, vars->str);
+		osi(l, "}\n"); /* for */
+		break;
+	case NODE_TYPE_FIX_STR:
+		osi(l, "for (i = 0; i < %s; ++i) {\n", vec->len_str);
+		osi(l + 1, "unshare__struct_%s(ctx, &value->%s[i], "
+				"&old->%s[i]);\n",
+				decl->type_name, vars->str, vars->str);
+		osi(l, "}\n"); /* for */
+		break;
+	case NODE_TYPE_VAR_ARR:
+		osi(l, "for (i = 0; i < value->%s; ++i) {\n", vec->len_str);
+		osi(l + 1, "if (i < old->%s) {\n", vec->len_str);
+		osi(l + 2, "unshare__struct_%s(ctx, &value->%s[i], "
+				"&old->%s[i]);\n",
+				decl->type_name, vars->str, vars->str);
+		osi(l + 1, "} else {\n");
+		osi(l + 2, "free__struct_%s(ctx, &value->%s[i]);\n",
+				decl->type_name, vars->str);
+		osi(l + 1, "}\n"); /* if */
+		osi(l, "}\n"); /* for */
+		if (!vec->cap) {
+			osi(l, "conv_free(ctx, value->%s, value->%s * "
+					"sizeof(*value->%s));\n",
+					vars->str, vec->len_str, vars->str);
+		}
+		break;
+	case NODE_TYPE_BOUNDED:
+		break;	/* of a prim type only, see check_bound */
+	}
+}
+
+struct parse_opts {
+	enum {
+		PARSE_STRUCT,
+		PARSE_UNION,
+	} mode;
+	union {
+		struct {
+			long idx;
+			string opt_var;
 			string opt_val;
 		} s;
 		struct {
@@ -701,19 +1324,53 @@ struct parse_opts {
 		} u;
 	};
 	int is_default;
+	int is_apply;
+	int is_reparse;
 };
 
-static void helper_parse_scale(const struct type_decl *decl,
+/* a scalar or array struct member converted by reparse__struct_* */
+static int is_reparse_member(const struct type_decl *decl,
+		const struct parse_opts *opts)
+{
+	return opts->is_reparse && opts->mode == PARSE_STRUCT &&
+		!opts->s.opt_var && decl->type == TYPE_DECL_STRUCT &&
+		is_reparsed(decl->type_name);
+}
+
+static void helper_parse_scale(const struct node_vec_def *vec,
+		const struct type_decl *decl,
 		string name, const struct string_list *vars,
 		const struct parse_opts *opts, int l)
 {
 	string parse_func;
 
 	osi(l, "else if (!strcmp(\"%s\", memb->name)) {\n", name);
+	if (opts->is_apply && decl->type == TYPE_DECL_STRUCT &&
+			!opts->s.opt_var) {
+		/* updated member by member, see apply_struct */
+		osi(l + 1, "ret = apply__struct_%s(ctx, &value->%s, memb->value);\n",
+				decl->type_name, vars->str);
+		osi(l + 1, "if (ret) {\n");
+		osi(l + 2, "*target = tmp;\n");
+		osi(l + 2, "return ret;\n");
+		osi(l + 1, "}\n"); /* if ret */
+		osi(l + 1, "continue;\n");
+		osi(l, "}\n"); /* if matches */
+		return;
+	}
 	if (opts->mode == PARSE_STRUCT) {
 		osi(l + 1, "if (inited[%ld]) {\n", opts->s.idx);
 		osi(l + 2, "ctx->node = memb->value;\n");
-		osi(l + 2, "ctx->msg = \"member is already defined.\";\n");
+		if (opts->s.opt_var) {
+			/* another member of the anonymous union */
+			osi(l + 2, "ctx->msg = memb->value->lower && "
+					"value->%s != %s ?\n",
+					opts->s.opt_var, opts->s.opt_val);
+			osi(l + 3, "\"union is inited with another type in another layer.\" :\n");
+			osi(l + 3, "\"member is already defined.\";\n");
+		} else {
+			osi(l + 2, "ctx->msg = \"member is already defined.\";\n");
+		}
 		osi(l + 2, "ret = -EINVAL;\n");
 		osi(l + 2, "goto error_all;\n");
 		osi(l + 1, "}\n"); /* if inited */
@@ -721,7 +1378,10 @@ static void helper_parse_scale(const struct type_decl *decl,
 		osi(l + 1, "if (inited) {\n");
 		osi(l + 2, "if (*type_value != %s) {\n", opts->u.alt_val);
 		osi(l + 3, "ctx->node = memb->value;\n");
-		osi(l + 3, "ctx->msg = \"union is inited with another type.\";\n");
+		/* an upper layer may not select another alternative */
+		osi(l + 3, "ctx->msg = memb->value->lower ?\n");
+		osi(l + 4, "\"union is inited with another type in another layer.\" :\n");
+		osi(l + 4, "\"union is inited with another type.\";\n");
 		osi(l + 3, "ret = -EINVAL;\n");
 		osi(l + 3, "goto error_all;\n");
 		osi(l + 2, "}\n"); /* if */
@@ -736,6 +1396,26 @@ static void helper_parse_scale(const struct type_decl *decl,
 	switch (decl->type) {
 	case TYPE_DECL_PRIM:
 		parse_func = lookup_map(decl->type_name)->parse_func;
+		if (vec->type == NODE_TYPE_BOUNDED) {
+			if (vec->spill) {
+				osi(l + 1, "value->%s_spill = NULL;\n",
+						vars->str);
+			}
+			osi(l + 1, "ret = %s(ctx, value->%s, %ld, memb->value);\n",
+					lookup_hook(lookup_map(decl->type_name),
+						"bounded"),
+					vars->str, vec->cap);
+			if (vec->spill) {
+				/* too long for the inline storage */
+				osi(l + 1, "if (ret == -ENOSPC) {\n");
+				osi(l + 2, "value->%s[0] = '\\0';\n", vars->str);
+				osi(l + 2, "ret = %s(ctx, &value->%s_spill, "
+						"memb->value);\n",
+						parse_func, vars->str);
+				osi(l + 1, "}\n"); /* if ret */
+			}
+			break;
+		}
 		osi(l + 1, "ret = %s(ctx", parse_func);
 		if (vars) {
 			out_src(", ");
@@ -748,6 +1428,12 @@ static void helper_parse_scale(const struct type_decl *decl,
 				decl->type_name, vars->str);
 		break;
 	case TYPE_DECL_STRUCT:
+		if (is_reparse_member(decl, opts)) {
+			osi(l + 1, "ret = reparse__struct_%s(ctx, &value->%s, "
+					"&old->%s, memb->value);\n",
+					decl->type_name, vars->str, vars->str);
+			break;
+		}
 		osi(l + 1, "ret = parse__struct_%s(ctx, &value->%s, memb->value);\n",
 				decl->type_name, vars->str);
 		break;
@@ -784,14 +1470,27 @@ static void helper_parse_array(const struct node_vec_def *vec,
 		string name, const struct string_list *vars,
 		const struct parse_opts *opts, int l)
 {
-	string parse_func, free_func;
+	string parse_func, free_func, batch_func = NULL;
 	const struct string_list *cv;
 
+	if (decl->type == TYPE_DECL_PRIM) {
+		batch_func = lookup_hook(lookup_map(decl->type_name), "batch");
+	}
+
 	osi(l, "else if (!strcmp(\"%s\", memb->name)) {\n", name);
 	if (opts->mode == PARSE_STRUCT) {
 		osi(l + 1, "if (inited[%ld]) {\n", opts->s.idx);
 		osi(l + 2, "ctx->node = memb->value;\n");
-		osi(l + 2, "ctx->msg = \"member is already defined.\";\n");
+		if (opts->s.opt_var) {
+			/* another member of the anonymous union */
+			osi(l + 2, "ctx->msg = memb->value->lower && "
+					"value->%s != %s ?\n",
+					opts->s.opt_var, opts->s.opt_val);
+			osi(l + 3, "\"union is inited with another type in another layer.\" :\n");
+			osi(l + 3, "\"member is already defined.\";\n");
+		} else {
+			osi(l + 2, "ctx->msg = \"member is already defined.\";\n");
+		}
 		osi(l + 2, "ret = -EINVAL;\n");
 		osi(l + 2, "goto error_all;\n");
 		osi(l + 1, "}\n"); /* if inited */
@@ -799,7 +1498,10 @@ static void helper_parse_array(const struct node_vec_def *vec,
 		osi(l + 1, "if (inited) {\n");
 		osi(l + 2, "if (*type_value != %s) {\n", opts->u.alt_val);
 		osi(l + 3, "ctx->node = memb->value;\n");
-		osi(l + 3, "ctx->msg = \"union is inited with another type.\";\n");
+		/* an upper layer may not select another alternative */
+		osi(l + 3, "ctx->msg = memb->value->lower ?\n");
+		osi(l + 4, "\"union is inited with another type in another layer.\" :\n");
+		osi(l + 4, "\"union is inited with another type.\";\n");
 		osi(l + 3, "ret = -EINVAL;\n");
 		osi(l + 3, "goto error_all;\n");
 		osi(l + 2, "}\n"); /* if */
@@ -812,7 +1514,13 @@ static void helper_parse_array(const struct node_vec_def *vec,
 		osi(l + 1, "}\n"); /* if */
 	}
 	
-	osi(l + 1, "if (memb->value->type != VAL_ELEMS) {\n");
+	if (batch_func) {
+		/* a batch type also takes hex"..." and b64"..." */
+		osi(l + 1, "if (memb->value->type != VAL_ELEMS && "
+				"!is_blob_value(memb->value)) {\n");
+	} else {
+		osi(l + 1, "if (memb->value->type != VAL_ELEMS) {\n");
+	}
 	osi(l + 2, "ctx->node = memb->value;\n");
 	osi(l + 2, "ctx->msg = \"invalid type, expecting an array.\";\n");
 	osi(l + 2, "ret = -EINVAL;\n");
@@ -820,36 +1528,60 @@ static void helper_parse_array(const struct node_vec_def *vec,
 	osi(l + 1, "}\n"); /* if type */
 
 	osi(l + 1, "i = 0;\n");
+	if (batch_func) {
+		osi(l + 1, "if (memb->value->type == VAL_ELEMS) {\n");
+		osi(l + 2, "len = len_node_elems(memb->value->elems);\n");
+		osi(l + 1, "} else if ((len = blob_elems(ctx, memb->value, "
+				"sizeof(*value->%s))) < 0) {\n", vars->str);
+		osi(l + 2, "ret = len;\n");
+		osi(l + 2, "goto error_all;\n");
+		osi(l + 1, "}\n"); /* if type */
+	}
 	if (vec->type == NODE_TYPE_FIX_INT ||
 			vec->type == NODE_TYPE_FIX_STR) {
+		if (batch_func) {
+			osi(l + 1, "if (len != ");
+		} else {
+			osi(l + 1, "if (len_node_elems(memb->value->elems) != ");
+		}
 		if (vec->type == NODE_TYPE_FIX_INT) {
-			osi(l + 1, "if (len_node_elems(memb->value->elems) != %ld) {\n",
-					vec->len_int);
+			out_src("%ld) {\n", vec->len_int);
 		} else {
-			osi(l + 1, "if (len_node_elems(memb->value->elems) != %s) {\n",
-					vec->len_str);
+			out_src("%s) {\n", vec->len_str);
 		}
 		osi(l + 2, "ctx->node = memb->value;\n");
 		osi(l + 2, "ctx->msg = \"wrong number of elements.\";\n");
 		osi(l + 2, "ret = -EINVAL;\n");
 		osi(l + 2, "goto error_all;\n");
 		osi(l + 1, "}\n"); /* if len... */
-		if (vec->type == NODE_TYPE_FIX_INT) {
-			osi(l + 1, "for (elem = memb->value->elems; i < %ld; "
-					"++i, elem = elem->next) {\n", vec->len_int);
+		if (batch_func) {
+			/* converted at once below */
+		} else if (vec->type == NODE_TYPE_FIX_INT) {
+			osi(l + 1, "for (elems_iter_init(&iter, memb->value->elems); "
+					"i < %ld; ++i) {\n", vec->len_int);
 		} else {
-			osi(l + 1, "for (elem = memb->value->elems; i < %s; "
-					"++i, elem = elem->next) {\n", vec->len_str);
+			osi(l + 1, "for (elems_iter_init(&iter, memb->value->elems); "
+					"i < %s; ++i) {\n", vec->len_str);
 		}
 	} else {
-		osi(l + 1, "len = len_node_elems(memb->value->elems);\n");
+		if (!batch_func) {
+			osi(l + 1, "len = len_node_elems(memb->value->elems);\n");
+		}
+		if (vec->cap) {
+			osi(l + 1, "if (len > %ld) {\n", vec->cap);
+			osi(l + 2, "ctx->node = memb->value;\n");
+			osi(l + 2, "ctx->msg = \"too many elements.\";\n");
+			osi(l + 2, "ret = -ENOSPC;\n");
+			osi(l + 2, "goto error_all;\n");
+			osi(l + 1, "}\n"); /* if len */
+		}
 		osi(l + 1, "value->%s = len;\n", vec->len_str);
-		for (cv = vars; cv; cv = cv->next) {
+		for (cv = vars; !vec->cap && cv; cv = cv->next) {
 			osi(l + 1, "value->%s = NULL;\n", cv->str);
 		}
-		for (cv = vars; cv; cv = cv->next) {
-			osi(l + 1, "value->%s = calloc(len, sizeof(*value->%s));\n",
-					cv->str, cv->str);
+		for (cv = vars; !vec->cap && cv; cv = cv->next) {
+			osi(l + 1, "value->%s = conv_calloc(ctx, len, "
+					"sizeof(*value->%s));\n", cv->str, cv->str);
 			osi(l + 1, "if (len && !value->%s) {\n", cv->str);
 			osi(l + 2, "ctx->node = memb->value;\n");
 			osi(l + 2, "ctx->msg = \"memory insufficient.\";\n");
@@ -861,38 +1593,76 @@ static void helper_parse_array(const struct node_vec_def *vec,
 			}
 			osi(l + 1, "}\n", cv->str);
 		}
-		osi(l + 1, "for (elem = memb->value->elems; i < len; "
-			"++i, elem = elem->next) {\n");
+		if (!batch_func) {
+			osi(l + 1, "for (elems_iter_init(&iter, memb->value->elems); "
+				"i < len; ++i) {\n");
+		}
 	}
 
 	switch (decl->type) {
 	case TYPE_DECL_PRIM:
+		if (batch_func) {
+			break;	/* converted at once below */
+		}
 		parse_func = lookup_map(decl->type_name)->parse_func;
 		osi(l + 2, "ret = %s(ctx", parse_func);
 		if (vars) {
 			out_src(", ");
 		}
 		out_str_list(0, "&value->", "[i]", vars);
-		out_src(", elem->value);\n");
+		out_src(", elems_iter_next(&iter));\n");
 		break;
 	case TYPE_DECL_ENUM:
-		osi(l + 2, "ret = parse__enum_%s(ctx, &value->%s[i], elem->value);\n",
-				decl->type_name, vars->str);
+		osi(l + 2, "ret = parse__enum_%s(ctx, &value->%s[i], "
+				"elems_iter_next(&iter));\n", decl->type_name, vars->str);
 		break;
 	case TYPE_DECL_STRUCT:
-		osi(l + 2, "ret = parse__struct_%s(ctx, &value->%s[i], elem->value);\n",
-				decl->type_name, vars->str);
+		if (!is_reparse_member(decl, opts)) {
+			osi(l + 2, "ret = parse__struct_%s(ctx, &value->%s[i], "
+					"elems_iter_next(&iter));\n",
+					decl->type_name, vars->str);
+		} else if (vec->type != NODE_TYPE_VAR_ARR) {
+			osi(l + 2, "ret = reparse__struct_%s(ctx, &value->%s[i], "
+					"&old->%s[i], elems_iter_next(&iter));\n",
+					decl->type_name, vars->str, vars->str);
+		} else {
+			/* elements past the end of old are new */
+			osi(l + 2, "if (i < old->%s) {\n", vec->len_str);
+			osi(l + 3, "ret = reparse__struct_%s(ctx, &value->%s[i], "
+					"&old->%s[i], elems_iter_next(&iter));\n",
+					decl->type_name, vars->str, vars->str);
+			osi(l + 2, "} else {\n");
+			osi(l + 3, "ret = parse__struct_%s(ctx, &value->%s[i], "
+					"elems_iter_next(&iter));\n",
+					decl->type_name, vars->str);
+			osi(l + 2, "}\n"); /* if */
+		}
 		break;
 	case TYPE_DECL_UNION:
 		osi(l + 2, "ret = parse__union_%s(ctx, ", decl->type_name);
 		out_str_list(0, "&value->", "[i]", vars);
-		out_src(", elem->value);\n");
+		out_src(", elems_iter_next(&iter));\n");
 		break;
 	}
-	osi(l + 2, "if (ret) {\n");
-	osi(l + 3, "goto error_%s;\n", name);
-	osi(l + 2, "}\n"); /* if ret */
-	osi(l + 1, "}\n"); /* for */
+	if (batch_func) {
+		/* nothing to free on error, i is still 0 */
+		osi(l + 1, "if (memb->value->type == VAL_ELEMS) {\n");
+		osi(l + 2, "ret = %s(ctx, value->%s, memb->value->elems, len);\n",
+				batch_func, vars->str);
+		osi(l + 2, "if (ret) {\n");
+		osi(l + 3, "goto error_%s;\n", name);
+		osi(l + 2, "}\n"); /* if ret */
+		osi(l + 1, "} else {\n");
+		osi(l + 2, "blob_decode(value->%s, memb->value, len, "
+				"sizeof(*value->%s));\n", vars->str, vars->str);
+		osi(l + 1, "}\n"); /* if type */
+	} else {
+		osi(l + 2, "if (ret) {\n");
+		osi(l + 3, "elems_iter_keep(&iter, ctx);\n");
+		osi(l + 3, "goto error_%s;\n", name);
+		osi(l + 2, "}\n"); /* if ret */
+		osi(l + 1, "}\n"); /* for */
+	}
 	if (opts->mode == PARSE_STRUCT) {
 		osi(l + 1, "inited[%ld] = 1;\n", opts->s.idx);
 		if (opts->s.opt_var) {
@@ -915,30 +1685,51 @@ static void helper_parse_array(const struct node_vec_def *vec,
 	} else {
 		osi(0, "errord_%s:\n", name);
 	}
-	osi(l + 1, "for (; i > 0; --i) {\n");
+	osi(l + 1, "if (ctx->arena) {\n");
+	osi(l + 2, "goto error_all;\t/* freed with the arena */\n");
+	osi(l + 1, "}\n"); /* if */
+	/* the element at i has freed itself */
+	osi(l + 1, "for (--i; i >= 0; --i) {\n");
 	switch (decl->type) {
 	case TYPE_DECL_PRIM:
 		free_func = lookup_map(decl->type_name)->free_func;
-		osi(l + 2, "%s(", free_func);
+		osi(l + 2, "%s(ctx, ", free_func);
 		out_str_list(0, "&value->", "[i]", vars);
 		out_src(");\n");
 		break;
 	case TYPE_DECL_ENUM:
 		break;
 	case TYPE_DECL_STRUCT:
-		osi(l + 2, "free__struct_%s(&value->%s[i]);\n",
-				decl->type_name, vars->str);
+		if (!is_reparse_member(decl, opts)) {
+			osi(l + 2, "free__struct_%s(ctx, &value->%s[i]);\n",
+					decl->type_name, vars->str);
+		} else if (vec->type != NODE_TYPE_VAR_ARR) {
+			osi(l + 2, "unshare__struct_%s(ctx, &value->%s[i], "
+					"&old->%s[i]);\n",
+					decl->type_name, vars->str, vars->str);
+		} else {
+			osi(l + 2, "if (i < old->%s) {\n", vec->len_str);
+			osi(l + 3, "unshare__struct_%s(ctx, &value->%s[i], "
+					"&old->%s[i]);\n",
+					decl->type_name, vars->str, vars->str);
+			osi(l + 2, "} else {\n");
+			osi(l + 3, "free__struct_%s(ctx, &value->%s[i]);\n",
+					decl->type_name, vars->str);
+			osi(l + 2, "}\n"); /* if */
+		}
 		break;
 	case TYPE_DECL_UNION:
-		osi(l + 2, "free__union_%s(", decl->type_name);
+		osi(l + 2, "free__union_%s(ctx, ", decl->type_name);
 		out_str_list(0, "&value->", "[i]", vars);
 		out_src(");\n");
 		break;
 	}
 	osi(l + 1, "}\n"); /* for */
-	if (vec->type == NODE_TYPE_VAR_ARR) {
+	if (vec->type == NODE_TYPE_VAR_ARR && !vec->cap) {
 		for (cv = vars; cv; cv = cv->next) {
-			osi(l + 1, "free(value->%s);\n", cv->str);
+			osi(l + 1, "conv_free(ctx, value->%s, value->%s * "
+					"sizeof(*value->%s));\n",
+					cv->str, vec->len_str, cv->str);
 		}
 	}
 	osi(l + 1, "goto error_all;\n");
@@ -949,6 +1740,67 @@ static void helper_parse_array(const struct node_vec_def *vec,
 	osi(l, "}\n"); /* if matches */
 }
 
+/* whether helper_parse walks the elements with an elems_iter */
+static int helper_parse_iter(const struct node_vec_def *vec, int prim,
+		string type_name)
+{
+	switch (vec->type) {
+	case NODE_TYPE_SCALE:
+	case NODE_TYPE_BOUNDED:
+		return 0;
+	default:
+		return !prim || !lookup_hook(lookup_map(type_name), "batch");
+	}
+}
+
+static int alters_parse_iter(const struct node_alter_list *list);
+
+static int members_parse_iter(const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+
+	for (memb = list; memb; memb = memb->next) {
+		switch (memb->type) {
+		case NODE_MEMBER_DEF_UNNAMED_UNION:
+			if (alters_parse_iter(memb->alters)) {
+				return 1;
+			}
+			break;
+		default:
+			if (helper_parse_iter(&memb->vec,
+					memb->type == NODE_MEMBER_DEF_PRIM,
+					memb->type_name)) {
+				return 1;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
+static int alters_parse_iter(const struct node_alter_list *list)
+{
+	const struct node_alter_list *alt;
+
+	for (alt = list; alt; alt = alt->next) {
+		switch (alt->type) {
+		case NODE_ALTER_DEF_UNNAMED_STRUCT:
+			if (members_parse_iter(alt->members)) {
+				return 1;
+			}
+			break;
+		default:
+			if (helper_parse_iter(&alt->vec,
+					alt->type == NODE_ALTER_DEF_PRIM,
+					alt->type_name)) {
+				return 1;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
 static void helper_parse(const struct node_vec_def *vec,
 		const struct type_decl *decl,
 		string name, const struct string_list *vars,
@@ -956,7 +1808,8 @@ static void helper_parse(const struct node_vec_def *vec,
 {
 	switch (vec->type) {
 	case NODE_TYPE_SCALE:
-		helper_parse_scale(decl, name, vars, opts, l);
+	case NODE_TYPE_BOUNDED:
+		helper_parse_scale(vec, decl, name, vars, opts, l);
 		break;
 	default:
 		helper_parse_array(vec, decl, name, vars, opts, l);
@@ -996,111 +1849,84 @@ static void parse_enum(string name, const struct node_enum_list *list)
 	osi(0, "\n");
 }
 
-static void parse_struct(string name, const struct node_member_list *list)
+/* one branch for each member of a struct, in the loop over members */
+static void helper_parse_members(const struct node_member_list *list,
+		struct parse_opts *opts, int l)
 {
 	const struct node_member_list *memb;
 	const struct node_alter_list *alt;
-	long cnt, idx;
 	struct type_decl decl;
-	struct parse_opts opts;
-
-	cnt = len_member_list(list);
-	opts.mode = PARSE_STRUCT;
+	long idx;
 
-	osi(0, "static int parse__struct_%s(struct pass_to_conv *ctx, struct %s *value, "
-			"const struct node_value *input)\n", name, name);
-	osi(0, "{\n");
-	osi(1, "int inited[%ld] = {};\n", cnt);
-	osi(1, "int ret;\n");
-	osi(1, "long i, len;\n");
-	osi(1, "struct node_members *memb, default_memb;\n");
-	osi(1, "struct node_elems *elem;\n");
-	osi(1, "struct pass_to_bison opaque;\n");
-	for (memb = list, idx = 0; memb; memb = memb->next, ++idx) {
-		if (memb->default_val) {
-			osi(1, "const char *default_%ld = %s;\n",
-					idx, memb->default_val);
-		}
-	}
-	osi(1, "if (input->type != VAL_MEMBERS) {\n");
-	osi(2, "ctx->node = input;\n");
-	osi(2, "ctx->msg = \"invalid type, expecting list of members.\";\n");
-	osi(2, "return -EINVAL;\n");
-	osi(1, "}\n"); /* if */
-	opts.is_default = 0;
-	osi(1, "for (memb = input->members; memb; memb = memb->next) {\n");
-	osi(2, "if (0) {\n");
-	osi(3, ";\n");
-	osi(2, "}\n");
 	for (memb = list, idx = 0; memb; memb = memb->next, ++idx) {
 		if (!memb->visible) {
 			continue;
 		}
 		switch (memb->type) {
 		case NODE_MEMBER_DEF_PRIM:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
+			opts->s.idx = idx;
+			opts->s.opt_var = NULL;
+			opts->s.opt_val = NULL;
 			decl.type = TYPE_DECL_PRIM;
 			decl.type_name = memb->type_name;
 			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+					memb->mapped, opts, l);
 			break;
 		case NODE_MEMBER_DEF_ENUM:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
+			opts->s.idx = idx;
+			opts->s.opt_var = NULL;
+			opts->s.opt_val = NULL;
 			decl.type = TYPE_DECL_ENUM;
 			decl.type_name = memb->type_name;
 			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+					memb->mapped, opts, l);
 			break;
 		case NODE_MEMBER_DEF_STRUCT:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
+			opts->s.idx = idx;
+			opts->s.opt_var = NULL;
+			opts->s.opt_val = NULL;
 			decl.type = TYPE_DECL_STRUCT;
 			decl.type_name = memb->type_name;
 			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+					memb->mapped, opts, l);
 			break;
 		case NODE_MEMBER_DEF_UNION:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
+			opts->s.idx = idx;
+			opts->s.opt_var = NULL;
+			opts->s.opt_val = NULL;
 			decl.type = TYPE_DECL_UNION;
 			decl.type_name = memb->type_name;
 			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+					memb->mapped, opts, l);
 			break;
 		case NODE_MEMBER_DEF_UNNAMED_UNION:
-			opts.s.idx = idx;
-			opts.s.opt_var = memb->alt_enum;
+			opts->s.idx = idx;
+			opts->s.opt_var = memb->alt_enum;
 			for (alt = memb->alters; alt; alt = alt->next) {
 				switch (alt->type) {
 				case NODE_ALTER_DEF_PRIM:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
+					opts->s.idx = idx;
+					opts->s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_PRIM;
 					decl.type_name = alt->type_name;
 					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+							alt->mapped, opts, l);
 					break;
 				case NODE_ALTER_DEF_ENUM:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
+					opts->s.idx = idx;
+					opts->s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_ENUM;
 					decl.type_name = alt->type_name;
 					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+							alt->mapped, opts, l);
 					break;
 				case NODE_ALTER_DEF_STRUCT:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
+					opts->s.idx = idx;
+					opts->s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_STRUCT;
 					decl.type_name = alt->type_name;
 					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+							alt->mapped, opts, l);
 					break;
 				default:
 					fprintf(stderr, "error at %d (%s) : impossible err\n",
@@ -1110,196 +1936,402 @@ static void parse_struct(string name, const struct node_member_list *list)
 			}
 		}
 	}
-	osi(2, "ctx->node = memb->value;\n");
-	osi(2, "ctx->msg = \"unknown member.\";\n");
-	osi(2, "ret = -EINVAL;\n");
-	osi(2, "goto error_all;\n");
-	osi(1, "}\n"); /* for */
-	opts.is_default = 1;
+}
+
+/*
+ * frees the members of a struct set in inited, in reparse__struct_* but the
+ * storage shared with old
+ */
+static void helper_free_inited(const struct node_member_list *list,
+		int reparse, int l)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+	long idx;
+
 	for (memb = list, idx = 0; memb; memb = memb->next, ++idx) {
-		if (memb->visible && !memb->default_val) {
-			osi(1, "if (!inited[%ld]) {\n", idx);
-			osi(2, "ctx->node = input;\n");
-			osi(2, "ctx->msg = \"some field is not initialized.\";\n");
-			osi(2, "ret = -EINVAL;\n");
-			osi(2, "goto error_all;\n");
-			osi(1, "}\n"); /* if */
-			continue;
-		}
-		if (!memb->default_val) {
+		if (!memb->visible && !memb->default_val) {
 			continue;
 		}
-		osi(1, "if (!inited[%ld]) {\n", idx);
-		osi(2, "init_pass_to_bison(&opaque, ctx->pool);\n");
-		osi(2, "ret = yacc_parse_string(default_%ld, &ctx->msg, &opaque);\n", idx);
-		osi(2, "if (ret) {\n");
-		osi(3, "ctx->node = input;\n");
-		osi(3, "goto error_all;\n");
-		osi(2, "}\n"); /* if ret */
-		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
-			osi(2, "default_memb.next = NULL;\n");
-			osi(2, "default_memb.name = \"%s\";\n", memb->in_name);
-			osi(2, "default_memb.value = opaque.output;\n");
-			osi(2, "default_memb.value->parent = input;\n");
-			osi(2, "default_memb.value->name_copy = \"%s\";\n", memb->in_name);
-			osi(2, "memb = &default_memb;\n");
-		} else {
-			osi(2, "if (opaque.output->type != VAL_MEMBERS) {\n");
-			osi(3, "ctx->node = input;\n");
-			osi(3, "ctx->msg = \"invalid initial value: "
-					"value not selected\";\n");
-			osi(2, "}\n"); /* if invalid type */
-			
-			osi(2, "if (len_node_members(opaque.output->members) != 1) {\n");
-			osi(3, "ctx->node = input;\n");
-			osi(3, "ctx->msg = \"invalid initial value: "
-					"multiple value selected\";\n");
-			osi(2, "}\n"); /* if invalid type */
-
-			osi(2, "memb = opaque.output->members;\n");
-			osi(2, "memb->value->parent = input;\n");
-		}
-		osi(2, "if (0) {\n");
-		osi(3, ";\n");
-		osi(2, "}\n");
+		osi(l, "if (inited[%ld]) {\n", idx);
 		switch (memb->type) {
 		case NODE_MEMBER_DEF_PRIM:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_PRIM;
 			decl.type_name = memb->type_name;
-			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+			helper_free(&memb->vec, &decl, memb->mapped, l + 1);
 			break;
 		case NODE_MEMBER_DEF_ENUM:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_ENUM;
 			decl.type_name = memb->type_name;
-			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+			helper_free(&memb->vec, &decl, memb->mapped, l + 1);
 			break;
 		case NODE_MEMBER_DEF_STRUCT:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_STRUCT;
 			decl.type_name = memb->type_name;
-			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+			if (reparse) {
+				helper_unshare(&memb->vec, &decl,
+						memb->mapped, l + 1);
+			} else {
+				helper_free(&memb->vec, &decl,
+						memb->mapped, l + 1);
+			}
 			break;
 		case NODE_MEMBER_DEF_UNION:
-			opts.s.idx = idx;
-			opts.s.opt_var = NULL;
-			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_UNION;
 			decl.type_name = memb->type_name;
-			helper_parse(&memb->vec, &decl, memb->in_name,
-					memb->mapped, &opts, 2);
+			helper_free(&memb->vec, &decl, memb->mapped, l + 1);
 			break;
 		case NODE_MEMBER_DEF_UNNAMED_UNION:
-			opts.s.idx = idx;
-			opts.s.opt_var = memb->alt_enum;
 			for (alt = memb->alters; alt; alt = alt->next) {
+				osi(l + 1, "if (value->%s == %s) {\n",
+						memb->alt_enum, alt->enum_val);
 				switch (alt->type) {
 				case NODE_ALTER_DEF_PRIM:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_PRIM;
 					decl.type_name = alt->type_name;
-					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+					helper_free(&alt->vec, &decl, 
+							alt->mapped, l + 2);
 					break;
 				case NODE_ALTER_DEF_ENUM:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_ENUM;
 					decl.type_name = alt->type_name;
-					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+					helper_free(&alt->vec, &decl, 
+							alt->mapped, l + 2);
 					break;
 				case NODE_ALTER_DEF_STRUCT:
-					opts.s.idx = idx;
-					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_STRUCT;
 					decl.type_name = alt->type_name;
-					helper_parse(&alt->vec, &decl, alt->in_name,
-							alt->mapped, &opts, 2);
+					helper_free(&alt->vec, &decl, 
+							alt->mapped, l + 2);
 					break;
-				default:
-					fprintf(stderr, "error at %d (%s) : impossible err\n",
-							__LINE__, __func__);
-					exit(EXIT_FAILURE);
 				}
+				osi(l + 1, "}\n"); /* if */
 			}
 		}
-		osi(2, "else {\n");
-		osi(3, "ctx->node = memb->value;\n");
-		osi(3, "ctx->msg = \"unknown member.\";\n");
-		osi(3, "ret = -EINVAL;\n");
-		osi(3, "goto error_all;\n");
-		osi(2, "}\n");
-		osi(1, "}\n"); /* if !inited */
+		osi(l, "}\n"); /* if */
+	}
+}
+
+/*
+ * With reparse, emits reparse__struct_* instead: converts input unless its
+ * fingerprint is the one old was converted from, in which case value takes
+ * over the storage of old; struct members are reparsed from the same members
+ * of old. See unshare_struct for what is freed afterwards.
+ */
+static void parse_struct(string name, const struct node_member_list *list,
+		int shared, int reparsed, int reparse)
+{
+	const struct node_type_def_list *def;
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	long cnt, idx;
+	struct type_decl decl;
+	struct parse_opts opts;
+
+	cnt = len_member_list(list);
+	opts.mode = PARSE_STRUCT;
+	opts.is_apply = 0;
+	opts.is_reparse = reparse;
+
+	if (reparse) {
+		osi(0, "static int reparse__struct_%s(struct pass_to_conv *ctx, "
+				"struct %s *value, const struct %s *old, "
+				"const struct node_value *input)\n",
+				name, name, name);
+	} else {
+		osi(0, "static int parse__struct_%s(struct pass_to_conv *ctx, "
+				"struct %s *value, "
+				"const struct node_value *input)\n", name, name);
+	}
+	osi(0, "{\n");
+	osi(1, "int inited[%ld] = {};\n", cnt);
+	osi(1, "int ret;\n");
+	osi(1, "long i, len;\n");
+	osi(1, "struct node_members *memb, default_memb;\n");
+	if (members_parse_iter(list)) {
+		osi(1, "struct elems_iter iter;\n");
+	}
+	osi(1, "struct pass_to_bison opaque;\n");
+	if (shared) {
+		osi(1, "struct %s *shared;\n", name);
+	}
+	if (reparse) {
+		osi(1, "uint64_t fp;\n");
 	}
-	osi(1, "return 0;\n");
-	osi(0, "error_all:\n");
 	for (memb = list, idx = 0; memb; memb = memb->next, ++idx) {
-		if (!memb->visible && !memb->default_val) {
+		if (memb->default_val) {
+			osi(1, "const char *default_%ld = %s;\n",
+					idx, memb->default_val);
+		}
+	}
+	osi(1, "if (input->type != VAL_MEMBERS) {\n");
+	osi(2, "ctx->node = input;\n");
+	osi(2, "ctx->msg = \"invalid type, expecting list of members.\";\n");
+	osi(2, "return -EINVAL;\n");
+	osi(1, "}\n"); /* if */
+	if (reparse) {
+		osi(1, "fp = node_fingerprint(ctx, input);\n");
+		osi(1, "if (fp == old->config2c_fp) {\n");
+		osi(2, "*value = *old;\t/* unchanged, taken over */\n");
+		osi(2, "return 0;\n");
+		osi(1, "}\n"); /* if fp */
+	}
+	if (shared) {
+		osi(1, "if (input->anchored && "
+				"(shared = conv_share_find(ctx, input, \"%s\"))) {\n",
+				name);
+		osi(2, "*value = *shared;\n");
+		osi(2, "value->config2c_shared = 1;\n");
+		osi(2, "shared->config2c_shared = 2;\t/* has copies */\n");
+		osi(2, "return 0;\n");
+		osi(1, "}\n"); /* if shared */
+	}
+	opts.is_default = 0;
+	osi(1, "for (memb = input->members; memb; memb = memb->next) {\n");
+	osi(2, "if (0) {\n");
+	osi(3, ";\n");
+	osi(2, "}\n");
+	helper_parse_members(list, &opts, 2);
+	osi(2, "ctx->node = memb->value;\n");
+	osi(2, "ctx->msg = \"unknown member.\";\n");
+	osi(2, "ret = -EINVAL;\n");
+	osi(2, "goto error_all;\n");
+	osi(1, "}\n"); /* for */
+	opts.is_default = 1;
+	for (memb = list, idx = 0; memb; memb = memb->next, ++idx) {
+		if (memb->visible && !memb->default_val) {
+			osi(1, "if (!inited[%ld]) {\n", idx);
+			osi(2, "ctx->node = input;\n");
+			osi(2, "ctx->msg = \"some field is not initialized.\";\n");
+			osi(2, "ret = -EINVAL;\n");
+			osi(2, "goto error_all;\n");
+			osi(1, "}\n"); /* if */
 			continue;
 		}
-		osi(1, "if (inited[%ld]) {\n", idx);
+		if (!memb->default_val) {
+			continue;
+		}
+		osi(1, "if (!inited[%ld]) {\n", idx);
+		osi(2, "init_pass_to_bison(&opaque, ctx->pool);\n");
+		osi(2, "ret = yacc_parse_string(default_%ld, &ctx->msg, &opaque);\n", idx);
+		osi(2, "if (ret) {\n");
+		osi(3, "ctx->node = input;\n");
+		osi(3, "goto error_all;\n");
+		osi(2, "}\n"); /* if ret */
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			osi(2, "default_memb.next = NULL;\n");
+			osi(2, "default_memb.name = \"%s\";\n", memb->in_name);
+			osi(2, "default_memb.value = opaque.output;\n");
+			osi(2, "default_memb.value->parent = input;\n");
+			osi(2, "default_memb.value->name_copy = \"%s\";\n", memb->in_name);
+			osi(2, "memb = &default_memb;\n");
+		} else {
+			osi(2, "if (opaque.output->type != VAL_MEMBERS) {\n");
+			osi(3, "ctx->node = input;\n");
+			osi(3, "ctx->msg = \"invalid initial value: "
+					"value not selected\";\n");
+			osi(2, "}\n"); /* if invalid type */
+			
+			osi(2, "if (len_node_members(opaque.output->members) != 1) {\n");
+			osi(3, "ctx->node = input;\n");
+			osi(3, "ctx->msg = \"invalid initial value: "
+					"multiple value selected\";\n");
+			osi(2, "}\n"); /* if invalid type */
+
+			osi(2, "memb = opaque.output->members;\n");
+			osi(2, "memb->value->parent = input;\n");
+		}
+		osi(2, "if (0) {\n");
+		osi(3, ";\n");
+		osi(2, "}\n");
 		switch (memb->type) {
 		case NODE_MEMBER_DEF_PRIM:
+			opts.s.idx = idx;
+			opts.s.opt_var = NULL;
+			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_PRIM;
 			decl.type_name = memb->type_name;
-			helper_free(&memb->vec, &decl, memb->mapped, 2);
+			helper_parse(&memb->vec, &decl, memb->in_name,
+					memb->mapped, &opts, 2);
 			break;
 		case NODE_MEMBER_DEF_ENUM:
+			opts.s.idx = idx;
+			opts.s.opt_var = NULL;
+			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_ENUM;
 			decl.type_name = memb->type_name;
-			helper_free(&memb->vec, &decl, memb->mapped, 2);
+			helper_parse(&memb->vec, &decl, memb->in_name,
+					memb->mapped, &opts, 2);
 			break;
 		case NODE_MEMBER_DEF_STRUCT:
+			opts.s.idx = idx;
+			opts.s.opt_var = NULL;
+			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_STRUCT;
 			decl.type_name = memb->type_name;
-			helper_free(&memb->vec, &decl, memb->mapped, 2);
+			helper_parse(&memb->vec, &decl, memb->in_name,
+					memb->mapped, &opts, 2);
 			break;
 		case NODE_MEMBER_DEF_UNION:
+			opts.s.idx = idx;
+			opts.s.opt_var = NULL;
+			opts.s.opt_val = NULL;
 			decl.type = TYPE_DECL_UNION;
 			decl.type_name = memb->type_name;
-			helper_free(&memb->vec, &decl, memb->mapped, 2);
+			helper_parse(&memb->vec, &decl, memb->in_name,
+					memb->mapped, &opts, 2);
 			break;
 		case NODE_MEMBER_DEF_UNNAMED_UNION:
+			opts.s.idx = idx;
+			opts.s.opt_var = memb->alt_enum;
 			for (alt = memb->alters; alt; alt = alt->next) {
-				osi(2, "if (value->%s == %s) {\n",
-						memb->alt_enum, alt->enum_val);
 				switch (alt->type) {
 				case NODE_ALTER_DEF_PRIM:
+					opts.s.idx = idx;
+					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_PRIM;
 					decl.type_name = alt->type_name;
-					helper_free(&alt->vec, &decl, 
-							alt->mapped, 3);
+					helper_parse(&alt->vec, &decl, alt->in_name,
+							alt->mapped, &opts, 2);
 					break;
 				case NODE_ALTER_DEF_ENUM:
+					opts.s.idx = idx;
+					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_ENUM;
 					decl.type_name = alt->type_name;
-					helper_free(&alt->vec, &decl, 
-							alt->mapped, 3);
+					helper_parse(&alt->vec, &decl, alt->in_name,
+							alt->mapped, &opts, 2);
 					break;
 				case NODE_ALTER_DEF_STRUCT:
+					opts.s.idx = idx;
+					opts.s.opt_val = alt->enum_val;
 					decl.type = TYPE_DECL_STRUCT;
 					decl.type_name = alt->type_name;
-					helper_free(&alt->vec, &decl, 
-							alt->mapped, 3);
+					helper_parse(&alt->vec, &decl, alt->in_name,
+							alt->mapped, &opts, 2);
 					break;
+				default:
+					fprintf(stderr, "error at %d (%s) : impossible err\n",
+							__LINE__, __func__);
+					exit(EXIT_FAILURE);
 				}
-				osi(2, "}\n"); /* if */
 			}
 		}
+		osi(2, "else {\n");
+		osi(3, "ctx->node = memb->value;\n");
+		osi(3, "ctx->msg = \"unknown member.\";\n");
+		osi(3, "ret = -EINVAL;\n");
+		osi(3, "goto error_all;\n");
+		osi(2, "}\n");
+		osi(1, "}\n"); /* if !inited */
+	}
+	if (shared) {
+		osi(1, "value->config2c_shared = 0;\n");
+		osi(1, "if (input->anchored && "
+				"conv_share_add(ctx, input, \"%s\", value)) {\n", name);
+		osi(2, "ctx->node = input;\n");
+		osi(2, "ctx->msg = \"memory insufficient.\";\n");
+		osi(2, "ret = -ENOMEM;\n");
+		osi(2, "goto error_all;\n");
+		osi(1, "}\n"); /* if */
+	}
+	/* the members of test_default are not in ast */
+	def = lookup_struct(name);
+	if (def && def->struct_def.arena) {
+		/* set by config_convert_* of the exported struct */
+		osi(1, "value->config2c_arena = NULL;\n");
+	}
+	if (def && def->struct_def.allocator) {
+		osi(1, "value->config2c_alloc = ctx->alloc;\n");
+	}
+	if (reparse) {
+		osi(1, "value->config2c_fp = fp;\n");
+	} else if (reparsed) {
+		osi(1, "value->config2c_fp = node_fingerprint(ctx, input);\n");
+	}
+	osi(1, "return 0;\n");
+	osi(0, "error_all:\n");
+	osi(1, "if (ctx->arena) {\n");
+	osi(2, "return ret;\t/* freed with the arena */\n");
+	osi(1, "}\n"); /* if */
+	helper_free_inited(list, reparse, 1);
+	osi(1, "return ret;\n");
+	osi(0, "}\n");
+	osi(0, "\n");
+}
+
+/*
+ * Converts the members in input into a copy of target, frees the old storage
+ * of each member and replaces it. A scalar struct member is updated the same
+ * way recursively. Members before a failing one stay updated.
+ */
+static void apply_struct(string name, const struct node_member_list *list,
+		int shared, int reparsed)
+{
+	struct parse_opts opts;
+
+	opts.mode = PARSE_STRUCT;
+	opts.is_default = 0;
+	opts.is_apply = 1;
+	opts.is_reparse = 0;
+
+	osi(0, "static int apply__struct_%s(struct pass_to_conv *ctx, "
+			"struct %s *target, const struct node_value *input)\n",
+			name, name);
+	osi(0, "{\n");
+	osi(1, "int inited[%ld];\n", len_member_list(list));
+	osi(1, "int ret;\n");
+	osi(1, "long i, len;\n");
+	osi(1, "struct node_members *memb;\n");
+	if (members_parse_iter(list)) {
+		osi(1, "struct elems_iter iter;\n");
+	}
+	osi(1, "struct %s tmp, *value = &tmp;\n", name);
+	osi(1, "if (input->type != VAL_MEMBERS) {\n");
+	osi(2, "ctx->node = input;\n");
+	osi(2, "ctx->msg = \"invalid type, expecting list of members.\";\n");
+	osi(2, "return -EINVAL;\n");
+	osi(1, "}\n"); /* if */
+	if (shared) {
+		osi(1, "if (target->config2c_shared) {\n");
+		osi(2, "ctx->node = input;\n");
+		osi(2, "ctx->msg = \"struct is shared, can not update in place.\";\n");
+		osi(2, "return -EINVAL;\n");
 		osi(1, "}\n"); /* if */
 	}
+	if (reparsed) {
+		/* no longer the value of the text it was converted from */
+		osi(1, "target->config2c_fp = 0;\n");
+	}
+	osi(1, "for (memb = input->members; memb; memb = memb->next) {\n");
+	osi(2, "memset(inited, 0, sizeof(inited));\n");
+	osi(2, "tmp = *target;\n");
+	/* continue in a branch ends the member */
+	osi(2, "do {\n");
+	osi(3, "if (0) {\n");
+	osi(4, ";\n");
+	osi(3, "}\n");
+	helper_parse_members(list, &opts, 3);
+	osi(3, "ctx->node = memb->value;\n");
+	osi(3, "ctx->msg = \"unknown member.\";\n");
+	osi(3, "ret = -EINVAL;\n");
+	osi(3, "goto error_all;\n");
+	osi(2, "} while (0);\n");
+	/* replaced storage in an arena stays until the arena is freed */
+	osi(2, "if (!ctx->arena) {\n");
+	osi(3, "value = target;\n");
+	helper_free_inited(list, 0, 3);
+	osi(2, "}\n"); /* if */
+	osi(2, "*target = tmp;\n");
+	osi(2, "value = &tmp;\n");
+	osi(1, "}\n"); /* for */
+	osi(1, "return 0;\n");
+	osi(0, "error_all:\n");
+	osi(1, "if (ctx->arena) {\n");
+	osi(2, "return ret;\t/* freed with the arena */\n");
+	osi(1, "}\n"); /* if */
+	helper_free_inited(list, 0, 1);
 	osi(1, "return ret;\n");
 	osi(0, "}\n");
 	osi(0, "\n");
@@ -1316,6 +2348,8 @@ static void parse_union(string name, string enum_name,
 
 	opts.mode = PARSE_UNION;
 	opts.is_default = 0;
+	opts.is_apply = 0;
+	opts.is_reparse = 0;
 
 	osi(0, "static int parse__union_%s(struct pass_to_conv *ctx, union %s *value, "
 			"enum %s *type_value, const struct node_value *input)\n",
@@ -1324,7 +2358,9 @@ static void parse_union(string name, string enum_name,
 	osi(1, "int ret;\n");
 	osi(1, "long i, len;\n");
 	osi(1, "struct node_members *memb;\n");
-	osi(1, "struct node_elems *elem;\n");
+	if (alters_parse_iter(list)) {
+		osi(1, "struct elems_iter iter;\n");
+	}
 	osi(1, "int inited = 0;\n");
 	for (alt = list; alt; alt = alt->next) {
 		switch (alt->type) {
@@ -1439,6 +2475,9 @@ static void parse_union(string name, string enum_name,
 	}
 	osi(1, "return 0;\n");
 	osi(1, "error_all:\n");
+	osi(1, "if (ctx->arena) {\n");
+	osi(2, "return ret;\t/* freed with the arena */\n");
+	osi(1, "}\n"); /* if */
 	for (alt = list; alt; alt = alt->next) {
 		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
 			/* other types won't have partial initialized status */
@@ -1488,7 +2527,20 @@ static void parse_type_def_list(const struct node_type_def_list *list)
 			break;
 		case NODE_TYPE_DEF_STRUCT:
 			parse_struct(list->struct_def.name,
-					list->struct_def.members);
+					list->struct_def.members,
+					list->struct_def.shared,
+					list->struct_def.reparsed, 0);
+			if (list->struct_def.reparsed) {
+				parse_struct(list->struct_def.name,
+						list->struct_def.members,
+						0, 1, 1);
+			}
+			if (list->struct_def.applied) {
+				apply_struct(list->struct_def.name,
+						list->struct_def.members,
+						list->struct_def.shared,
+						list->struct_def.reparsed);
+			}
 			break;
 		case NODE_TYPE_DEF_UNION:
 			parse_union(list->union_def.name,
@@ -1500,15 +2552,39 @@ static void parse_type_def_list(const struct node_type_def_list *list)
 }
 
 
-static void free_struct(string name, const struct node_member_list *list)
+/*
+ * With unshare, emits unshare__struct_*: frees value but the storage it
+ * shares with old, one of them being reparsed from the other. A struct that
+ * was taken over has the fingerprint of the other one, only struct members
+ * can be taken over.
+ */
+static void free_struct(string name, const struct node_member_list *list,
+		int shared, int unshare)
 {
 	const struct node_member_list *memb;
 	const struct node_alter_list *alt;
 	struct type_decl decl;
 
-	osi(0, "static void free__struct_%s(struct %s *value)\n", name, name);
+	if (unshare) {
+		osi(0, "static void unshare__struct_%s("
+				"struct pass_to_conv *ctx, struct %s *value, "
+				"const struct %s *old)\n", name, name, name);
+	} else {
+		osi(0, "static void free__struct_%s(struct pass_to_conv *ctx, "
+				"struct %s *value)\n", name, name);
+	}
 	osi(0, "{\n");
 	osi(1, "long i;\n");
+	if (unshare) {
+		osi(1, "if (value->config2c_fp == old->config2c_fp) {\n");
+		osi(2, "return;\t/* taken over */\n");
+		osi(1, "}\n"); /* if */
+	}
+	if (shared) {
+		osi(1, "if (value->config2c_shared == 1) {\n");
+		osi(2, "return;\t/* owned by the first copy */\n");
+		osi(1, "}\n"); /* if */
+	}
 	for (memb = list; memb; memb = memb->next) {
 		if (!memb->visible && !memb->default_val) {
 			continue;
@@ -1527,7 +2603,13 @@ static void free_struct(string name, const struct node_member_list *list)
 		case NODE_MEMBER_DEF_STRUCT:
 			decl.type = TYPE_DECL_STRUCT;
 			decl.type_name = memb->type_name;
-			helper_free(&memb->vec, &decl, memb->mapped, 1);
+			if (unshare) {
+				helper_unshare(&memb->vec, &decl,
+						memb->mapped, 1);
+			} else {
+				helper_free(&memb->vec, &decl,
+						memb->mapped, 1);
+			}
 			break;
 		case NODE_MEMBER_DEF_UNION:
 			decl.type = TYPE_DECL_UNION;
@@ -1573,7 +2655,8 @@ static void free_union(string name, string enum_name,
 	const struct node_alter_list *alt;
 	struct type_decl decl;
 
-	osi(0, "static void free__union_%s(union %s *value, enum %s *type_value)\n",
+	osi(0, "static void free__union_%s(struct pass_to_conv *ctx, "
+			"union %s *value, enum %s *type_value)\n",
 			name, name, enum_name);
 	osi(0, "{\n");
 	osi(1, "long i;\n");
@@ -1637,7 +2720,13 @@ static void free_type_def_list(const struct node_type_def_list *list)
 		switch (list->type) {
 		case NODE_TYPE_DEF_STRUCT:
 			free_struct(list->struct_def.name,
-					list->struct_def.members);
+					list->struct_def.members,
+					list->struct_def.shared, 0);
+			if (list->struct_def.reparsed) {
+				free_struct(list->struct_def.name,
+						list->struct_def.members,
+						0, 1);
+			}
 			break;
 		case NODE_TYPE_DEF_UNION:
 			free_union(list->union_def.name,
@@ -1664,7 +2753,8 @@ static void dump_enum(const char *name, const struct node_enum_list *list)
 	osi(0, "\n");
 }
 
-static void helper_dump_scale(const struct type_decl *decl,
+static void helper_dump_scale(const struct node_vec_def *vec,
+		const struct type_decl *decl,
 		string name, const struct string_list *vars, int l)
 {
 	string dump_func;
@@ -1688,7 +2778,7 @@ static void helper_dump_scale(const struct type_decl *decl,
 	}
 	if (vars) {
 		out_src(", ");
-		out_str_list(0, "&value->", "", vars);
+		out_value_ref("&value->", "", vec, decl, vars);
 	}
 	out_src(");\n");
 }
@@ -1740,7 +2830,8 @@ static void helper_dump(const struct node_vec_def *vec,
 {
 	switch (vec->type) {
 	case NODE_TYPE_SCALE:
-		helper_dump_scale(decl, name, vars, l);
+	case NODE_TYPE_BOUNDED:
+		helper_dump_scale(vec, decl, name, vars, l);
 		break;
 	default:
 		helper_dump_array(vec, decl, name, vars, l);
@@ -1918,21 +3009,1227 @@ static void dump_type_def_list(const struct node_type_def_list *list)
 	}
 }
 
+static void bdump_enum(const char *name, const struct node_enum_list *list)
+{
+	osi(0, "static void bdump__enum_%s(struct dump_buffer *buf, "
+			"const enum %s *value)\n", name, name);
+	osi(0, "{\n");
+	for (; list; list = list->next) {
+		osi(1, "if (*value == %s) {\n", list->name);
+		osi(2, "dump_buffer_puts(buf, \"%s\");\n", list->name);
+		osi(1, "}\n");
+	}
+	osi(0, "}\n");
+	osi(0, "\n");
+}
 
-const char *spec_path;
-const char *prim_path;
-const char *prelude_path;
-const char *hdr_path;
-const char *src_path;
-const char *include_guard;
-int test_default;
-int do_help;
-int do_version;
-
-const char *help_msg;
+/* level is the indent level of a nested struct or union */
+static void helper_bdump_value(const struct node_vec_def *vec,
+		const struct type_decl *decl, const struct string_list *vars,
+		string sub, string level, int l)
+{
+	const struct node_mapping *map;
+	string bdump_func;
 
-struct option opts[] = {
-	{ "spec_path", required_argument, 0, 0 },
+	switch (decl->type) {
+	case TYPE_DECL_PRIM:
+		map = lookup_map(decl->type_name);
+		bdump_func = lookup_hook(map, "bdump");
+		if (bdump_func) {
+			osi(l, "%s(buf", bdump_func);
+		} else {
+			osi(l, "%s(dump_buffer_printf, (struct dump_context *)buf",
+					map->dump_func);
+		}
+		break;
+	case TYPE_DECL_ENUM:
+		osi(l, "bdump__enum_%s(buf", decl->type_name);
+		break;
+	case TYPE_DECL_STRUCT:
+		osi(l, "bdump__struct_%s(buf, %s", decl->type_name, level);
+		break;
+	case TYPE_DECL_UNION:
+		osi(l, "bdump__union_%s(buf, %s", decl->type_name, level);
+		break;
+	}
+	if (vars) {
+		out_src(", ");
+		out_value_ref("&value->", sub, vec, decl, vars);
+	}
+	out_src(");\n");
+}
+
+static void helper_bdump(const struct node_vec_def *vec,
+		const struct type_decl *decl,
+		string name, const struct string_list *vars, int l)
+{
+	osi(l, "dump_buffer_indent(buf, l + 1);\n");
+	if (vec->type == NODE_TYPE_SCALE || vec->type == NODE_TYPE_BOUNDED) {
+		osi(l, "dump_buffer_puts(buf, \".%s = \");\n", name);
+		helper_bdump_value(vec, decl, vars, "", "l + 1", l);
+		return;
+	}
+	osi(l, "dump_buffer_puts(buf, \".%s = [\");\n", name);
+	osi(l, "dump_buffer_newline(buf);\n");
+	if (vec->type == NODE_TYPE_FIX_INT) {
+		osi(l, "for (i = 0; i < %ld; ++i) {\n", vec->len_int);
+	} else if (vec->type == NODE_TYPE_FIX_STR) {
+		osi(l, "for (i = 0; i < %s; ++i) {\n", vec->len_str);
+	} else {
+		osi(l, "for (i = 0; i < value->%s; ++i) {\n", vec->len_str);
+	}
+	osi(l + 1, "dump_buffer_indent(buf, l + 2);\n");
+	helper_bdump_value(vec, decl, vars, "[i]", "l + 2", l + 1);
+	osi(l + 1, "dump_buffer_putc(buf, ',');\n");
+	osi(l + 1, "dump_buffer_newline(buf);\n");
+	osi(l, "}\n"); /* for */
+	osi(l, "dump_buffer_indent(buf, l + 1);\n");
+	osi(l, "dump_buffer_putc(buf, ']');\n");
+}
+
+static void bdump_struct(string name, const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void bdump__struct_%s(struct dump_buffer *buf, int l, "
+			"const struct %s *value)\n", name, name);
+	osi(0, "{\n");
+	osi(1, "long i;\n");
+	osi(1, "dump_buffer_putc(buf, '{');\n");
+	osi(1, "dump_buffer_newline(buf);\n");
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible) {
+			continue;
+		}
+		switch (memb->type) {
+		case NODE_MEMBER_DEF_PRIM:
+			decl.type = TYPE_DECL_PRIM;
+			decl.type_name = memb->type_name;
+			helper_bdump(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 1);
+			break;
+		case NODE_MEMBER_DEF_ENUM:
+			decl.type = TYPE_DECL_ENUM;
+			decl.type_name = memb->type_name;
+			helper_bdump(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 1);
+			break;
+		case NODE_MEMBER_DEF_STRUCT:
+			decl.type = TYPE_DECL_STRUCT;
+			decl.type_name = memb->type_name;
+			helper_bdump(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 1);
+			break;
+		case NODE_MEMBER_DEF_UNION:
+			decl.type = TYPE_DECL_UNION;
+			decl.type_name = memb->type_name;
+			helper_bdump(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 1);
+			break;
+		case NODE_MEMBER_DEF_UNNAMED_UNION:
+			for (alt = memb->alters; alt; alt = alt->next) {
+				osi(1, "if (value->%s == %s) {\n",
+						memb->alt_enum, alt->enum_val);
+				switch (alt->type) {
+				case NODE_ALTER_DEF_PRIM:
+					decl.type = TYPE_DECL_PRIM;
+					decl.type_name = alt->type_name;
+					helper_bdump(&alt->vec, &decl, alt->in_name,
+							alt->mapped, 2);
+					break;
+				case NODE_ALTER_DEF_ENUM:
+					decl.type = TYPE_DECL_ENUM;
+					decl.type_name = alt->type_name;
+					helper_bdump(&alt->vec, &decl, alt->in_name,
+							alt->mapped, 2);
+					break;
+				case NODE_ALTER_DEF_STRUCT:
+					decl.type = TYPE_DECL_STRUCT;
+					decl.type_name = alt->type_name;
+					helper_bdump(&alt->vec, &decl, alt->in_name,
+							alt->mapped, 2);
+					break;
+				}
+				osi(1, "}\n"); /* if */
+			}
+		}
+		osi(1, "dump_buffer_putc(buf, ',');\n");
+		osi(1, "dump_buffer_newline(buf);\n");
+	}
+	osi(1, "dump_buffer_indent(buf, l);\n");
+	osi(1, "dump_buffer_putc(buf, '}');\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void bdump_union(string name, string enum_name,
+		const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void bdump__union_%s(struct dump_buffer *buf, int l, "
+			"const union %s *value, "
+			"const enum %s *type_value)\n", name, name, enum_name);
+	osi(0, "{\n");
+	osi(1, "long i;\n");
+	osi(1, "dump_buffer_putc(buf, '{');\n");
+	osi(1, "dump_buffer_newline(buf);\n");
+	for (alt = list; alt; alt = alt->next) {
+		osi(1, "if (*type_value == %s) {\n", alt->enum_val);
+		switch (alt->type) {
+		case NODE_ALTER_DEF_PRIM:
+			decl.type = TYPE_DECL_PRIM;
+			decl.type_name = alt->type_name;
+			helper_bdump(&alt->vec, &decl, alt->in_name, alt->mapped, 2);
+			osi(2, "dump_buffer_putc(buf, ',');\n");
+			osi(2, "dump_buffer_newline(buf);\n");
+			break;
+		case NODE_ALTER_DEF_ENUM:
+			decl.type = TYPE_DECL_ENUM;
+			decl.type_name = alt->type_name;
+			helper_bdump(&alt->vec, &decl, alt->in_name, alt->mapped, 2);
+			osi(2, "dump_buffer_putc(buf, ',');\n");
+			osi(2, "dump_buffer_newline(buf);\n");
+			break;
+		case NODE_ALTER_DEF_STRUCT:
+			decl.type = TYPE_DECL_STRUCT;
+			decl.type_name = alt->type_name;
+			helper_bdump(&alt->vec, &decl, alt->in_name, alt->mapped, 2);
+			osi(2, "dump_buffer_putc(buf, ',');\n");
+			osi(2, "dump_buffer_newline(buf);\n");
+			break;
+		case NODE_ALTER_DEF_UNNAMED_STRUCT:
+			for (memb = alt->members; memb; memb = memb->next) {
+				switch (memb->type) {
+				case NODE_MEMBER_DEF_PRIM:
+					decl.type = TYPE_DECL_PRIM;
+					decl.type_name = memb->type_name;
+					helper_bdump(&memb->vec, &decl, memb->in_name,
+							memb->mapped, 2);
+					break;
+				case NODE_MEMBER_DEF_ENUM:
+					decl.type = TYPE_DECL_ENUM;
+					decl.type_name = memb->type_name;
+					helper_bdump(&memb->vec, &decl, memb->in_name,
+							memb->mapped, 2);
+					break;
+				case NODE_MEMBER_DEF_STRUCT:
+					decl.type = TYPE_DECL_STRUCT;
+					decl.type_name = memb->type_name;
+					helper_bdump(&memb->vec, &decl, memb->in_name,
+							memb->mapped, 2);
+					break;
+				case NODE_MEMBER_DEF_UNION:
+					decl.type = TYPE_DECL_UNION;
+					decl.type_name = memb->type_name;
+					helper_bdump(&memb->vec, &decl, memb->in_name,
+							memb->mapped, 2);
+					break;
+				}
+				osi(2, "dump_buffer_putc(buf, ',');\n");
+				osi(2, "dump_buffer_newline(buf);\n");
+			}
+		}
+		osi(1, "}\n");
+	}
+	osi(1, "dump_buffer_indent(buf, l);\n");
+	osi(1, "dump_buffer_putc(buf, '}');\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void bdump_type_def_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_TYPE_DEF_ENUM:
+			bdump_enum(list->enum_def.name,
+					list->enum_def.enums);
+			break;
+		case NODE_TYPE_DEF_STRUCT:
+			bdump_struct(list->struct_def.name,
+					list->struct_def.members);
+			break;
+		case NODE_TYPE_DEF_UNION:
+			bdump_union(list->union_def.name,
+					list->union_def.enum_name,
+					list->union_def.alters);
+			break;
+		}
+	}
+}
+
+
+/*
+ * Structural hash, equality and diff.
+ * hash__* mixes the hashes of the members in order, and records a node in
+ * the tree for each struct, union and array of them. diff__* walks the trees
+ * of both sides together and only descends into nodes whose hashes differ,
+ * ca and cb being the next child node on each side.
+ */
+static void decl_of_member(const struct node_member_list *memb,
+		struct type_decl *decl)
+{
+	decl->type_name = memb->type_name;
+	switch (memb->type) {
+	case NODE_MEMBER_DEF_PRIM:
+		decl->type = TYPE_DECL_PRIM;
+		break;
+	case NODE_MEMBER_DEF_ENUM:
+		decl->type = TYPE_DECL_ENUM;
+		break;
+	case NODE_MEMBER_DEF_STRUCT:
+		decl->type = TYPE_DECL_STRUCT;
+		break;
+	case NODE_MEMBER_DEF_UNION:
+		decl->type = TYPE_DECL_UNION;
+		break;
+	case NODE_MEMBER_DEF_UNNAMED_UNION:
+		break;	/* by its alters */
+	}
+}
+
+static void decl_of_alter(const struct node_alter_list *alt,
+		struct type_decl *decl)
+{
+	decl->type_name = alt->type_name;
+	switch (alt->type) {
+	case NODE_ALTER_DEF_PRIM:
+		decl->type = TYPE_DECL_PRIM;
+		break;
+	case NODE_ALTER_DEF_ENUM:
+		decl->type = TYPE_DECL_ENUM;
+		break;
+	case NODE_ALTER_DEF_STRUCT:
+		decl->type = TYPE_DECL_STRUCT;
+		break;
+	case NODE_ALTER_DEF_UNNAMED_STRUCT:
+		break;	/* by its members */
+	}
+}
+
+static int has_node(const struct type_decl *decl)
+{
+	return decl->type == TYPE_DECL_STRUCT || decl->type == TYPE_DECL_UNION;
+}
+
+/* whether a diff of the members walks child nodes */
+static int members_have_node(const struct node_member_list *list)
+{
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	for (; list; list = list->next) {
+		if (!list->visible) {
+			continue;
+		}
+		if (list->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(list, &decl);
+			if (has_node(&decl)) {
+				return 1;
+			}
+			continue;
+		}
+		for (alt = list->alters; alt; alt = alt->next) {
+			decl_of_alter(alt, &decl);
+			if (has_node(&decl)) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int alters_have_node(const struct node_alter_list *list)
+{
+	struct type_decl decl;
+
+	for (; list; list = list->next) {
+		if (list->type == NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			if (members_have_node(list->members)) {
+				return 1;
+			}
+			continue;
+		}
+		decl_of_alter(list, &decl);
+		if (has_node(&decl)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void out_vec_len(const struct node_vec_def *vec, string prefix)
+{
+	if (vec->type == NODE_TYPE_FIX_INT) {
+		out_src("%ld", vec->len_int);
+	} else if (vec->type == NODE_TYPE_FIX_STR) {
+		out_src("%s", vec->len_str);
+	} else {
+		out_src("%s%s", prefix, vec->len_str);
+	}
+}
+
+static void out_prim_params(const struct node_mapping *map, string prefix)
+{
+	const struct string_list *t;
+	int i;
+
+	for (t = map->mapped_types, i = 0; t; t = t->next, ++i) {
+		out_src("%s%s const *%s%d", i ? ", " : "", t->str, prefix, i);
+	}
+}
+
+static void out_prim_args(const struct node_mapping *map, string prefix)
+{
+	const struct string_list *t;
+	int i;
+
+	for (t = map->mapped_types, i = 0; t; t = t->next, ++i) {
+		out_src("%s%s%d", i ? ", " : "", prefix, i);
+	}
+}
+
+/* dumps a value without a hash or equal hook to compare it by its text */
+static void helper_prim_text(const struct node_mapping *map, string buf,
+		string prefix, int l)
+{
+	string bdump_func = lookup_hook(map, "bdump");
+
+	osi(l, "dump_buffer_init(&%s, NULL, 0, "
+			"DUMP_BUFFER_GROW | DUMP_BUFFER_COMPACT);\n", buf);
+	if (bdump_func) {
+		osi(l, "%s(&%s, ", bdump_func, buf);
+	} else {
+		osi(l, "%s(dump_buffer_printf, (struct dump_context *)&%s, ",
+				map->dump_func, buf);
+	}
+	out_prim_args(map, prefix);
+	out_src(");\n");
+}
+
+static void hash_mapping_list(const struct node_mapping *map)
+{
+	string hook;
+
+	for (; map; map = map->next) {
+		osi(0, "static inline uint64_t hash__prim_%s(", map->name);
+		out_prim_params(map, "v");
+		out_src(")\n");
+		osi(0, "{\n");
+		hook = lookup_hook(map, "hash");
+		if (hook) {
+			osi(1, "return %s(", hook);
+			out_prim_args(map, "v");
+			out_src(");\n");
+		} else {
+			osi(1, "struct dump_buffer buf;\n");
+			osi(1, "uint64_t h;\n");
+			helper_prim_text(map, "buf", "v", 1);
+			osi(1, "h = config_hash_bytes(CONFIG_HASH_BASIS, "
+					"buf.data, buf.len);\n");
+			osi(1, "free(buf.data);\n");
+			osi(1, "return h;\n");
+		}
+		osi(0, "}\n");
+		osi(0, "\n");
+
+		osi(0, "static inline int equal__prim_%s(", map->name);
+		out_prim_params(map, "a");
+		out_src(", ");
+		out_prim_params(map, "b");
+		out_src(")\n");
+		osi(0, "{\n");
+		hook = lookup_hook(map, "equal");
+		if (hook) {
+			osi(1, "return %s(", hook);
+			out_prim_args(map, "a");
+			out_src(", ");
+			out_prim_args(map, "b");
+			out_src(");\n");
+		} else {
+			osi(1, "struct dump_buffer text_a, text_b;\n");
+			osi(1, "int ret;\n");
+			helper_prim_text(map, "text_a", "a", 1);
+			helper_prim_text(map, "text_b", "b", 1);
+			osi(1, "ret = !text_a.err && !text_b.err && "
+					"text_a.len == text_b.len &&\n");
+			osi(3, "(!text_a.len || "
+					"!memcmp(text_a.data, text_b.data, text_a.len));\n");
+			osi(1, "free(text_a.data);\n");
+			osi(1, "free(text_b.data);\n");
+			osi(1, "return ret;\n");
+		}
+		osi(0, "}\n");
+		osi(0, "\n");
+	}
+}
+
+static void helper_hash_value(const struct node_vec_def *vec,
+		const struct type_decl *decl,
+		const struct string_list *vars, string sub)
+{
+	switch (decl->type) {
+	case TYPE_DECL_PRIM:
+		out_src("hash__prim_%s(", decl->type_name);
+		break;
+	case TYPE_DECL_ENUM:
+		out_src("(uint64_t)value->%s%s", vars->str, sub);
+		return;
+	case TYPE_DECL_STRUCT:
+		out_src("hash__struct_%s(tree, ", decl->type_name);
+		break;
+	case TYPE_DECL_UNION:
+		out_src("hash__union_%s(tree, ", decl->type_name);
+		break;
+	}
+	out_value_ref("&value->", sub, vec, decl, vars);
+	out_src(")");
+}
+
+static void helper_hash(const struct node_vec_def *vec,
+		const struct type_decl *decl, const struct string_list *vars,
+		int l)
+{
+	string acc = has_node(decl) ? "e" : "h";
+
+	if (vec->type == NODE_TYPE_SCALE || vec->type == NODE_TYPE_BOUNDED) {
+		osi(l, "h = config_hash_mix(h, ");
+		helper_hash_value(vec, decl, vars, "");
+		out_src(");\n");
+		return;
+	}
+	/* an array of structs or unions is a node of its own */
+	if (has_node(decl)) {
+		osi(l, "{\n");
+		++l;
+		osi(l, "long m = config_hash_push(tree);\n");
+		osi(l, "uint64_t e = CONFIG_HASH_BASIS;\n");
+	}
+	osi(l, "%s = config_hash_mix(%s, (uint64_t)", acc, acc);
+	out_vec_len(vec, "value->");
+	out_src(");\n");
+	osi(l, "for (i = 0; i < ");
+	out_vec_len(vec, "value->");
+	out_src("; ++i) {\n");
+	osi(l + 1, "%s = config_hash_mix(%s, ", acc, acc);
+	helper_hash_value(vec, decl, vars, "[i]");
+	out_src(");\n");
+	osi(l, "}\n"); /* for */
+	if (has_node(decl)) {
+		osi(l, "config_hash_set(tree, m, e);\n");
+		osi(l, "h = config_hash_mix(h, e);\n");
+		--l;
+		osi(l, "}\n");
+	}
+}
+
+static void hash_struct(string name, const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static uint64_t hash__struct_%s(struct config_hash *tree, "
+			"const struct %s *value)\n", name, name);
+	osi(0, "{\n");
+	osi(1, "long i, n = config_hash_push(tree);\n");
+	osi(1, "uint64_t h = CONFIG_HASH_BASIS;\n");
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible) {
+			continue;
+		}
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(memb, &decl);
+			helper_hash(&memb->vec, &decl, memb->mapped, 1);
+			continue;
+		}
+		osi(1, "h = config_hash_mix(h, (uint64_t)value->%s);\n",
+				memb->alt_enum);
+		for (alt = memb->alters; alt; alt = alt->next) {
+			osi(1, "if (value->%s == %s) {\n",
+					memb->alt_enum, alt->enum_val);
+			decl_of_alter(alt, &decl);
+			helper_hash(&alt->vec, &decl, alt->mapped, 2);
+			osi(1, "}\n"); /* if */
+		}
+	}
+	osi(1, "config_hash_set(tree, n, h);\n");
+	osi(1, "return h;\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void hash_union(string name, string enum_name,
+		const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static uint64_t hash__union_%s(struct config_hash *tree, "
+			"const union %s *value, "
+			"const enum %s *type_value)\n", name, name, enum_name);
+	osi(0, "{\n");
+	osi(1, "long i, n = config_hash_push(tree);\n");
+	osi(1, "uint64_t h = config_hash_mix(CONFIG_HASH_BASIS, "
+			"(uint64_t)*type_value);\n");
+	for (alt = list; alt; alt = alt->next) {
+		osi(1, "if (*type_value == %s) {\n", alt->enum_val);
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			decl_of_alter(alt, &decl);
+			helper_hash(&alt->vec, &decl, alt->mapped, 2);
+		}
+		for (memb = alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT ?
+				alt->members : NULL; memb; memb = memb->next) {
+			decl_of_member(memb, &decl);
+			helper_hash(&memb->vec, &decl, memb->mapped, 2);
+		}
+		osi(1, "}\n"); /* if */
+	}
+	osi(1, "config_hash_set(tree, n, h);\n");
+	osi(1, "return h;\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void hash_type_def_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_TYPE_DEF_ENUM:
+			break;
+		case NODE_TYPE_DEF_STRUCT:
+			hash_struct(list->struct_def.name,
+					list->struct_def.members);
+			break;
+		case NODE_TYPE_DEF_UNION:
+			hash_union(list->union_def.name,
+					list->union_def.enum_name,
+					list->union_def.alters);
+			break;
+		}
+	}
+}
+
+/* an expression, true if the values are equal */
+static void helper_equal_value(const struct node_vec_def *vec,
+		const struct type_decl *decl,
+		const struct string_list *vars, string sub)
+{
+	switch (decl->type) {
+	case TYPE_DECL_PRIM:
+		out_src("equal__prim_%s(", decl->type_name);
+		break;
+	case TYPE_DECL_ENUM:
+		out_src("a->%s%s == b->%s%s", vars->str, sub, vars->str, sub);
+		return;
+	case TYPE_DECL_STRUCT:
+		out_src("equal__struct_%s(", decl->type_name);
+		break;
+	case TYPE_DECL_UNION:
+		out_src("equal__union_%s(", decl->type_name);
+		break;
+	}
+	out_value_ref("&a->", sub, vec, decl, vars);
+	out_src(", ");
+	out_value_ref("&b->", sub, vec, decl, vars);
+	out_src(")");
+}
+
+static void helper_equal(const struct node_vec_def *vec,
+		const struct type_decl *decl, const struct string_list *vars,
+		int l)
+{
+	if (vec->type == NODE_TYPE_SCALE || vec->type == NODE_TYPE_BOUNDED) {
+		osi(l, "if (!(");
+		helper_equal_value(vec, decl, vars, "");
+		out_src(")) {\n");
+		osi(l + 1, "return 0;\n");
+		osi(l, "}\n");
+		return;
+	}
+	if (vec->type == NODE_TYPE_VAR_ARR) {
+		osi(l, "if (a->%s != b->%s) {\n", vec->len_str, vec->len_str);
+		osi(l + 1, "return 0;\n");
+		osi(l, "}\n");
+	}
+	osi(l, "for (i = 0; i < ");
+	out_vec_len(vec, "a->");
+	out_src("; ++i) {\n");
+	osi(l + 1, "if (!(");
+	helper_equal_value(vec, decl, vars, "[i]");
+	out_src(")) {\n");
+	osi(l + 2, "return 0;\n");
+	osi(l + 1, "}\n");
+	osi(l, "}\n"); /* for */
+}
+
+static void equal_struct(string name, const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static int equal__struct_%s(const struct %s *a, "
+			"const struct %s *b)\n", name, name, name);
+	osi(0, "{\n");
+	osi(1, "long i;\n");
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible) {
+			continue;
+		}
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(memb, &decl);
+			helper_equal(&memb->vec, &decl, memb->mapped, 1);
+			continue;
+		}
+		osi(1, "if (a->%s != b->%s) {\n",
+				memb->alt_enum, memb->alt_enum);
+		osi(2, "return 0;\n");
+		osi(1, "}\n");
+		for (alt = memb->alters; alt; alt = alt->next) {
+			osi(1, "if (a->%s == %s) {\n",
+					memb->alt_enum, alt->enum_val);
+			decl_of_alter(alt, &decl);
+			helper_equal(&alt->vec, &decl, alt->mapped, 2);
+			osi(1, "}\n"); /* if */
+		}
+	}
+	osi(1, "return 1;\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void equal_union(string name, string enum_name,
+		const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static int equal__union_%s(const union %s *a, "
+			"const enum %s *a_type, const union %s *b, "
+			"const enum %s *b_type)\n",
+			name, name, enum_name, name, enum_name);
+	osi(0, "{\n");
+	osi(1, "long i;\n");
+	osi(1, "if (*a_type != *b_type) {\n");
+	osi(2, "return 0;\n");
+	osi(1, "}\n");
+	for (alt = list; alt; alt = alt->next) {
+		osi(1, "if (*a_type == %s) {\n", alt->enum_val);
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			decl_of_alter(alt, &decl);
+			helper_equal(&alt->vec, &decl, alt->mapped, 2);
+		}
+		for (memb = alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT ?
+				alt->members : NULL; memb; memb = memb->next) {
+			decl_of_member(memb, &decl);
+			helper_equal(&memb->vec, &decl, memb->mapped, 2);
+		}
+		osi(1, "}\n"); /* if */
+	}
+	osi(1, "return 1;\n");
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void equal_type_def_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_TYPE_DEF_ENUM:
+			break;
+		case NODE_TYPE_DEF_STRUCT:
+			equal_struct(list->struct_def.name,
+					list->struct_def.members);
+			break;
+		case NODE_TYPE_DEF_UNION:
+			equal_union(list->union_def.name,
+					list->union_def.enum_name,
+					list->union_def.alters);
+			break;
+		}
+	}
+}
+
+static void helper_diff_call(const struct type_decl *decl,
+		const struct string_list *vars, string sub,
+		string ia, string ib, int l)
+{
+	osi(l, "diff__%s_%s(d, %s, %s, ",
+			decl->type == TYPE_DECL_STRUCT ? "struct" : "union",
+			decl->type_name, ia, ib);
+	out_str_list(0, "&a->", sub, vars);
+	out_src(", ");
+	out_str_list(0, "&b->", sub, vars);
+	out_src(");\n");
+}
+
+/* the array is reported as a whole if the lengths differ */
+static void helper_diff_len(const struct node_vec_def *vec, string name,
+		int l)
+{
+	osi(l, "if (a->%s != b->%s) {\n", vec->len_str, vec->len_str);
+	osi(l + 1, "config_diff_report(d, \".%s\");\n", name);
+	osi(l, "} else {\n");
+}
+
+static void helper_diff(const struct node_vec_def *vec,
+		const struct type_decl *decl, string name,
+		const struct string_list *vars, int l)
+{
+	int k = l + 1;
+
+	if (!has_node(decl) && (vec->type == NODE_TYPE_SCALE ||
+				vec->type == NODE_TYPE_BOUNDED)) {
+		osi(l, "if (!(");
+		helper_equal_value(vec, decl, vars, "");
+		out_src(")) {\n");
+		osi(l + 1, "config_diff_report(d, \".%s\");\n", name);
+		osi(l, "}\n");
+		return;
+	}
+	if (!has_node(decl)) {
+		if (vec->type == NODE_TYPE_VAR_ARR) {
+			helper_diff_len(vec, name, l);
+			++l;
+		}
+		osi(l, "for (i = 0; i < ");
+		out_vec_len(vec, "a->");
+		out_src("; ++i) {\n");
+		osi(l + 1, "if (!(");
+		helper_equal_value(vec, decl, vars, "[i]");
+		out_src(")) {\n");
+		osi(l + 2, "config_diff_report(d, \".%s[%%ld]\", i);\n", name);
+		osi(l + 1, "}\n");
+		osi(l, "}\n"); /* for */
+		if (vec->type == NODE_TYPE_VAR_ARR) {
+			osi(l - 1, "}\n");
+		}
+		return;
+	}
+
+	osi(l, "if (d->a->hash[ca] != d->b->hash[cb]) {\n");
+	if (vec->type == NODE_TYPE_SCALE) {
+		osi(k, "size_t len = config_diff_enter(d, \".%s\");\n", name);
+		helper_diff_call(decl, vars, "", "ca", "cb", k);
+		osi(k, "config_diff_leave(d, len);\n");
+	} else {
+		if (vec->type == NODE_TYPE_VAR_ARR) {
+			helper_diff_len(vec, name, k);
+			++k;
+		}
+		osi(k, "long ea = ca + 1, eb = cb + 1;\n");
+		osi(k, "for (i = 0; i < ");
+		out_vec_len(vec, "a->");
+		out_src("; ++i) {\n");
+		osi(k + 1, "if (d->a->hash[ea] != d->b->hash[eb]) {\n");
+		osi(k + 2, "size_t len = config_diff_enter(d, "
+				"\".%s[%%ld]\", i);\n", name);
+		helper_diff_call(decl, vars, "[i]", "ea", "eb", k + 2);
+		osi(k + 2, "config_diff_leave(d, len);\n");
+		osi(k + 1, "}\n");
+		osi(k + 1, "ea = d->a->next[ea];\n");
+		osi(k + 1, "eb = d->b->next[eb];\n");
+		osi(k, "}\n"); /* for */
+		if (vec->type == NODE_TYPE_VAR_ARR) {
+			osi(k - 1, "}\n");
+		}
+	}
+	osi(l, "}\n");
+	osi(l, "ca = d->a->next[ca];\n");
+	osi(l, "cb = d->b->next[cb];\n");
+}
+
+/* a member of an anonymous union selected on one side only */
+static void helper_diff_side(const struct node_member_list *memb,
+		string side, int l)
+{
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	for (alt = memb->alters; alt; alt = alt->next) {
+		osi(l, "if (%s->%s == %s) {\n",
+				side, memb->alt_enum, alt->enum_val);
+		osi(l + 1, "config_diff_report(d, \".%s\");\n", alt->in_name);
+		decl_of_alter(alt, &decl);
+		if (has_node(&decl)) {
+			osi(l + 1, "c%s = d->%s->next[c%s];\n", side, side, side);
+		}
+		osi(l, "}\n");
+	}
+}
+
+static void diff_struct(string name, const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void diff__struct_%s(struct config_diff *d, "
+			"long ia, long ib, const struct %s *a, "
+			"const struct %s *b)\n", name, name, name);
+	osi(0, "{\n");
+	osi(1, "long i%s;\n", members_have_node(list) ?
+			", ca = ia + 1, cb = ib + 1" : "");
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible) {
+			continue;
+		}
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(memb, &decl);
+			helper_diff(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 1);
+			continue;
+		}
+		osi(1, "if (a->%s != b->%s) {\n",
+				memb->alt_enum, memb->alt_enum);
+		helper_diff_side(memb, "a", 2);
+		helper_diff_side(memb, "b", 2);
+		osi(1, "} else {\n");
+		for (alt = memb->alters; alt; alt = alt->next) {
+			osi(2, "if (a->%s == %s) {\n",
+					memb->alt_enum, alt->enum_val);
+			decl_of_alter(alt, &decl);
+			helper_diff(&alt->vec, &decl, alt->in_name,
+					alt->mapped, 3);
+			osi(2, "}\n"); /* if */
+		}
+		osi(1, "}\n");
+	}
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void diff_union(string name, string enum_name,
+		const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void diff__union_%s(struct config_diff *d, "
+			"long ia, long ib, const union %s *a, "
+			"const enum %s *a_type, const union %s *b, "
+			"const enum %s *b_type)\n",
+			name, name, enum_name, name, enum_name);
+	osi(0, "{\n");
+	osi(1, "long i%s;\n", alters_have_node(list) ?
+			", ca = ia + 1, cb = ib + 1" : "");
+	osi(1, "if (*a_type != *b_type) {\n");
+	osi(2, "config_diff_report(d, NULL);\n");
+	osi(2, "return;\n");
+	osi(1, "}\n");
+	for (alt = list; alt; alt = alt->next) {
+		osi(1, "if (*a_type == %s) {\n", alt->enum_val);
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			decl_of_alter(alt, &decl);
+			helper_diff(&alt->vec, &decl, alt->in_name,
+					alt->mapped, 2);
+		}
+		for (memb = alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT ?
+				alt->members : NULL; memb; memb = memb->next) {
+			decl_of_member(memb, &decl);
+			helper_diff(&memb->vec, &decl, memb->in_name,
+					memb->mapped, 2);
+		}
+		osi(1, "}\n"); /* if */
+	}
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void diff_type_def_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_TYPE_DEF_ENUM:
+			break;
+		case NODE_TYPE_DEF_STRUCT:
+			diff_struct(list->struct_def.name,
+					list->struct_def.members);
+			break;
+		case NODE_TYPE_DEF_UNION:
+			diff_union(list->union_def.name,
+					list->union_def.enum_name,
+					list->union_def.alters);
+			break;
+		}
+	}
+}
+
+
+/*
+ * Packing into one block.
+ * pack__* copies the arrays and the storage of types with a pack hook of a
+ * value into the block of a struct config_pack, depth first, and points the
+ * value at the copies; see struct config_pack for the other two passes.
+ */
+static int needs_pack(const struct type_decl *decl)
+{
+	switch (decl->type) {
+	case TYPE_DECL_PRIM:
+		return lookup_hook(lookup_map(decl->type_name), "pack") != NULL;
+	case TYPE_DECL_ENUM:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+/* whether pack__* has anything to do for a member */
+static int member_needs_pack(const struct node_vec_def *vec,
+		const struct type_decl *decl)
+{
+	if (vec->type == NODE_TYPE_BOUNDED) {
+		return vec->spill && needs_pack(decl);
+	}
+	return (vec->type == NODE_TYPE_VAR_ARR && !vec->cap) ||
+		needs_pack(decl);
+}
+
+static void helper_pack_value(const struct type_decl *decl,
+		const struct string_list *vars, string sub, int l)
+{
+	switch (decl->type) {
+	case TYPE_DECL_PRIM:
+		osi(l, "%s(p, ", lookup_hook(lookup_map(decl->type_name),
+					"pack"));
+		break;
+	case TYPE_DECL_ENUM:
+		return;
+	case TYPE_DECL_STRUCT:
+		osi(l, "pack__struct_%s(p, ", decl->type_name);
+		break;
+	case TYPE_DECL_UNION:
+		osi(l, "pack__union_%s(p, ", decl->type_name);
+		break;
+	}
+	out_str_list(0, "&value->", sub, vars);
+	out_src(");\n");
+}
+
+static void helper_pack(const struct node_vec_def *vec,
+		const struct type_decl *decl, const struct string_list *vars,
+		int l)
+{
+	const struct string_list *var;
+
+	if (vec->type == NODE_TYPE_SCALE) {
+		if (needs_pack(decl)) {
+			helper_pack_value(decl, vars, "", l);
+		}
+		return;
+	}
+	if (vec->type == NODE_TYPE_BOUNDED) {
+		/* stored inline unless spilled */
+		if (vec->spill && needs_pack(decl)) {
+			osi(l, "%s(p, &value->%s_spill);\n",
+					lookup_hook(lookup_map(decl->type_name),
+						"pack"), vars->str);
+		}
+		return;
+	}
+	if (vec->type == NODE_TYPE_VAR_ARR && !vec->cap) {
+		for (var = vars; var; var = var->next) {
+			osi(l, "q = config_pack_ptr(p, value->%s, "
+					"value->%s * sizeof(*value->%s),\n",
+					var->str, vec->len_str, var->str);
+			osi(l + 2, "__alignof__(*value->%s));\n", var->str);
+			osi(l, "if (p->base) {\n");
+			osi(l + 1, "value->%s = q;\n", var->str);
+			osi(l, "}\n"); /* if */
+		}
+	}
+	if (!needs_pack(decl)) {
+		return;
+	}
+	osi(l, "for (i = 0; i < ");
+	out_vec_len(vec, "value->");
+	out_src("; ++i) {\n");
+	helper_pack_value(decl, vars, "[i]", l + 1);
+	osi(l, "}\n"); /* for */
+}
+
+/* the locals helper_pack uses: i for the loop, q for the copy of an array */
+enum {
+	PACK_VAR_I = 1,
+	PACK_VAR_Q = 2,
+};
+
+static int helper_pack_vars(const struct node_vec_def *vec,
+		const struct type_decl *decl)
+{
+	if (vec->type == NODE_TYPE_SCALE || vec->type == NODE_TYPE_BOUNDED) {
+		return 0;
+	}
+	return (vec->type == NODE_TYPE_VAR_ARR && !vec->cap ? PACK_VAR_Q : 0) |
+		(needs_pack(decl) ? PACK_VAR_I : 0);
+}
+
+static int struct_pack_vars(const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+	int vars = 0;
+
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible && !memb->default_val) {
+			continue;
+		}
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(memb, &decl);
+			vars |= helper_pack_vars(&memb->vec, &decl);
+			continue;
+		}
+		for (alt = memb->alters; alt; alt = alt->next) {
+			decl_of_alter(alt, &decl);
+			vars |= helper_pack_vars(&alt->vec, &decl);
+		}
+	}
+	return vars;
+}
+
+static int union_pack_vars(const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+	int vars = 0;
+
+	for (alt = list; alt; alt = alt->next) {
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			decl_of_alter(alt, &decl);
+			vars |= helper_pack_vars(&alt->vec, &decl);
+			continue;
+		}
+		for (memb = alt->members; memb; memb = memb->next) {
+			decl_of_member(memb, &decl);
+			vars |= helper_pack_vars(&memb->vec, &decl);
+		}
+	}
+	return vars;
+}
+
+static void helper_pack_decl_vars(int vars)
+{
+	if (vars & PACK_VAR_I) {
+		osi(1, "long i;\n");
+	}
+	if (vars & PACK_VAR_Q) {
+		osi(1, "void *q;\n");
+	}
+}
+
+static void pack_struct(string name, const struct node_member_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void pack__struct_%s(struct config_pack *p, "
+			"struct %s *value)\n", name, name);
+	osi(0, "{\n");
+	helper_pack_decl_vars(struct_pack_vars(list));
+	for (memb = list; memb; memb = memb->next) {
+		if (!memb->visible && !memb->default_val) {
+			continue;
+		}
+		if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
+			decl_of_member(memb, &decl);
+			helper_pack(&memb->vec, &decl, memb->mapped, 1);
+			continue;
+		}
+		for (alt = memb->alters; alt; alt = alt->next) {
+			decl_of_alter(alt, &decl);
+			if (!member_needs_pack(&alt->vec, &decl)) {
+				continue;
+			}
+			osi(1, "if (value->%s == %s) {\n",
+					memb->alt_enum, alt->enum_val);
+			helper_pack(&alt->vec, &decl, alt->mapped, 2);
+			osi(1, "}\n"); /* if */
+		}
+	}
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void pack_union(string name, string enum_name,
+		const struct node_alter_list *list)
+{
+	const struct node_member_list *memb;
+	const struct node_alter_list *alt;
+	struct type_decl decl;
+
+	osi(0, "static void pack__union_%s(struct config_pack *p, "
+			"union %s *value, enum %s *type_value)\n",
+			name, name, enum_name);
+	osi(0, "{\n");
+	helper_pack_decl_vars(union_pack_vars(list));
+	for (alt = list; alt; alt = alt->next) {
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			decl_of_alter(alt, &decl);
+			if (!member_needs_pack(&alt->vec, &decl)) {
+				continue;
+			}
+		}
+		osi(1, "if (*type_value == %s) {\n", alt->enum_val);
+		if (alt->type != NODE_ALTER_DEF_UNNAMED_STRUCT) {
+			helper_pack(&alt->vec, &decl, alt->mapped, 2);
+		}
+		for (memb = alt->type == NODE_ALTER_DEF_UNNAMED_STRUCT ?
+				alt->members : NULL; memb; memb = memb->next) {
+			decl_of_member(memb, &decl);
+			helper_pack(&memb->vec, &decl, memb->mapped, 2);
+		}
+		osi(1, "}\n"); /* if */
+	}
+	osi(0, "}\n"); /* func body */
+	osi(0, "\n");
+}
+
+static void pack_type_def_list(const struct node_type_def_list *list)
+{
+	for (; list; list = list->next) {
+		switch (list->type) {
+		case NODE_TYPE_DEF_ENUM:
+			break;
+		case NODE_TYPE_DEF_STRUCT:
+			pack_struct(list->struct_def.name,
+					list->struct_def.members);
+			break;
+		case NODE_TYPE_DEF_UNION:
+			pack_union(list->union_def.name,
+					list->union_def.enum_name,
+					list->union_def.alters);
+			break;
+		}
+	}
+}
+
+
+const char *spec_path;
+const char *prim_path;
+const char *prelude_path;
+const char *hdr_path;
+const char *src_path;
+const char *include_guard;
+int test_default;
+int do_help;
+int do_version;
+
+const char *help_msg;
+
+struct option opts[] = {
+	{ "spec_path", required_argument, 0, 0 },
 	{ "prim_path", required_argument, 0, 0 },
 	{ "prelude_path", required_argument, 0, 0 },
 	{ "hdr_path", required_argument, 0, 0 },
@@ -2007,82 +4304,672 @@ int parse_opts(int argc, char **argv)
 	return 0;
 }
 
-extern FILE *yyin;
-FILE *fp_prelude;
-FILE *fp_prim;
+extern FILE *yyin;
+FILE *fp_prelude;
+FILE *fp_prim;
+
+void copy_file(FILE *dst, FILE *src)
+{
+	int c;
+	while (1) {
+		c = fgetc(src);
+		if (c == EOF) {
+			break;
+		}
+		if (putc(c, dst) == EOF) {
+			ERR("failed to write to file.\n");
+		}
+	}
+}
+
+const char indent_dump_fmt[] = 
+"static inline void indent(put_func put_func, struct dump_context *ctx, int indents)\n"
+"{\n"
+"        int i;\n"
+"        for (i = 0; i < indents; ++i) {\n"
+"                put_func(ctx, \"  \");\n"
+"        }\n"
+"}\n"
+"\n";
+
+const char config_allocator_of_fmt[] =
+"static inline struct config_allocator *config_allocator_of_%s(\n"
+"                const struct %s *value)\n"
+"{\n"
+"        return value->config2c_alloc;\n"
+"}\n"
+"\n";
+
+const char config_allocator_of_none_fmt[] =
+"static inline struct config_allocator *config_allocator_of_%s(\n"
+"                const struct %s *value)\n"
+"{\n"
+"        return NULL;\n"
+"}\n"
+"\n";
+
+const char config_convert_fmt[] =
+"static inline struct config_arena *config_arena_of_%s(const struct %s *value)\n"
+"{\n"
+"        return NULL;\n"
+"}\n"
+"\n"
+"static int config_convert_%s(struct pass_to_conv *ctx, void *value,\n"
+"                const void *old, const struct node_value *input)\n"
+"{\n"
+"        return parse__struct_%s(ctx, value, input);\n"
+"}\n"
+"\n";
+
+const char config_convert_arena_fmt[] =
+"static inline struct config_arena *config_arena_of_%s(const struct %s *value)\n"
+"{\n"
+"        return value->config2c_arena;\n"
+"}\n"
+"\n"
+"static int config_convert_%s(struct pass_to_conv *ctx, void *p,\n"
+"                const void *old, const struct node_value *input)\n"
+"{\n"
+"        struct %s *value = p;\n"
+"        int ret;\n"
+"\n"
+"        ctx->arena = config_arena_new(ctx->alloc);\n"
+"        if (!ctx->arena) {\n"
+"                ctx->node = input;\n"
+"                ctx->msg = \"memory insufficient.\";\n"
+"                return -ENOMEM;\n"
+"        }\n"
+"        ret = parse__struct_%s(ctx, value, input);\n"
+"        if (ret) {\n"
+"                config_arena_free(ctx->arena);\n"
+"        } else {\n"
+"                value->config2c_arena = ctx->arena;\n"
+"        }\n"
+"        ctx->arena = NULL;\n"
+"        return ret;\n"
+"}\n"
+"\n";
+
+const char parser_func_fmt[] =
+"static int config_parse_by_%s(struct %s *value, const char *path,\n"
+"                struct config_allocator *alloc, const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"\n"
+"        ret = yacc_parse_file(path, err_msg, &opaque);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                alloc, NULL,\n"
+"                                config_convert_%s, value, NULL, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n"
+"int config_parse_%s(struct %s *value, const char *path, const char **err_msg)\n"
+"{\n"
+"        return config_parse_by_%s(value, path, NULL, err_msg);\n"
+"}\n"
+"\n";
+
+const char config_parse_with_fmt[] =
+"int config_parse_with_%s(struct %s *value, const char *path,\n"
+"                struct config_allocator *alloc, const char **err_msg)\n"
+"{\n"
+"        return config_parse_by_%s(value, path, alloc, err_msg);\n"
+"}\n"
+"\n";
+
+const char parser_parallel_func_fmt[] =
+"int config_parse_parallel_%s(struct %s *value, const char *path, int nthreads,\n"
+"                const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"\n"
+"        ret = yacc_parse_file_parallel(path, err_msg, &opaque, nthreads);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                NULL, NULL,\n"
+"                                config_convert_%s, value, NULL, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n";
+
+const char parser_cached_func_fmt[] =
+"int config_parse_cached_%s(struct %s *value, const char *path,\n"
+"                struct parse_cache *cache, const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"        opaque.cache = cache;\n"
+"\n"
+"        ret = yacc_parse_file(path, err_msg, &opaque);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                NULL, NULL,\n"
+"                                config_convert_%s, value, NULL, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n";
+
+const char parser_layered_func_fmt[] =
+"int config_parse_layered_%s(struct %s *value, const char *const *paths,\n"
+"                int n, const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"\n"
+"        ret = yacc_parse_layers(paths, n, err_msg, &opaque);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                NULL, NULL,\n"
+"                                config_convert_%s, value, NULL, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n";
+
+const char config_apply_fmt[] =
+"static int config_apply_conv_%s(struct pass_to_conv *ctx, void *value,\n"
+"                const void *old, const struct node_value *input)\n"
+"{\n"
+"        return apply__struct_%s(ctx, value, input);\n"
+"}\n"
+"\n"
+"int config_apply_%s(struct %s *value, const char *fragment,\n"
+"                const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"\n"
+"        ret = yacc_parse_fragment(fragment, err_msg, &opaque);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                config_allocator_of_%s(value),\n"
+"                                config_arena_of_%s(value),\n"
+"                                config_apply_conv_%s, value, NULL, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n";
+
+const char config_reparse_fmt[] =
+"static int config_reparse_conv_%s(struct pass_to_conv *ctx, void *value,\n"
+"                const void *old, const struct node_value *input)\n"
+"{\n"
+"        return reparse__struct_%s(ctx, value, old, input);\n"
+"}\n"
+"\n"
+"int config_reparse_%s(const struct %s *old, const char *path,\n"
+"                struct %s *value, const char **err_msg)\n"
+"{\n"
+"        struct pass_to_bison opaque;\n"
+"        struct mem_pool pool;\n"
+"        int ret;\n"
+"\n"
+"        mem_pool_init(&pool);\n"
+"        init_pass_to_bison(&opaque, &pool);\n"
+"\n"
+"        ret = yacc_parse_file(path, err_msg, &opaque);\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                config_allocator_of_%s(old),\n"
+"                                config_arena_of_%s(old),\n"
+"                                config_reparse_conv_%s, value, old, err_msg);\n"
+"        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n"
+"void config_release_%s(struct %s *old, const struct %s *value)\n"
+"{\n"
+"        struct pass_to_conv context;\n"
+"\n"
+"        memset(&context, 0, sizeof(context));\n"
+"        context.alloc = config_allocator_of_%s(old);\n"
+"        unshare__struct_%s(&context, old, value);\n"
+"}\n"
+"\n";
+
+const char config_snapshot_fmt[] =
+"static void config_snapshot_free_%s(void *value)\n"
+"{\n"
+"        config_free_%s(value);\n"
+"        free(value);\n"
+"}\n"
+"\n"
+"static int config_snapshot_parse_%s(struct %s *value, const char *path,\n"
+"                const char **err_msg)\n"
+"{\n"
+"        return config_parse_%s(value, path, err_msg);\n"
+"}\n"
+"\n";
 
-void copy_file(FILE *dst, FILE *src)
-{
-	int c;
-	while (1) {
-		c = fgetc(src);
-		if (c == EOF) {
-			break;
-		}
-		if (putc(c, dst) == EOF) {
-			ERR("failed to write to file.\n");
-		}
-	}
-}
+/* the next snapshot is reparsed from the current one */
+const char config_snapshot_reparse_fmt[] =
+"static struct config_rcu config_rcu_%s;\n"
+"\n"
+"/* called after publishing the successor of value, if any */\n"
+"static void config_snapshot_free_%s(void *value)\n"
+"{\n"
+"        const struct %s *next = config_rcu_%s.current;\n"
+"\n"
+"        if (next) {\n"
+"                config_release_%s(value, next);\n"
+"        } else {\n"
+"                config_free_%s(value);\n"
+"        }\n"
+"        free(value);\n"
+"}\n"
+"\n"
+"/* under the lock of config_reload_*, no other reload frees the current one */\n"
+"static int config_snapshot_parse_%s(struct %s *value, const char *path,\n"
+"                const char **err_msg)\n"
+"{\n"
+"        const struct %s *old = config_rcu_%s.current;\n"
+"\n"
+"        if (!old) {\n"
+"                return config_parse_%s(value, path, err_msg);\n"
+"        }\n"
+"        return config_reparse_%s(old, path, value, err_msg);\n"
+"}\n"
+"\n";
 
-const char indent_dump_fmt[] = 
-"static inline void indent(put_func put_func, struct dump_context *ctx, int indents)\n"
+const char config_reload_fmt[] =
+"static struct config_rcu config_rcu_%s =\n"
+"        CONFIG_RCU_INITIALIZER(config_snapshot_free_%s);\n"
+"\n"
+"static struct config_subs config_subs_%s = CONFIG_SUBS_INITIALIZER;\n"
+"\n"
+"const struct %s *config_current_%s(struct config_pin *pin)\n"
 "{\n"
-"        int i;\n"
-"        for (i = 0; i < indents; ++i) {\n"
-"                put_func(ctx, \"  \");\n"
+"        return config_rcu_pin(&config_rcu_%s, pin);\n"
+"}\n"
+"\n"
+"/* marks the subscriptions to the subtrees changed by value */\n"
+"static void config_subs_diff_%s(const struct %s *value)\n"
+"{\n"
+"        struct config_subs *subs = &config_subs_%s;\n"
+"        const struct %s *old = config_rcu_%s.current;\n"
+"        struct config_hash tree = CONFIG_HASH_INITIALIZER;\n"
+"\n"
+"        if (!subs->list) {\n"
+"                config_hash_free(&subs->tree);\n"
+"                return;\n"
+"        }\n"
+"        if (old && !subs->tree.n) {\n"
+"                config_hash_%s(old, &subs->tree);\n"
+"        }\n"
+"        config_hash_%s(value, &tree);\n"
+"        if (!old || config_diff_%s(old, &subs->tree, value, &tree,\n"
+"                                config_sub_changed, subs) < 0) {\n"
+"                config_sub_changed(NULL, subs);\n"
+"        }\n"
+"        config_hash_free(&subs->tree);\n"
+"        subs->tree = tree;\n"
+"}\n"
+"\n"
+"int config_reload_%s(const char *path, const char **err_msg)\n"
+"{\n"
+"        struct %s *value = NULL;\n"
+"        int ret;\n"
+"\n"
+"        if (path) {\n"
+"                value = malloc(sizeof(*value));\n"
+"                if (!value) {\n"
+"                        *err_msg = make_message(\"failed to allocate config\");\n"
+"                        return -ENOMEM;\n"
+"                }\n"
+"        }\n"
+"        /* the current snapshot stays until this reload publishes another */\n"
+"        pthread_mutex_lock(&config_subs_%s.lock);\n"
+"        if (value) {\n"
+"                ret = config_snapshot_parse_%s(value, path, err_msg);\n"
+"                if (ret) {\n"
+"                        pthread_mutex_unlock(&config_subs_%s.lock);\n"
+"                        free(value);\n"
+"                        return ret;\n"
+"                }\n"
+"                config_subs_diff_%s(value);\n"
+"        } else {\n"
+"                config_hash_free(&config_subs_%s.tree);\n"
 "        }\n"
+"        config_rcu_publish(&config_rcu_%s, value);\n"
+"        config_subs_notify(&config_subs_%s, &config_rcu_%s);\n"
+"        pthread_mutex_unlock(&config_subs_%s.lock);\n"
+"        return 0;\n"
 "}\n"
 "\n";
 
-const char parser_func_fmt[] =
-"int config_parse_%s(struct %s *value, const char *path, const char **err_msg)\n"
+const char config_subscribe_fmt[] =
+"struct config_sub_%s {\n"
+"        void (*on_change)(const struct %s *value, void *arg);\n"
+"        void *arg;\n"
+"};\n"
+"\n"
+"static void config_sub_call_%s(const void *value, void *arg)\n"
+"{\n"
+"        struct config_sub_%s *p = arg;\n"
+"        p->on_change(value, p->arg);\n"
+"}\n"
+"\n"
+"struct config_sub *config_subscribe_%s(const char *path,\n"
+"                void (*on_change)(const struct %s *value, void *arg),\n"
+"                void *arg)\n"
+"{\n"
+"        struct config_sub_%s *p = malloc(sizeof(*p));\n"
+"        struct config_sub *s;\n"
+"\n"
+"        if (!p) {\n"
+"                return NULL;\n"
+"        }\n"
+"        p->on_change = on_change;\n"
+"        p->arg = arg;\n"
+"        s = config_sub_add(&config_subs_%s, path, config_sub_call_%s, p);\n"
+"        if (!s) {\n"
+"                free(p);\n"
+"        }\n"
+"        return s;\n"
+"}\n"
+"\n"
+"void config_unsubscribe_%s(struct config_sub *s)\n"
+"{\n"
+"        free(config_sub_remove(&config_subs_%s, s));\n"
+"}\n"
+"\n";
+
+const char config_watch_fmt[] =
+"struct config_watch_%s {\n"
+"        void (*on_change)(const struct %s *value, void *arg);\n"
+"        void *arg;\n"
+"};\n"
+"\n"
+"static void config_watch_notify_%s(const void *value, void *arg)\n"
+"{\n"
+"        struct config_watch_%s *p = arg;\n"
+"\n"
+"        p->on_change(value, p->arg);\n"
+"}\n"
+"\n"
+"struct config_watch *config_watch_%s(const char *path,\n"
+"                void (*on_change)(const struct %s *value, void *arg),\n"
+"                void *arg, const char **err_msg)\n"
+"{\n"
+"        struct config_watch_%s *p = malloc(sizeof(*p));\n"
+"        struct config_watch *w;\n"
+"\n"
+"        if (!p) {\n"
+"                *err_msg = make_message(\"failed to allocate watch\");\n"
+"                return NULL;\n"
+"        }\n"
+"        p->on_change = on_change;\n"
+"        p->arg = arg;\n"
+"        w = config_watch_start(path, &config_rcu_%s, config_reload_%s,\n"
+"                        config_watch_notify_%s, p, err_msg);\n"
+"        if (!w) {\n"
+"                free(p);\n"
+"        }\n"
+"        return w;\n"
+"}\n"
+"\n"
+"void config_unwatch_%s(struct config_watch *w)\n"
+"{\n"
+"        free(config_watch_stop(w));\n"
+"}\n"
+"\n";
+
+const char config_dump[] =
+"void config_dump_%s(put_func func, struct dump_context *context, const struct %s *value)\n"
+"{\n"
+"        dump__struct_%s(func, context, 0, value);\n"
+"        func(context, \"\\n\");\n"
+"}\n"
+"\n";
+
+/* %1$s struct, %2$s member, %3$s element struct, %4$s length */
+const char config_dir_fmt[] =
+"static int config_dir_conv_%1$s_%2$s(struct pass_to_conv *ctx, void *elem,\n"
+"                const void *old, const struct node_value *input)\n"
+"{\n"
+"        return parse__struct_%3$s(ctx, elem, input);\n"
+"}\n"
+"\n"
+"static int config_dir_convert_%1$s_%2$s(void *elem, const char *path,\n"
+"                const char **err_msg)\n"
 "{\n"
 "        struct pass_to_bison opaque;\n"
 "        struct mem_pool pool;\n"
-"        struct pass_to_conv context;\n"
 "        int ret;\n"
 "\n"
 "        mem_pool_init(&pool);\n"
 "        init_pass_to_bison(&opaque, &pool);\n"
 "\n"
 "        ret = yacc_parse_file(path, err_msg, &opaque);\n"
-"        if (ret) {\n"
-"                goto error;\n"
+"        if (!ret) {\n"
+"                ret = conv_parsed(&pool, opaque.output,\n"
+"                                NULL, NULL,\n"
+"                                config_dir_conv_%1$s_%2$s, elem, NULL, err_msg);\n"
 "        }\n"
+"        mem_pool_destroy(&pool);\n"
+"        return ret;\n"
+"}\n"
+"\n"
+"static void config_dir_free_%1$s_%2$s(void *elem)\n"
+"{\n"
+"        struct pass_to_conv context;\n"
+"\n"
+"        memset(&context, 0, sizeof(context));\n"
+"        free__struct_%3$s(&context, elem);\n"
+"}\n"
+"\n"
+"int config_load_dir_%1$s_%2$s(struct %1$s *value, const struct %1$s *old,\n"
+"                const char *path, struct config_dir *dir, int nthreads,\n"
+"                const char **err_msg)\n"
+"{\n"
+"        struct pass_to_conv context;\n"
+"        void *elems;\n"
+"        long len, i;\n"
+"        int ret;\n"
 "\n"
-"        context.pool = &pool;\n"
-"        ret = parse__struct_%s(&context, value, opaque.output);\n"
+"        ret = config_dir_load(dir, path, old ? old->%2$s : NULL,\n"
+"                        old ? old->%4$s : 0, sizeof(*value->%2$s),\n"
+"                        config_dir_convert_%1$s_%2$s,\n"
+"                        config_dir_free_%1$s_%2$s, nthreads,\n"
+"                        &elems, &len, err_msg);\n"
 "        if (ret) {\n"
-"                if (context.msg) {\n"
-"                        *err_msg = make_msg_loc(context.node, context.msg);\n"
-"                } else {\n"
-"                        *err_msg = make_msg_loc(context.node, \"\");\n"
-"                }\n"
-"                goto error;\n"
+"                return ret;\n"
 "        }\n"
-"\n"
-"        mem_pool_destroy(&pool);\n"
+"        memset(&context, 0, sizeof(context));\n"
+"        for (i = 0; i < value->%4$s; ++i) {\n"
+"                free__struct_%3$s(&context, &value->%2$s[i]);\n"
+"        }\n"
+"        free(value->%2$s);\n"
+"        value->%2$s = elems;\n"
+"        value->%4$s = len;\n"
 "        return 0;\n"
+"}\n"
 "\n"
-"error:\n"
-"        mem_pool_destroy(&pool);\n"
+"void config_release_dir_%1$s_%2$s(struct %1$s *old, struct config_dir *dir)\n"
+"{\n"
+"        old->%4$s = config_dir_untaken(dir, old->%2$s, old->%4$s,\n"
+"                        sizeof(*old->%2$s));\n"
+"        config_free_%1$s(old);\n"
+"}\n"
+"\n";
+
+const char config_dump_to_buffer[] =
+"int config_dump_%s_to_buffer(struct dump_buffer *buf, const struct %s *value)\n"
+"{\n"
+"        bdump__struct_%s(buf, 0, value);\n"
+"        dump_buffer_newline(buf);\n"
+"        return dump_buffer_finish(buf);\n"
+"}\n"
+"\n";
+
+const char config_hash_fmt[] =
+"uint64_t config_hash_%s(const struct %s *value, struct config_hash *tree)\n"
+"{\n"
+"        if (tree) {\n"
+"                tree->n = 0;\n"
+"                tree->err = 0;\n"
+"        }\n"
+"        return hash__struct_%s(tree, value);\n"
+"}\n"
+"\n"
+"int config_equal_%s(const struct %s *a, const struct %s *b)\n"
+"{\n"
+"        return equal__struct_%s(a, b);\n"
+"}\n"
+"\n"
+"int config_diff_%s(const struct %s *a, const struct config_hash *ta,\n"
+"                const struct %s *b, const struct config_hash *tb,\n"
+"                void (*changed)(const char *path, void *arg), void *arg)\n"
+"{\n"
+"        struct config_hash my_ta = CONFIG_HASH_INITIALIZER;\n"
+"        struct config_hash my_tb = CONFIG_HASH_INITIALIZER;\n"
+"        struct config_diff d;\n"
+"        int ret;\n"
+"\n"
+"        if (!ta) {\n"
+"                config_hash_%s(a, &my_ta);\n"
+"                ta = &my_ta;\n"
+"        }\n"
+"        if (!tb) {\n"
+"                config_hash_%s(b, &my_tb);\n"
+"                tb = &my_tb;\n"
+"        }\n"
+"        if (ta->err || tb->err || !ta->n || !tb->n) {\n"
+"                ret = -ENOMEM;\n"
+"                goto out;\n"
+"        }\n"
+"        memset(&d, 0, sizeof(d));\n"
+"        d.a = ta;\n"
+"        d.b = tb;\n"
+"        d.changed = changed;\n"
+"        d.arg = arg;\n"
+"        if (ta->hash[0] != tb->hash[0]) {\n"
+"                diff__struct_%s(&d, 0, 0, a, b);\n"
+"        }\n"
+"        free(d.path);\n"
+"        ret = d.err ? d.err : d.count;\n"
+"out:\n"
+"        config_hash_free(&my_ta);\n"
+"        config_hash_free(&my_tb);\n"
 "        return ret;\n"
 "}\n"
 "\n";
 
-const char config_dump[] =
-"void config_dump_%s(put_func func, struct dump_context *context, const struct %s *value)\n"
+const char config_pack_fmt[] =
+"struct %s *config_pack_%s(const struct %s *value, size_t *size)\n"
 "{\n"
-"        dump__struct_%s(func, context, 0, value);\n"
-"        func(context, \"\\n\");\n"
+"        struct config_pack p = { NULL, sizeof(*value), 0, 0 };\n"
+"        struct %s *packed;\n"
+"\n"
+"        /* nothing is written while sizing */\n"
+"        pack__struct_%s(&p, (struct %s *)value);\n"
+"        packed = malloc(p.len);\n"
+"        if (!packed) {\n"
+"                return NULL;\n"
+"        }\n"
+"        *size = p.len;\n"
+"        memcpy(packed, value, sizeof(*value));\n"
+"        p.base = (char *)packed;\n"
+"        p.len = sizeof(*value);\n"
+"        pack__struct_%s(&p, packed);\n"
+"        return packed;\n"
+"}\n"
+"\n"
+"struct %s *config_clone_packed_%s(const struct %s *packed, size_t size)\n"
+"{\n"
+"        struct config_pack p = { NULL, 0, 0, 1 };\n"
+"        struct %s *clone = malloc(size);\n"
+"\n"
+"        if (!clone) {\n"
+"                return NULL;\n"
+"        }\n"
+"        memcpy(clone, packed, size);\n"
+"        p.base = (char *)clone;\n"
+"        p.delta = (intptr_t)((uintptr_t)clone - (uintptr_t)packed);\n"
+"        pack__struct_%s(&p, clone);\n"
+"        return clone;\n"
+"}\n"
+"\n"
+"int config_parse_packed_%s(struct %s **value, size_t *size,\n"
+"                const char *path, const char **err_msg)\n"
+"{\n"
+"        struct %s tmp;\n"
+"        int ret;\n"
+"\n"
+"        ret = config_parse_%s(&tmp, path, err_msg);\n"
+"        if (ret) {\n"
+"                return ret;\n"
+"        }\n"
+"        *value = config_pack_%s(&tmp, size);\n"
+"        config_free_%s(&tmp);\n"
+"        if (!*value) {\n"
+"                *err_msg = make_message(\"failed to allocate packed %s\");\n"
+"                return -ENOMEM;\n"
+"        }\n"
+"        return 0;\n"
 "}\n"
 "\n";
 
 const char config_free[] =
 "void config_free_%s(struct %s *value)\n"
 "{\n"
-"        free__struct_%s(value);\n"
+"        struct pass_to_conv context;\n"
+"\n"
+"        memset(&context, 0, sizeof(context));\n"
+"        context.alloc = config_allocator_of_%s(value);\n"
+"        free__struct_%s(&context, value);\n"
+"}\n"
+"\n";
+
+const char config_free_arena_fmt[] =
+"void config_free_%s(struct %s *value)\n"
+"{\n"
+"        struct pass_to_conv context;\n"
+"\n"
+"        if (!value->config2c_arena) {\n"
+"                memset(&context, 0, sizeof(context));\n"
+"                context.alloc = config_allocator_of_%s(value);\n"
+"                free__struct_%s(&context, value);\n"
+"        }\n"
+"        config_arena_free(value->config2c_arena);\n"
+"        value->config2c_arena = NULL;\n"
+"}\n"
+"\n"
+"size_t config_arena_size_%s(const struct %s *value)\n"
+"{\n"
+"        return config_arena_size(value->config2c_arena);\n"
 "}\n"
 "\n";
 
@@ -2105,6 +4992,12 @@ void make_test_default_memb(const struct node_type_def_list *list, long id,
 	mlist.struct_def.name = struct_name;
 	mlist.struct_def.members = &mmemb;
 	mlist.struct_def.exported = 0;
+	mlist.struct_def.shared = 0;
+	mlist.struct_def.applied = 0;
+	mlist.struct_def.incremental = 0;
+	mlist.struct_def.reparsed = 0;
+	mlist.struct_def.arena = 0;
+	mlist.struct_def.allocator = 0;
 
 	mmemb = *memb;
 	mmemb.next = NULL;
@@ -2122,9 +5015,13 @@ void make_test_default_memb(const struct node_type_def_list *list, long id,
 	}
 
 	decl_def_list(&mlist);
-	parse_struct(struct_name, &mmemb);
-	free_struct(struct_name, &mmemb);
+	parse_struct(struct_name, &mmemb, 0, 0, 0);
+	free_struct(struct_name, &mmemb, 0, 0);
 	dump_struct(struct_name, &mmemb);
+	bdump_struct(struct_name, &mmemb);
+	hash_struct(struct_name, &mmemb);
+	equal_struct(struct_name, &mmemb);
+	diff_struct(struct_name, &mmemb);
 
 	osi(0, "void test_default_%ld_%ld()\n", id, im);
 	osi(0, "{\n");
@@ -2132,12 +5029,20 @@ void make_test_default_memb(const struct node_type_def_list *list, long id,
 	osi(1, "struct mem_pool pool;\n");
 	osi(1, "struct node_value node;\n");
 	osi(1, "struct dump_context dummy;\n");
+	osi(1, "struct dump_buffer buf;\n");
 	osi(1, "struct %s value;\n", struct_name);
 	osi(1, "const char *err_msg = NULL;\n");
 	osi(1, "int ret = 0;\n");
 	osi(1, "mem_pool_init(&pool);\n");
 	osi(1, "context.pool = &pool;\n");
+	osi(1, "context.shared = NULL;\n");
+	osi(1, "context.fps = NULL;\n");
+	osi(1, "context.arena = NULL;\n");
+	osi(1, "context.alloc = NULL;\n");
 	osi(1, "node.type = VAL_MEMBERS;\n");
+	osi(1, "node.anchored = 0;\n");
+	osi(1, "node.merged = 0;\n");
+	osi(1, "node.lower = 0;\n");
 	osi(1, "node.members = NULL;\n");
 	osi(1, "node.parent = NULL;\n");
 	osi(1, "node.name_copy = NULL;\n");
@@ -2165,7 +5070,13 @@ void make_test_default_memb(const struct node_type_def_list *list, long id,
 	osi(1, "} else {\n"); /* if ret */
 	osi(2, "dump__struct_%s(put_func_impl, &dummy, 0, &value);\n", struct_name);
 	osi(2, "fprintf(stderr, \"\\n\");\n");
-	osi(2, "free__struct_%s(&value);\n", struct_name);
+	osi(2, "dump_buffer_init(&buf, NULL, 0, DUMP_BUFFER_GROW);\n");
+	osi(2, "bdump__struct_%s(&buf, 0, &value);\n", struct_name);
+	osi(2, "if (!dump_buffer_finish(&buf)) {\n");
+	osi(3, "fprintf(stderr, \"%%s\\n\", buf.data);\n");
+	osi(2, "}\n");
+	osi(2, "free(buf.data);\n");
+	osi(2, "free__struct_%s(&context, &value);\n", struct_name);
 	if (memb->type != NODE_MEMBER_DEF_UNNAMED_UNION) {
 		osi(2, "fprintf(stderr, \"successed to parse default value of "
 				"struct %s.%s\\n\");\n", 
@@ -2243,6 +5154,50 @@ const char *help_msg =
 "         --include_guard=<include gurad (#ifndef ... #define ... #nedif)>\n"
 "         --test_default (optional): generate code to test default values\n";
 
+/*
+ * Emits a template naming the struct many times: every %s in fmt is name,
+ * fmt has no other conversions.
+ */
+static void out_src_named(const char *fmt, string name)
+{
+	const char *p;
+
+	while ((p = strstr(fmt, "%s"))) {
+		out_src("%.*s%s", (int)(p - fmt), fmt, name);
+		fmt = p + 2;
+	}
+	out_src("%s", fmt);
+}
+
+/*
+ * config_load_dir_<name>_<member> and config_release_dir_<name>_<member> for
+ * every variable length array of structs of the exported struct list
+ */
+static void config_dir_funcs(const struct node_type_def_list *list)
+{
+	const struct node_member_list *memb;
+	const char *name = list->struct_def.name;
+
+	for (memb = list->struct_def.members; memb; memb = memb->next) {
+		/* the loader allocates the array, a capped one is inline */
+		if (memb->type != NODE_MEMBER_DEF_STRUCT ||
+				memb->vec.type != NODE_TYPE_VAR_ARR ||
+				memb->vec.cap) {
+			continue;
+		}
+		out_src(config_dir_fmt, name, memb->mapped->str,
+				memb->type_name, memb->vec.len_str);
+		out_hdr("extern int config_load_dir_%s_%s(struct %s *value, "
+				"const struct %s *old, const char *path, "
+				"struct config_dir *dir, int nthreads, "
+				"const char **err_msg);\n",
+				name, memb->mapped->str, name, name);
+		out_hdr("extern void config_release_dir_%s_%s("
+				"struct %s *old, struct config_dir *dir);\n",
+				name, memb->mapped->str, name);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	const char *header_filename;
@@ -2284,10 +5239,22 @@ int main(int argc, char **argv)
 		ERR("failed to open source file %s to write\n", src_path);
 	}
 
+	verify_mapping_list(mapping);
+	resolve_bounded_list(ast);
 	verify_def_list(ast);
+	check_arena_list(ast);
+	check_fixed_list(ast);
+	if (!test_default) {
+		mark_applied_list(ast);
+		mark_reparsed_list(ast);
+	}
 
 	out_hdr("#ifndef %s\n", include_guard);
 	out_hdr("#define %s\n", include_guard);
+	out_hdr("#include <stdint.h>\n");
+	out_hdr("#include <stddef.h>\n");
+	out_hdr("struct config_arena;\n");
+	out_hdr("struct config_allocator;\n");
 	
 	header_filename = strrchr(hdr_path, '/');
 	if (!header_filename) {
@@ -2307,8 +5274,21 @@ int main(int argc, char **argv)
 	parse_type_def_list(ast);
 	free_type_def_list(ast);
 	dump_type_def_list(ast);
+	bdump_type_def_list(ast);
+	hash_mapping_list(mapping);
+	hash_type_def_list(ast);
+	equal_type_def_list(ast);
+	diff_type_def_list(ast);
+	pack_type_def_list(ast);
 
 	out_hdr("struct dump_context;\n");
+	out_hdr("struct dump_buffer;\n");
+	out_hdr("struct parse_cache;\n");
+	out_hdr("struct config_pin;\n");
+	out_hdr("struct config_watch;\n");
+	out_hdr("struct config_sub;\n");
+	out_hdr("struct config_hash;\n");
+	out_hdr("struct config_dir;\n");
 	out_hdr("typedef void (*put_func)(struct dump_context *ctx, "
 			"const char *fmt, ...);\n");
 	if (test_default) {
@@ -2317,15 +5297,82 @@ int main(int argc, char **argv)
 		for (list = ast; list; list = list->next) {
 			if (list->type == NODE_TYPE_DEF_STRUCT &&
 					list->struct_def.exported) {
-				out_src(parser_func_fmt, list->struct_def.name,
+				out_src_named(list->struct_def.allocator ?
+						config_allocator_of_fmt :
+						config_allocator_of_none_fmt,
+						list->struct_def.name);
+				out_src_named(list->struct_def.arena ?
+						config_convert_arena_fmt :
+						config_convert_fmt,
+						list->struct_def.name);
+				out_src_named(parser_func_fmt,
+						list->struct_def.name);
+				if (list->struct_def.allocator) {
+					out_src_named(config_parse_with_fmt,
+							list->struct_def.name);
+					out_hdr("extern int config_parse_with_%s("
+							"struct %s *value, "
+							"const char *path, "
+							"struct config_allocator *alloc, "
+							"const char **err_msg);\n",
+							list->struct_def.name,
+							list->struct_def.name);
+				}
+				out_src(parser_parallel_func_fmt,
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_src(parser_cached_func_fmt,
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_src(parser_layered_func_fmt,
+						list->struct_def.name,
 						list->struct_def.name,
 						list->struct_def.name);
+				out_src_named(config_apply_fmt,
+						list->struct_def.name);
+				if (list->struct_def.reparsed) {
+					out_src_named(config_reparse_fmt,
+							list->struct_def.name);
+					out_src_named(config_snapshot_reparse_fmt,
+							list->struct_def.name);
+				} else {
+					out_src_named(config_snapshot_fmt,
+							list->struct_def.name);
+				}
+				out_src_named(config_reload_fmt,
+						list->struct_def.name);
+				out_src_named(config_subscribe_fmt,
+						list->struct_def.name);
+				out_src_named(config_watch_fmt,
+						list->struct_def.name);
+				out_src_named(config_hash_fmt,
+						list->struct_def.name);
+				out_src_named(config_pack_fmt,
+						list->struct_def.name);
+				if (!list->struct_def.arena &&
+						!list->struct_def.allocator) {
+					config_dir_funcs(list);
+				}
 				out_src(config_dump, list->struct_def.name,
 						list->struct_def.name,
 						list->struct_def.name);
-				out_src(config_free, list->struct_def.name,
+				out_src(config_dump_to_buffer,
+						list->struct_def.name,
 						list->struct_def.name,
 						list->struct_def.name);
+				if (list->struct_def.arena) {
+					out_src_named(config_free_arena_fmt,
+							list->struct_def.name);
+					out_hdr("extern size_t config_arena_size_%s("
+							"const struct %s *value);\n",
+							list->struct_def.name,
+							list->struct_def.name);
+				} else {
+					out_src_named(config_free,
+							list->struct_def.name);
+				}
 				out_hdr("extern void config_free_%s(struct %s *);\n",
 						list->struct_def.name,
 						list->struct_def.name);
@@ -2333,11 +5380,118 @@ int main(int argc, char **argv)
 						"const char *path, const char **err_msg);\n",
 						list->struct_def.name,
 						list->struct_def.name);
+				out_hdr("extern int config_parse_parallel_%s("
+						"struct %s *value, const char *path, "
+						"int nthreads, const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_parse_cached_%s("
+						"struct %s *value, const char *path, "
+						"struct parse_cache *cache, "
+						"const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_parse_layered_%s("
+						"struct %s *value, "
+						"const char *const *paths, int n, "
+						"const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_apply_%s("
+						"struct %s *value, const char *fragment, "
+						"const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				if (list->struct_def.reparsed) {
+					out_hdr("extern int config_reparse_%s("
+							"const struct %s *old, "
+							"const char *path, "
+							"struct %s *value, "
+							"const char **err_msg);\n",
+							list->struct_def.name,
+							list->struct_def.name,
+							list->struct_def.name);
+					out_hdr("extern void config_release_%s("
+							"struct %s *old, "
+							"const struct %s *value);\n",
+							list->struct_def.name,
+							list->struct_def.name,
+							list->struct_def.name);
+				}
+				out_hdr("extern const struct %s *config_current_%s("
+						"struct config_pin *pin);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_reload_%s("
+						"const char *path, const char **err_msg);\n",
+						list->struct_def.name);
+				out_hdr("extern struct config_sub *config_subscribe_%s("
+						"const char *path, void (*on_change)("
+						"const struct %s *value, void *arg), "
+						"void *arg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern void config_unsubscribe_%s("
+						"struct config_sub *s);\n",
+						list->struct_def.name);
+				out_hdr("extern struct config_watch *config_watch_%s("
+						"const char *path, void (*on_change)("
+						"const struct %s *value, void *arg), "
+						"void *arg, const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern void config_unwatch_%s("
+						"struct config_watch *w);\n",
+						list->struct_def.name);
+				out_hdr("extern uint64_t config_hash_%s("
+						"const struct %s *value, "
+						"struct config_hash *tree);\n",
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_equal_%s("
+						"const struct %s *a, "
+						"const struct %s *b);\n",
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_diff_%s("
+						"const struct %s *a, "
+						"const struct config_hash *ta, "
+						"const struct %s *b, "
+						"const struct config_hash *tb, "
+						"void (*changed)(const char *path, "
+						"void *arg), void *arg);\n",
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern struct %s *config_pack_%s("
+						"const struct %s *value, "
+						"size_t *size);\n",
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern struct %s *config_clone_packed_%s("
+						"const struct %s *packed, "
+						"size_t size);\n",
+						list->struct_def.name,
+						list->struct_def.name,
+						list->struct_def.name);
+				out_hdr("extern int config_parse_packed_%s("
+						"struct %s **value, size_t *size, "
+						"const char *path, "
+						"const char **err_msg);\n",
+						list->struct_def.name,
+						list->struct_def.name);
 				out_hdr("extern void config_dump_%s(put_func, "
 						"struct dump_context *ctx, "
 						"const struct %s *value);\n",
 						list->struct_def.name,
 						list->struct_def.name);
+				out_hdr("extern int config_dump_%s_to_buffer("
+						"struct dump_buffer *buf, "
+						"const struct %s *value);\n",
+						list->struct_def.name,
+						list->struct_def.name);
 			}
 		}
 	}
@@ -13,12 +13,19 @@ struct string_list {
 	struct string_list *next;
 };
 
+struct node_hook_list {
+	string name;
+	string func;
+	struct node_hook_list *next;
+};
+
 struct node_mapping {
 	string name;
 	string parse_func;
 	string free_func;
 	string dump_func;
 	struct string_list *mapped_types;
+	struct node_hook_list *hooks;
 	struct node_mapping *next;
 };
 
@@ -38,6 +45,13 @@ struct node_type_def_list {
 			const char *name;
 			struct node_member_list *members;
 			int exported;
+			int shared;	/* anchored values converted once */
+			int applied;	/* has apply__struct_* */
+			int incremental;	/* reconverted by config_reparse_* */
+			int reparsed;	/* has reparse__struct_* and config2c_fp */
+			int arena;	/* converted into a struct config_arena */
+			int allocator;	/* remembers its struct config_allocator */
+			int fixed;	/* converted without allocating */
 		} struct_def;
 		struct {
 			const char *name;
@@ -47,6 +61,13 @@ struct node_type_def_list {
 	};
 };
 
+#define STRUCT_EXPORTED	(1 << 0)
+#define STRUCT_SHARED	(1 << 1)
+#define STRUCT_INCREMENTAL	(1 << 2)
+#define STRUCT_ARENA	(1 << 3)
+#define STRUCT_ALLOCATOR	(1 << 4)
+#define STRUCT_FIXED	(1 << 5)
+
 struct node_enum_list {
 	struct node_enum_list *next;
 	const char *name;
@@ -59,11 +80,14 @@ struct node_vec_def {
 		NODE_TYPE_FIX_INT,
 		NODE_TYPE_FIX_STR,
 		NODE_TYPE_VAR_ARR,
+		NODE_TYPE_BOUNDED,	/* a scalar in char[cap] */
 	} type;
 	union {
 		long len_int;
 		string len_str;
 	};
+	long cap;	/* of the inline storage, 0 if allocated */
+	int spill;	/* a bounded value too long goes to <name>_spill */
 };
 
 struct node_member_list {
@@ -134,6 +158,7 @@ rev_list(rev_member_list, struct node_member_list, next);
 rev_list(rev_alter_list, struct node_alter_list, next);
 rev_list(rev_mapping, struct node_mapping, next);
 rev_list(rev_string_list, struct string_list, next);
+rev_list(rev_hook_list, struct node_hook_list, next);
 
 #define len_list(name, type, pnext) \
 	static inline long name(const type *p) \
@@ -41,9 +41,10 @@ extern int yylex (void);
 	struct node_alter_list		*alters;
 	struct node_vec_def		vec_def;
 	struct string_list		*str_list;
+	struct node_hook_list		*hooks;
 }
 
-%token STRUCT UNION ENUM AS
+%token STRUCT UNION ENUM AS LE
 
 %token <str_val> IDEN
 %token <int_val> INTEGER
@@ -65,6 +66,7 @@ extern int yylex (void);
 %type <str_list>		string_list
 %type <str_list>		iden_list_t
 %type <str_list>		iden_list
+%type <hooks>			hook_list
 
 %error-verbose
 
@@ -90,7 +92,7 @@ mapping_def_list
 	;
 
 mapping_def
-	: IDEN ':' IDEN IDEN IDEN '(' string_list_t ')' ';' {
+	: IDEN ':' IDEN IDEN IDEN '(' string_list_t ')' hook_list ';' {
 		struct node_mapping *ret = malloc(sizeof(*ret));
 		valid_or_fail(ret);
 		ret->next = NULL;
@@ -99,6 +101,7 @@ mapping_def
 		ret->dump_func = $4;
 		ret->free_func = $5;
 		ret->mapped_types = rev_string_list($7);
+		ret->hooks = rev_hook_list($9);
 		PDBG("mapping_def:%p, name:%p, parse:%p, dump:%p, "
 				"free:%p, mapped:%p\n", ret, ret->name, 
 				ret->parse_func, ret->dump_func,
@@ -107,6 +110,20 @@ mapping_def
 	}
 	;
 
+hook_list
+	: {
+		$$ = NULL;
+	}
+	| hook_list IDEN '=' IDEN {
+		struct node_hook_list *ret = malloc(sizeof(*ret));
+		valid_or_fail(ret);
+		ret->next = $1;
+		ret->name = $2;
+		ret->func = $4;
+		$$ = ret;
+	}
+	;
+
 type_def_list
 	: {
 		ast = NULL;
@@ -135,7 +152,14 @@ type_def
 		ret->type = NODE_TYPE_DEF_STRUCT;
 		ret->struct_def.name = $2;
 		ret->struct_def.members = rev_member_list($4);
-		ret->struct_def.exported = $6;
+		ret->struct_def.exported = !!($6 & STRUCT_EXPORTED);
+		ret->struct_def.shared = !!($6 & STRUCT_SHARED);
+		ret->struct_def.applied = 0;
+		ret->struct_def.incremental = !!($6 & STRUCT_INCREMENTAL);
+		ret->struct_def.reparsed = 0;
+		ret->struct_def.arena = !!($6 & STRUCT_ARENA);
+		ret->struct_def.allocator = !!($6 & STRUCT_ALLOCATOR);
+		ret->struct_def.fixed = !!($6 & STRUCT_FIXED);
 		PDBG("type_def:struct:%p, name:%p, list:%p\n",
 				ret, ret->struct_def.name,
 				ret->struct_def.members);
@@ -158,11 +182,25 @@ type_def
 
 exported
 	: { $$ = 0; }
-	| IDEN {
-		if (strcmp($1, "export")) {
-			yyerror("expecting ';' or 'export'");
+	| exported IDEN {
+		if (!strcmp($2, "export")) {
+			$$ = $1 | STRUCT_EXPORTED;
+		} else if (!strcmp($2, "shared")) {
+			$$ = $1 | STRUCT_SHARED;
+		} else if (!strcmp($2, "incremental")) {
+			$$ = $1 | STRUCT_INCREMENTAL;
+		} else if (!strcmp($2, "arena")) {
+			$$ = $1 | STRUCT_ARENA;
+		} else if (!strcmp($2, "allocator")) {
+			$$ = $1 | STRUCT_ALLOCATOR;
+		} else if (!strcmp($2, "fixed")) {
+			$$ = $1 | STRUCT_FIXED;
+		} else {
+			yyerror("expecting ';', 'export', 'shared', "
+					"'incremental', 'arena', 'allocator' "
+					"or 'fixed'");
+			$$ = $1;
 		}
-		$$ = 1;
 	}
 	;
 
@@ -399,18 +437,45 @@ alter_def
 vec_def
 	: {
 		$$.type = NODE_TYPE_SCALE;
+		$$.cap = 0;
+		$$.spill = 0;
 	}
 	| '[' INTEGER ']' {
 		$$.type = NODE_TYPE_FIX_INT;
 		$$.len_int = $2;
+		$$.cap = 0;
+		$$.spill = 0;
 	}
 	| '[' '!' IDEN ']' {
 		$$.type = NODE_TYPE_FIX_STR;
 		$$.len_str = $3;
+		$$.cap = 0;
+		$$.spill = 0;
 	}
 	| '[' IDEN ']' {
 		$$.type = NODE_TYPE_VAR_ARR;
 		$$.len_str = $2;
+		$$.cap = 0;
+		$$.spill = 0;
+	}
+	| '[' IDEN LE INTEGER ']' {
+		$$.type = NODE_TYPE_VAR_ARR;
+		$$.len_str = $2;
+		$$.cap = $4;
+		$$.spill = 0;
+	}
+	| '[' LE INTEGER ']' {
+		$$.type = NODE_TYPE_BOUNDED;
+		$$.cap = $3;
+		$$.spill = 0;
+	}
+	| '[' LE INTEGER IDEN ']' {
+		$$.type = NODE_TYPE_BOUNDED;
+		$$.cap = $3;
+		$$.spill = 1;
+		if (strcmp($4, "spill")) {
+			yyerror("expecting ']' or 'spill'");
+		}
 	}
 	;
 
@@ -0,0 +1,332 @@
+/* the example types are static in the converter, include it to reach them */
+#include "demo_0-converter.c"
+#include <time.h>
+
+/*
+ * Microbenchmarks of the example prims against the libc functions they
+ * replace, run by hand: ./bench_prims [rounds]
+ */
+
+#define SAMPLES (1 << 16)
+
+static long rounds = 20;
+static volatile uint64_t sink;
+static uint64_t rand_state = 88172645463325252ULL;
+
+static uint64_t rand64(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double start, long n)
+{
+	printf("%-32s %8.1f ns\n", name, (now() - start) * 1e9 / n);
+}
+
+/* finite doubles of any exponent, and floats */
+static double doubles[SAMPLES];
+static float floats[SAMPLES];
+
+static void bench_fp_dump(void)
+{
+	struct dump_buffer buf;
+	char out[FP_STR_MAX];
+	uint64_t bits;
+	double start;
+	long r, i;
+
+	for (i = 0; i < SAMPLES; ++i) {
+		do {
+			bits = rand64();
+			memcpy(&doubles[i], &bits, sizeof(doubles[i]));
+		} while (!isfinite(doubles[i]));
+		floats[i] = (float)(rand64() % 2000000) / 1000;
+	}
+
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += double_to_str(out, doubles[i]);
+		}
+	}
+	report("double_to_str", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += snprintf(out, sizeof(out), "%.17g", doubles[i]);
+		}
+	}
+	report("snprintf %.17g", start, rounds * SAMPLES);
+
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += float_to_str(out, floats[i]);
+		}
+	}
+	report("float_to_str", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += snprintf(out, sizeof(out), "%.9g", floats[i]);
+		}
+	}
+	report("snprintf %.9g", start, rounds * SAMPLES);
+
+	/* the dump hook through a put_func, and the bdump hook */
+	dump_buffer_init(&buf, NULL, 0, DUMP_BUFFER_GROW);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		buf.len = 0;
+		for (i = 0; i < SAMPLES; ++i) {
+			dump_double(dump_buffer_printf,
+					(struct dump_context *)&buf, &doubles[i]);
+		}
+	}
+	report("dump_double (printf path)", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		buf.len = 0;
+		for (i = 0; i < SAMPLES; ++i) {
+			bdump_double(&buf, &doubles[i]);
+		}
+	}
+	report("bdump_double", start, rounds * SAMPLES);
+	free(buf.data);
+}
+
+/*
+ * decimal strings of the samples of bench_fp_dump and of short decimals,
+ * and integers of any length
+ */
+static char fp_text[SAMPLES][32];
+static char int_text[SAMPLES][24];
+
+static void bench_number_parse(void)
+{
+	unsigned long long ull;
+	long long ll;
+	double d, start;
+	float f;
+	char *end;
+	long r, i;
+
+	for (i = 0; i < SAMPLES; ++i) {
+		switch (i % 3) {
+		case 0:
+			sprintf(fp_text[i], "%.17g", doubles[i]);
+			break;
+		case 1:
+			sprintf(fp_text[i], "%g", floats[i]);
+			break;
+		default:
+			sprintf(fp_text[i], "%d.%02d", (int)(rand64() % 100000),
+					(int)(rand64() % 100));
+			break;
+		}
+		ll = rand64() >> (rand64() % 64);
+		sprintf(int_text[i], "%lld", i & 1 ? -ll : ll);
+	}
+
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			to_double(&d, fp_text[i]);
+			sink += d != 0;
+		}
+	}
+	report("to_double", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			d = strtod(fp_text[i], &end);
+			sink += d != 0;
+		}
+	}
+	report("strtod", start, rounds * SAMPLES);
+
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			to_float(&f, fp_text[i]);
+			sink += f != 0;
+		}
+	}
+	report("to_float", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			f = strtof(fp_text[i], &end);
+			sink += f != 0;
+		}
+	}
+	report("strtof", start, rounds * SAMPLES);
+
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			to_longlong(&ll, int_text[i]);
+			sink += ll;
+		}
+	}
+	report("to_longlong", start, rounds * SAMPLES);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += strtoll(int_text[i], &end, 0);
+		}
+	}
+	report("strtoll", start, rounds * SAMPLES);
+
+	/* the even samples only, the odd ones are negative */
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; i += 2) {
+			to_ulonglong(&ull, int_text[i]);
+			sink += ull;
+		}
+	}
+	report("to_ulonglong", start, rounds * SAMPLES / 2);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; i += 2) {
+			sink += strtoull(int_text[i], &end, 0);
+		}
+	}
+	report("strtoull", start, rounds * SAMPLES / 2);
+}
+
+static char addr_text[SAMPLES][INET6_ADDRSTRLEN + 4];
+
+/* time parse(text) over the samples, the address parsers take a node */
+#define BENCH_NODE(name, parse, out_type) do { \
+	struct pass_to_conv context = {}; \
+	struct node_value val = {}; \
+	out_type out; \
+	val.type = VAL_SCALE_STRING; \
+	start = now(); \
+	for (r = 0; r < rounds; ++r) { \
+		for (i = 0; i < SAMPLES; ++i) { \
+			val.string_str = addr_text[i]; \
+			sink += parse(&context, &out, &val); \
+		} \
+	} \
+	report(name, start, rounds * SAMPLES); \
+} while (0)
+
+#define BENCH_PTON(name, af, out_type) do { \
+	out_type out; \
+	start = now(); \
+	for (r = 0; r < rounds; ++r) { \
+		for (i = 0; i < SAMPLES; ++i) { \
+			sink += inet_pton(af, addr_text[i], &out); \
+		} \
+	} \
+	report(name, start, rounds * SAMPLES); \
+} while (0)
+
+static int parse_inet6wp_only(struct pass_to_conv *context,
+		struct in6_addr *ip, const struct node_value *val)
+{
+	int prefix;
+
+	return parse_inet6wp(context, ip, &prefix, val);
+}
+
+/* the address and prefix separately, as the libc way would do it */
+static int pton_inet6wp(const char *str, struct in6_addr *ip)
+{
+	char buf[INET6_ADDRSTRLEN];
+	const char *slash = strchr(str, '/');
+	char *end;
+	long prefix;
+
+	if (!slash || slash - str >= (long)sizeof(buf)) {
+		return -1;
+	}
+	memcpy(buf, str, slash - str);
+	buf[slash - str] = '\0';
+	prefix = strtol(slash + 1, &end, 10);
+	return inet_pton(AF_INET6, buf, ip) == 1 && !*end &&
+		prefix >= 0 && prefix <= 128 ? 0 : -1;
+}
+
+static void bench_addr_parse(void)
+{
+	struct in6_addr ip6;
+	unsigned m[6];
+	uint64_t words[2];
+	double start;
+	long r, i;
+
+	for (i = 0; i < SAMPLES; ++i) {
+		words[0] = rand64();
+		words[1] = rand64();
+		inet_ntop(AF_INET, words, addr_text[i], sizeof(addr_text[i]));
+	}
+	BENCH_NODE("parse_inet4", parse_inet4, struct in_addr);
+	BENCH_PTON("inet_pton AF_INET", AF_INET, struct in_addr);
+
+	for (i = 0; i < SAMPLES; ++i) {
+		words[0] = rand64();
+		words[1] = i & 1 ? rand64() & rand64() & rand64() : rand64();
+		inet_ntop(AF_INET6, words, addr_text[i], sizeof(addr_text[i]));
+	}
+	BENCH_NODE("parse_inet6", parse_inet6, struct in6_addr);
+	BENCH_PTON("inet_pton AF_INET6", AF_INET6, struct in6_addr);
+
+	for (i = 0; i < SAMPLES; ++i) {
+		sprintf(addr_text[i] + strlen(addr_text[i]), "/%d",
+				(int)(rand64() % 129));
+	}
+	BENCH_NODE("parse_inet6wp", parse_inet6wp_only, struct in6_addr);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += pton_inet6wp(addr_text[i], &ip6);
+		}
+	}
+	report("inet_pton + strtol", start, rounds * SAMPLES);
+
+	for (i = 0; i < SAMPLES; ++i) {
+		words[0] = rand64();
+		sprintf(addr_text[i], "%02x:%02x:%02x:%02x:%02x:%02x",
+				(int)(words[0] & 0xff), (int)(words[0] >> 8 & 0xff),
+				(int)(words[0] >> 16 & 0xff),
+				(int)(words[0] >> 24 & 0xff),
+				(int)(words[0] >> 32 & 0xff),
+				(int)(words[0] >> 40 & 0xff));
+	}
+	BENCH_NODE("parse_eth_mac", parse_eth_mac, struct eth_mac);
+	start = now();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < SAMPLES; ++i) {
+			sink += sscanf(addr_text[i], "%2x:%2x:%2x:%2x:%2x:%2x",
+					&m[0], &m[1], &m[2], &m[3], &m[4],
+					&m[5]);
+		}
+	}
+	report("sscanf", start, rounds * SAMPLES);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		rounds = atol(argv[1]);
+	}
+	bench_fp_dump();
+	bench_number_parse();
+	bench_addr_parse();
+	return 0;
+}
@@ -23,7 +23,8 @@ for build in demo_0 ; do
 		parsery.tab.c \
 		parserl.lex.c \
 		"${build}-main.c" \
-		"${build}-converter.c"
+		"${build}-converter.c" \
+		-pthread
 	
 	../../../../bin/config2c \
 		--spec_path="../${build}-syntax" \
@@ -37,5 +38,51 @@ for build in demo_0 ; do
 		parser.c \
 		parsery.tab.c \
 		parserl.lex.c \
-		"${build}-test.c"
+		"${build}-test.c" \
+		-pthread
+done
+
+for test in test_parse ; do
+	cp "../${test}.c" ./
+	gcc -ggdb -o "${test}" \
+		parser.c \
+		parsery.tab.c \
+		parserl.lex.c \
+		"${test}.c" \
+		demo_0-converter.c \
+		-pthread
+done
+
+# test_prims includes the converter to reach its static functions
+for test in test_prims ; do
+	cp "../${test}.c" ./
+	gcc -ggdb -o "${test}" \
+		parser.c \
+		parsery.tab.c \
+		parserl.lex.c \
+		"${test}.c" \
+		-pthread -lm
+done
+
+# bench_prims is run by hand, it includes the converter as test_prims does
+for bench in bench_prims ; do
+	cp "../${bench}.c" ./
+	gcc -O2 -o "${bench}" \
+		parser.c \
+		parsery.tab.c \
+		parserl.lex.c \
+		"${bench}.c" \
+		-pthread -lm
+done
+
+# test_rcu checks the snapshots of config_reload_* under ThreadSanitizer
+for test in test_rcu ; do
+	cp "../${test}.c" ./
+	gcc -ggdb -fsanitize=thread -o "${test}" \
+		parser.c \
+		parsery.tab.c \
+		parserl.lex.c \
+		"${test}.c" \
+		demo_0-converter.c \
+		-pthread
 done
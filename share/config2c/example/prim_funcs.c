@@ -3,53 +3,780 @@
  * See LICENSE for full license details.
  */
 
+#include <float.h>
+#include <math.h>
 #include <stdint.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STR_SIMD_X86
+#endif
+
 #define IP4_ADDR_MAX (15)
 #define IP4_PRE_MAX (2)
 
 #define IP6_ADDR_MAX (65) /* should be enough, 16 bytes * 4 */
 #define IP6_PRE_MAX (3)
 
+/* value of a hex digit, -1 for other characters */
+static int xdigit_to_int(int c)
+{
+	if ((unsigned)(c - '0') < 10) {
+		return c - '0';
+	}
+	c |= 0x20;
+	if ((unsigned)(c - 'a') < 6) {
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+/*
+ * Locale-independent number parsing, following the grammar of the config
+ * lexer (parserl.l). Decimal integers are converted 8 digits at a time.
+ */
+static int is_eight_digits(uint64_t v)
+{
+	return ((v & 0xF0F0F0F0F0F0F0F0ull) |
+			(((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+		== 0x3333333333333333ull;
+}
+
+/* v holds 8 ascii digits, the first one in the lowest byte */
+static uint32_t eight_digits_value(uint64_t v)
+{
+	v -= 0x3030303030303030ull;
+	v = v * 10 + (v >> 8);
+	return ((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+		((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))
+		>> 32;
+}
+
+static uint64_t load_eight(const char *in)
+{
+	uint64_t v;
+	memcpy(&v, in, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static int is_digit(int c)
+{
+	return '0' <= c && c <= '9';
+}
+
+/* the lexer only passes u, l, ll, ul, ull, lu, llu in any case */
+static int is_int_suffix(const char *in)
+{
+	while (*in == 'u' || *in == 'U' || *in == 'l' || *in == 'L') {
+		++in;
+	}
+	return !*in;
+}
+
+/*
+ * Parse an optionally signed decimal, octal (0...) or hex (0x...)
+ * integer. Return 0 if converted, -ERANGE if it overflows unsigned long
+ * long, -EINVAL if it is not an integer.
+ */
+static int to_magnitude(unsigned long long *out, int *neg, const char *in)
+{
+	unsigned long long v = 0;
+	size_t len;
+	uint64_t chunk;
+	int x;
+
+	*neg = *in == '-';
+	if (*in == '+' || *in == '-') {
+		++in;
+	}
+	if (in[0] == '0' && (in[1] == 'x' || in[1] == 'X')) {
+		in += 2;
+		if (xdigit_to_int(*in) < 0) {
+			return -EINVAL;
+		}
+		for (; (x = xdigit_to_int(*in)) >= 0; ++in) {
+			if (v >> 60) {
+				return -ERANGE;
+			}
+			v = v << 4 | x;
+		}
+	} else if (in[0] == '0') {
+		for (; '0' <= *in && *in <= '7'; ++in) {
+			if (v >> 61) {
+				return -ERANGE;
+			}
+			v = v << 3 | (*in - '0');
+		}
+	} else {
+		if (!is_digit(*in)) {
+			return -EINVAL;
+		}
+		for (len = strlen(in); len >= 8; len -= 8, in += 8) {
+			chunk = load_eight(in);
+			if (!is_eight_digits(chunk)) {
+				break;
+			}
+			if (__builtin_mul_overflow(v, 100000000ull, &v) ||
+					__builtin_add_overflow(v,
+						eight_digits_value(chunk), &v)) {
+				return -ERANGE;
+			}
+		}
+		for (; is_digit(*in); ++in) {
+			if (__builtin_mul_overflow(v, 10ull, &v) ||
+					__builtin_add_overflow(v, *in - '0', &v)) {
+				return -ERANGE;
+			}
+		}
+	}
+	if (!is_int_suffix(in)) {
+		return -EINVAL;
+	}
+	*out = v;
+	return 0;
+}
+
 /* return 0 if converted, otherwise return -errno, most likely -ERANGE */
 static int to_longlong(long long *out, const char *in)
 {
-	long long ret;
-	errno = 0;
-	ret = strtoll(in, NULL, 0);
-	if (!errno) {
-		*out = ret;
-		return 0;
+	unsigned long long v;
+	int neg, ret;
+
+	ret = to_magnitude(&v, &neg, in);
+	if (ret) {
+		return ret;
+	}
+	if (neg) {
+		if (v > (unsigned long long)LLONG_MAX + 1) {
+			return -ERANGE;
+		}
+		*out = v ? -(long long)(v - 1) - 1 : 0;
 	} else {
-		return -errno;
+		if (v > LLONG_MAX) {
+			return -ERANGE;
+		}
+		*out = v;
 	}
+	return 0;
 }
 
 /* return 0 if converted, otherwise return -errno, most likely -ERANGE */
 static int to_ulonglong(unsigned long long *out, const char *in)
 {
-	unsigned long long ret;
+	int neg;
+
 	if (in[0] == '-') {
 		return -EINVAL;
 	}
+	return to_magnitude(out, &neg, in);
+}
+
+/*
+ * Floating point values: a decimal with at most 19 significant digits
+ * and a result in the normal range is converted with Clinger's fast path
+ * or Eisel-Lemire; everything else (hex floats, long significands,
+ * subnormals, overflows, 10^q out of the table) goes to strto{f,d}.
+ */
+
+/* 5^q, normalized and truncated to 128 bits, for EL_MIN_Q <= q <= EL_MAX_Q */
+#define EL_MIN_Q (-100)
+#define EL_MAX_Q (100)
+
+static const uint64_t el_pow5[][2] = {
+	{ 0xDFF9772470297EBD, 0x59787E2B93BC56F7 },
+	{ 0x8BFBEA76C619EF36, 0x57EB4EDB3C55B65A },
+	{ 0xAEFAE51477A06B03, 0xEDE622920B6B23F1 },
+	{ 0xDAB99E59958885C4, 0xE95FAB368E45ECED },
+	{ 0x88B402F7FD75539B, 0x11DBCB0218EBB414 },
+	{ 0xAAE103B5FCD2A881, 0xD652BDC29F26A119 },
+	{ 0xD59944A37C0752A2, 0x4BE76D3346F0495F },
+	{ 0x857FCAE62D8493A5, 0x6F70A4400C562DDB },
+	{ 0xA6DFBD9FB8E5B88E, 0xCB4CCD500F6BB952 },
+	{ 0xD097AD07A71F26B2, 0x7E2000A41346A7A7 },
+	{ 0x825ECC24C873782F, 0x8ED400668C0C28C8 },
+	{ 0xA2F67F2DFA90563B, 0x728900802F0F32FA },
+	{ 0xCBB41EF979346BCA, 0x4F2B40A03AD2FFB9 },
+	{ 0xFEA126B7D78186BC, 0xE2F610C84987BFA8 },
+	{ 0x9F24B832E6B0F436, 0x0DD9CA7D2DF4D7C9 },
+	{ 0xC6EDE63FA05D3143, 0x91503D1C79720DBB },
+	{ 0xF8A95FCF88747D94, 0x75A44C6397CE912A },
+	{ 0x9B69DBE1B548CE7C, 0xC986AFBE3EE11ABA },
+	{ 0xC24452DA229B021B, 0xFBE85BADCE996168 },
+	{ 0xF2D56790AB41C2A2, 0xFAE27299423FB9C3 },
+	{ 0x97C560BA6B0919A5, 0xDCCD879FC967D41A },
+	{ 0xBDB6B8E905CB600F, 0x5400E987BBC1C920 },
+	{ 0xED246723473E3813, 0x290123E9AAB23B68 },
+	{ 0x9436C0760C86E30B, 0xF9A0B6720AAF6521 },
+	{ 0xB94470938FA89BCE, 0xF808E40E8D5B3E69 },
+	{ 0xE7958CB87392C2C2, 0xB60B1D1230B20E04 },
+	{ 0x90BD77F3483BB9B9, 0xB1C6F22B5E6F48C2 },
+	{ 0xB4ECD5F01A4AA828, 0x1E38AEB6360B1AF3 },
+	{ 0xE2280B6C20DD5232, 0x25C6DA63C38DE1B0 },
+	{ 0x8D590723948A535F, 0x579C487E5A38AD0E },
+	{ 0xB0AF48EC79ACE837, 0x2D835A9DF0C6D851 },
+	{ 0xDCDB1B2798182244, 0xF8E431456CF88E65 },
+	{ 0x8A08F0F8BF0F156B, 0x1B8E9ECB641B58FF },
+	{ 0xAC8B2D36EED2DAC5, 0xE272467E3D222F3F },
+	{ 0xD7ADF884AA879177, 0x5B0ED81DCC6ABB0F },
+	{ 0x86CCBB52EA94BAEA, 0x98E947129FC2B4E9 },
+	{ 0xA87FEA27A539E9A5, 0x3F2398D747B36224 },
+	{ 0xD29FE4B18E88640E, 0x8EEC7F0D19A03AAD },
+	{ 0x83A3EEEEF9153E89, 0x1953CF68300424AC },
+	{ 0xA48CEAAAB75A8E2B, 0x5FA8C3423C052DD7 },
+	{ 0xCDB02555653131B6, 0x3792F412CB06794D },
+	{ 0x808E17555F3EBF11, 0xE2BBD88BBEE40BD0 },
+	{ 0xA0B19D2AB70E6ED6, 0x5B6ACEAEAE9D0EC4 },
+	{ 0xC8DE047564D20A8B, 0xF245825A5A445275 },
+	{ 0xFB158592BE068D2E, 0xEED6E2F0F0D56712 },
+	{ 0x9CED737BB6C4183D, 0x55464DD69685606B },
+	{ 0xC428D05AA4751E4C, 0xAA97E14C3C26B886 },
+	{ 0xF53304714D9265DF, 0xD53DD99F4B3066A8 },
+	{ 0x993FE2C6D07B7FAB, 0xE546A8038EFE4029 },
+	{ 0xBF8FDB78849A5F96, 0xDE98520472BDD033 },
+	{ 0xEF73D256A5C0F77C, 0x963E66858F6D4440 },
+	{ 0x95A8637627989AAD, 0xDDE7001379A44AA8 },
+	{ 0xBB127C53B17EC159, 0x5560C018580D5D52 },
+	{ 0xE9D71B689DDE71AF, 0xAAB8F01E6E10B4A6 },
+	{ 0x9226712162AB070D, 0xCAB3961304CA70E8 },
+	{ 0xB6B00D69BB55C8D1, 0x3D607B97C5FD0D22 },
+	{ 0xE45C10C42A2B3B05, 0x8CB89A7DB77C506A },
+	{ 0x8EB98A7A9A5B04E3, 0x77F3608E92ADB242 },
+	{ 0xB267ED1940F1C61C, 0x55F038B237591ED3 },
+	{ 0xDF01E85F912E37A3, 0x6B6C46DEC52F6688 },
+	{ 0x8B61313BBABCE2C6, 0x2323AC4B3B3DA015 },
+	{ 0xAE397D8AA96C1B77, 0xABEC975E0A0D081A },
+	{ 0xD9C7DCED53C72255, 0x96E7BD358C904A21 },
+	{ 0x881CEA14545C7575, 0x7E50D64177DA2E54 },
+	{ 0xAA242499697392D2, 0xDDE50BD1D5D0B9E9 },
+	{ 0xD4AD2DBFC3D07787, 0x955E4EC64B44E864 },
+	{ 0x84EC3C97DA624AB4, 0xBD5AF13BEF0B113E },
+	{ 0xA6274BBDD0FADD61, 0xECB1AD8AEACDD58E },
+	{ 0xCFB11EAD453994BA, 0x67DE18EDA5814AF2 },
+	{ 0x81CEB32C4B43FCF4, 0x80EACF948770CED7 },
+	{ 0xA2425FF75E14FC31, 0xA1258379A94D028D },
+	{ 0xCAD2F7F5359A3B3E, 0x096EE45813A04330 },
+	{ 0xFD87B5F28300CA0D, 0x8BCA9D6E188853FC },
+	{ 0x9E74D1B791E07E48, 0x775EA264CF55347E },
+	{ 0xC612062576589DDA, 0x95364AFE032A819E },
+	{ 0xF79687AED3EEC551, 0x3A83DDBD83F52205 },
+	{ 0x9ABE14CD44753B52, 0xC4926A9672793543 },
+	{ 0xC16D9A0095928A27, 0x75B7053C0F178294 },
+	{ 0xF1C90080BAF72CB1, 0x5324C68B12DD6339 },
+	{ 0x971DA05074DA7BEE, 0xD3F6FC16EBCA5E04 },
+	{ 0xBCE5086492111AEA, 0x88F4BB1CA6BCF585 },
+	{ 0xEC1E4A7DB69561A5, 0x2B31E9E3D06C32E6 },
+	{ 0x9392EE8E921D5D07, 0x3AFF322E62439FD0 },
+	{ 0xB877AA3236A4B449, 0x09BEFEB9FAD487C3 },
+	{ 0xE69594BEC44DE15B, 0x4C2EBE687989A9B4 },
+	{ 0x901D7CF73AB0ACD9, 0x0F9D37014BF60A11 },
+	{ 0xB424DC35095CD80F, 0x538484C19EF38C95 },
+	{ 0xE12E13424BB40E13, 0x2865A5F206B06FBA },
+	{ 0x8CBCCC096F5088CB, 0xF93F87B7442E45D4 },
+	{ 0xAFEBFF0BCB24AAFE, 0xF78F69A51539D749 },
+	{ 0xDBE6FECEBDEDD5BE, 0xB573440E5A884D1C },
+	{ 0x89705F4136B4A597, 0x31680A88F8953031 },
+	{ 0xABCC77118461CEFC, 0xFDC20D2B36BA7C3E },
+	{ 0xD6BF94D5E57A42BC, 0x3D32907604691B4D },
+	{ 0x8637BD05AF6C69B5, 0xA63F9A49C2C1B110 },
+	{ 0xA7C5AC471B478423, 0x0FCF80DC33721D54 },
+	{ 0xD1B71758E219652B, 0xD3C36113404EA4A9 },
+	{ 0x83126E978D4FDF3B, 0x645A1CAC083126EA },
+	{ 0xA3D70A3D70A3D70A, 0x3D70A3D70A3D70A4 },
+	{ 0xCCCCCCCCCCCCCCCC, 0xCCCCCCCCCCCCCCCD },
+	{ 0x8000000000000000, 0x0000000000000000 },
+	{ 0xA000000000000000, 0x0000000000000000 },
+	{ 0xC800000000000000, 0x0000000000000000 },
+	{ 0xFA00000000000000, 0x0000000000000000 },
+	{ 0x9C40000000000000, 0x0000000000000000 },
+	{ 0xC350000000000000, 0x0000000000000000 },
+	{ 0xF424000000000000, 0x0000000000000000 },
+	{ 0x9896800000000000, 0x0000000000000000 },
+	{ 0xBEBC200000000000, 0x0000000000000000 },
+	{ 0xEE6B280000000000, 0x0000000000000000 },
+	{ 0x9502F90000000000, 0x0000000000000000 },
+	{ 0xBA43B74000000000, 0x0000000000000000 },
+	{ 0xE8D4A51000000000, 0x0000000000000000 },
+	{ 0x9184E72A00000000, 0x0000000000000000 },
+	{ 0xB5E620F480000000, 0x0000000000000000 },
+	{ 0xE35FA931A0000000, 0x0000000000000000 },
+	{ 0x8E1BC9BF04000000, 0x0000000000000000 },
+	{ 0xB1A2BC2EC5000000, 0x0000000000000000 },
+	{ 0xDE0B6B3A76400000, 0x0000000000000000 },
+	{ 0x8AC7230489E80000, 0x0000000000000000 },
+	{ 0xAD78EBC5AC620000, 0x0000000000000000 },
+	{ 0xD8D726B7177A8000, 0x0000000000000000 },
+	{ 0x878678326EAC9000, 0x0000000000000000 },
+	{ 0xA968163F0A57B400, 0x0000000000000000 },
+	{ 0xD3C21BCECCEDA100, 0x0000000000000000 },
+	{ 0x84595161401484A0, 0x0000000000000000 },
+	{ 0xA56FA5B99019A5C8, 0x0000000000000000 },
+	{ 0xCECB8F27F4200F3A, 0x0000000000000000 },
+	{ 0x813F3978F8940984, 0x4000000000000000 },
+	{ 0xA18F07D736B90BE5, 0x5000000000000000 },
+	{ 0xC9F2C9CD04674EDE, 0xA400000000000000 },
+	{ 0xFC6F7C4045812296, 0x4D00000000000000 },
+	{ 0x9DC5ADA82B70B59D, 0xF020000000000000 },
+	{ 0xC5371912364CE305, 0x6C28000000000000 },
+	{ 0xF684DF56C3E01BC6, 0xC732000000000000 },
+	{ 0x9A130B963A6C115C, 0x3C7F400000000000 },
+	{ 0xC097CE7BC90715B3, 0x4B9F100000000000 },
+	{ 0xF0BDC21ABB48DB20, 0x1E86D40000000000 },
+	{ 0x96769950B50D88F4, 0x1314448000000000 },
+	{ 0xBC143FA4E250EB31, 0x17D955A000000000 },
+	{ 0xEB194F8E1AE525FD, 0x5DCFAB0800000000 },
+	{ 0x92EFD1B8D0CF37BE, 0x5AA1CAE500000000 },
+	{ 0xB7ABC627050305AD, 0xF14A3D9E40000000 },
+	{ 0xE596B7B0C643C719, 0x6D9CCD05D0000000 },
+	{ 0x8F7E32CE7BEA5C6F, 0xE4820023A2000000 },
+	{ 0xB35DBF821AE4F38B, 0xDDA2802C8A800000 },
+	{ 0xE0352F62A19E306E, 0xD50B2037AD200000 },
+	{ 0x8C213D9DA502DE45, 0x4526F422CC340000 },
+	{ 0xAF298D050E4395D6, 0x9670B12B7F410000 },
+	{ 0xDAF3F04651D47B4C, 0x3C0CDD765F114000 },
+	{ 0x88D8762BF324CD0F, 0xA5880A69FB6AC800 },
+	{ 0xAB0E93B6EFEE0053, 0x8EEA0D047A457A00 },
+	{ 0xD5D238A4ABE98068, 0x72A4904598D6D880 },
+	{ 0x85A36366EB71F041, 0x47A6DA2B7F864750 },
+	{ 0xA70C3C40A64E6C51, 0x999090B65F67D924 },
+	{ 0xD0CF4B50CFE20765, 0xFFF4B4E3F741CF6D },
+	{ 0x82818F1281ED449F, 0xBFF8F10E7A8921A4 },
+	{ 0xA321F2D7226895C7, 0xAFF72D52192B6A0D },
+	{ 0xCBEA6F8CEB02BB39, 0x9BF4F8A69F764490 },
+	{ 0xFEE50B7025C36A08, 0x02F236D04753D5B4 },
+	{ 0x9F4F2726179A2245, 0x01D762422C946590 },
+	{ 0xC722F0EF9D80AAD6, 0x424D3AD2B7B97EF5 },
+	{ 0xF8EBAD2B84E0D58B, 0xD2E0898765A7DEB2 },
+	{ 0x9B934C3B330C8577, 0x63CC55F49F88EB2F },
+	{ 0xC2781F49FFCFA6D5, 0x3CBF6B71C76B25FB },
+	{ 0xF316271C7FC3908A, 0x8BEF464E3945EF7A },
+	{ 0x97EDD871CFDA3A56, 0x97758BF0E3CBB5AC },
+	{ 0xBDE94E8E43D0C8EC, 0x3D52EEED1CBEA317 },
+	{ 0xED63A231D4C4FB27, 0x4CA7AAA863EE4BDD },
+	{ 0x945E455F24FB1CF8, 0x8FE8CAA93E74EF6A },
+	{ 0xB975D6B6EE39E436, 0xB3E2FD538E122B44 },
+	{ 0xE7D34C64A9C85D44, 0x60DBBCA87196B616 },
+	{ 0x90E40FBEEA1D3A4A, 0xBC8955E946FE31CD },
+	{ 0xB51D13AEA4A488DD, 0x6BABAB6398BDBE41 },
+	{ 0xE264589A4DCDAB14, 0xC696963C7EED2DD1 },
+	{ 0x8D7EB76070A08AEC, 0xFC1E1DE5CF543CA2 },
+	{ 0xB0DE65388CC8ADA8, 0x3B25A55F43294BCB },
+	{ 0xDD15FE86AFFAD912, 0x49EF0EB713F39EBE },
+	{ 0x8A2DBF142DFCC7AB, 0x6E3569326C784337 },
+	{ 0xACB92ED9397BF996, 0x49C2C37F07965404 },
+	{ 0xD7E77A8F87DAF7FB, 0xDC33745EC97BE906 },
+	{ 0x86F0AC99B4E8DAFD, 0x69A028BB3DED71A3 },
+	{ 0xA8ACD7C0222311BC, 0xC40832EA0D68CE0C },
+	{ 0xD2D80DB02AABD62B, 0xF50A3FA490C30190 },
+	{ 0x83C7088E1AAB65DB, 0x792667C6DA79E0FA },
+	{ 0xA4B8CAB1A1563F52, 0x577001B891185938 },
+	{ 0xCDE6FD5E09ABCF26, 0xED4C0226B55E6F86 },
+	{ 0x80B05E5AC60B6178, 0x544F8158315B05B4 },
+	{ 0xA0DC75F1778E39D6, 0x696361AE3DB1C721 },
+	{ 0xC913936DD571C84C, 0x03BC3A19CD1E38E9 },
+	{ 0xFB5878494ACE3A5F, 0x04AB48A04065C723 },
+	{ 0x9D174B2DCEC0E47B, 0x62EB0D64283F9C76 },
+	{ 0xC45D1DF942711D9A, 0x3BA5D0BD324F8394 },
+	{ 0xF5746577930D6500, 0xCA8F44EC7EE36479 },
+	{ 0x9968BF6ABBE85F20, 0x7E998B13CF4E1ECB },
+	{ 0xBFC2EF456AE276E8, 0x9E3FEDD8C321A67E },
+	{ 0xEFB3AB16C59B14A2, 0xC5CFE94EF3EA101E },
+	{ 0x95D04AEE3B80ECE5, 0xBBA1F1D158724A12 },
+	{ 0xBB445DA9CA61281F, 0x2A8A6E45AE8EDC97 },
+	{ 0xEA1575143CF97226, 0xF52D09D71A3293BD },
+	{ 0x924D692CA61BE758, 0x593C2626705F9C56 },
+};
+
+static uint64_t umul128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = (unsigned __int128)a * b;
+	*hi = r >> 64;
+	return r;
+#else
+	uint64_t a_lo = a & 0xffffffffu, a_hi = a >> 32;
+	uint64_t b_lo = b & 0xffffffffu, b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+	uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+	*hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	return (cross << 32) | (lo_lo & 0xffffffffu);
+#endif
+}
+
+/* layout of an IEEE binary format for eisel_lemire() */
+struct el_format {
+	int mbits;	/* explicit significand bits */
+	int min_exp;
+	int inf_power;
+	int rte_min_q;	/* range of q where w * 10^q can be a tie */
+	int rte_max_q;
+};
+
+static const struct el_format el_binary32 = {23, -127, 0xff, -17, 10};
+static const struct el_format el_binary64 = {52, -1023, 0x7ff, -4, 23};
+
+/*
+ * Round w * 10^q (w != 0) to the nearest value of format fmt, store its
+ * bits without the sign and return 0, or return -1 if undecided.
+ */
+static int eisel_lemire(uint64_t *bits, uint64_t w, int q,
+		const struct el_format *fmt)
+{
+	const uint64_t *pow5 = el_pow5[q - EL_MIN_Q];
+	uint64_t mask = ~0ull >> (fmt->mbits + 3);
+	uint64_t lo, hi, hi2, m;
+	int lz, upper, shift, power2;
+
+	lz = __builtin_clzll(w);
+	w <<= lz;
+	lo = umul128(w, pow5[0], &hi);
+	if ((hi & mask) == mask) {
+		/*
+		 * the low half of the second product is not needed: the
+		 * result can only stay ambiguous for q outside [-27, 55],
+		 * which falls back to strtod below
+		 */
+		umul128(w, pow5[1], &hi2);
+		lo += hi2;
+		if (hi2 > lo) {
+			++hi;
+		}
+		if ((hi & mask) == mask && lo + 1 == 0 && (q < -27 || q > 55)) {
+			return -1;
+		}
+	}
+	upper = hi >> 63;
+	shift = upper + 64 - fmt->mbits - 3;
+	m = hi >> shift;
+	power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz -
+		fmt->min_exp;
+	if (power2 <= 0) {
+		return -1;
+	}
+	if (lo <= 1 && q >= fmt->rte_min_q && q <= fmt->rte_max_q &&
+			(m & 3) == 1 && (m << shift) == hi) {
+		m &= ~1ull;
+	}
+	m += m & 1;
+	m >>= 1;
+	if (m >= (2ull << fmt->mbits)) {
+		m = 1ull << fmt->mbits;
+		++power2;
+	}
+	m &= ~(1ull << fmt->mbits);
+	if (power2 >= fmt->inf_power) {
+		return -1;
+	}
+	*bits = m | (uint64_t)power2 << fmt->mbits;
+	return 0;
+}
+
+/*
+ * Split a decimal literal into sign, significand and exponent.
+ * Return 0 if it fits the fast paths, -1 otherwise.
+ */
+static int decimal_split(const char *in, int *neg, uint64_t *w, int *q)
+{
+	uint64_t v = 0;
+	int digits = 0, exp = 0, e = 0, eneg;
+
+	*neg = *in == '-';
+	if (*in == '+' || *in == '-') {
+		++in;
+	}
+	if (in[0] == '0' && (in[1] == 'x' || in[1] == 'X')) {
+		return -1;
+	}
+	for (; is_digit(*in); ++in) {
+		if (v || *in != '0') {
+			if (++digits > 19) {
+				return -1;
+			}
+			v = v * 10 + (*in - '0');
+		}
+	}
+	if (*in == '.') {
+		for (++in; is_digit(*in); ++in) {
+			if (v || *in != '0') {
+				if (++digits > 19) {
+					return -1;
+				}
+				v = v * 10 + (*in - '0');
+			}
+			--exp;
+		}
+	}
+	if (*in == 'e' || *in == 'E') {
+		++in;
+		eneg = *in == '-';
+		if (*in == '+' || *in == '-') {
+			++in;
+		}
+		if (!is_digit(*in)) {
+			return -1;
+		}
+		for (; is_digit(*in); ++in) {
+			if (e < 10000) {
+				e = e * 10 + (*in - '0');
+			}
+		}
+		exp += eneg ? -e : e;
+	}
+	if (!is_int_suffix(in) && !((*in == 'f' || *in == 'F') && !in[1])) {
+		return -1;
+	}
+	*w = v;
+	*q = exp;
+	return 0;
+}
+
+static const double exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* return 0 if converted, otherwise return -errno, most likely -ERANGE */
+static int to_double(double *out, const char *in)
+{
+	uint64_t w, bits;
+	int neg, q;
+	double d;
+
+	if (!decimal_split(in, &neg, &w, &q)) {
+		if (!w) {
+			*out = neg ? -0.0 : 0.0;
+			return 0;
+		}
+#if FLT_EVAL_METHOD == 0
+		if (-22 <= q && q <= 22 && w <= 1ull << 53) {
+			d = q < 0 ? (double)w / exact_pow10[-q] :
+				(double)w * exact_pow10[q];
+			*out = neg ? -d : d;
+			return 0;
+		}
+#endif
+		if (EL_MIN_Q <= q && q <= EL_MAX_Q &&
+				!eisel_lemire(&bits, w, q, &el_binary64)) {
+			bits |= (uint64_t)neg << 63;
+			memcpy(out, &bits, sizeof(*out));
+			return 0;
+		}
+	}
 	errno = 0;
-	ret = strtoull(in, NULL, 0);
-	if (!errno) {
-		*out = ret;
-		return 0;
-	} else {
+	d = strtod(in, NULL);
+	if (errno) {
 		return -errno;
 	}
+	*out = d;
+	return 0;
 }
 
-static int xdigit_to_int(int c)
-{ return '0' <= c && c <= '9' ? c - '0' : 
-	'a' <= c && c <= 'f' ? c - 'a' : c - 'A'; }
+/* return 0 if converted, otherwise return -errno, most likely -ERANGE */
+static int to_float(float *out, const char *in)
+{
+	uint64_t w, bits;
+	uint32_t bits32;
+	int neg, q;
+	float f;
+
+	if (!decimal_split(in, &neg, &w, &q)) {
+		if (!w) {
+			*out = neg ? -0.0f : 0.0f;
+			return 0;
+		}
+#if FLT_EVAL_METHOD == 0
+		if (-10 <= q && q <= 10 && w <= 1ull << 24) {
+			f = q < 0 ? (float)w / (float)exact_pow10[-q] :
+				(float)w * (float)exact_pow10[q];
+			*out = neg ? -f : f;
+			return 0;
+		}
+#endif
+		if (EL_MIN_Q <= q && q <= EL_MAX_Q &&
+				!eisel_lemire(&bits, w, q, &el_binary32)) {
+			bits32 = bits | (uint32_t)neg << 31;
+			memcpy(out, &bits32, sizeof(*out));
+			return 0;
+		}
+	}
+	errno = 0;
+	f = strtof(in, NULL);
+	if (errno) {
+		return -errno;
+	}
+	*out = f;
+	return 0;
+}
+
+/* return 0 if converted, otherwise return -errno, most likely -ERANGE */
+static int to_ldouble(long double *out, const char *in)
+{
+	long double ld;
+
+	errno = 0;
+	ld = strtold(in, NULL);
+	if (errno) {
+		return -errno;
+	}
+	*out = ld;
+	return 0;
+}
+
+/*
+ * String kernels, return the length of the leading run of s[0, n) which
+ * can be copied as is: up to the next backslash when parsing, up to the
+ * next '"', backslash or non-printable character when dumping.
+ * On x86, 16 or 32 bytes are checked at once, the implementation is chosen
+ * by cpu features on the first call.
+ */
+typedef size_t (*plain_len_func)(const char *s, size_t n);
+
+static size_t plain_len_parse_scalar(const char *s, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n && s[i] != '\\'; ++i) {
+	}
+	return i;
+}
+
+static size_t plain_len_dump_scalar(const char *s, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		if (s[i] == '"' || s[i] == '\\' || s[i] < 0x20 || s[i] > 126) {
+			break;
+		}
+	}
+	return i;
+}
+
+#ifdef STR_SIMD_X86
+__attribute__((target("sse2")))
+static size_t plain_len_parse_sse2(const char *s, size_t n)
+{
+	const __m128i bs = _mm_set1_epi8('\\');
+	unsigned mask;
+	size_t i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, bs));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + plain_len_parse_scalar(s + i, n - i);
+}
+
+/* signed compare, so bytes >= 0x80 are not printable */
+__attribute__((target("sse2")))
+static size_t plain_len_dump_sse2(const char *s, size_t n)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bs = _mm_set1_epi8('\\');
+	const __m128i lo = _mm_set1_epi8(0x1f);
+	const __m128i hi = _mm_set1_epi8(0x7f);
+	unsigned mask;
+	size_t i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i printable = _mm_and_si128(_mm_cmpgt_epi8(x, lo),
+				_mm_cmplt_epi8(x, hi));
+		__m128i special = _mm_or_si128(_mm_cmpeq_epi8(x, quote),
+				_mm_cmpeq_epi8(x, bs));
+		mask = ~_mm_movemask_epi8(_mm_andnot_si128(special, printable))
+			& 0xffff;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + plain_len_dump_scalar(s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t plain_len_parse_avx2(const char *s, size_t n)
+{
+	const __m256i bs = _mm256_set1_epi8('\\');
+	unsigned mask;
+	size_t i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, bs));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + plain_len_parse_sse2(s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t plain_len_dump_avx2(const char *s, size_t n)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i bs = _mm256_set1_epi8('\\');
+	const __m256i lo = _mm256_set1_epi8(0x1f);
+	const __m256i hi = _mm256_set1_epi8(0x7f);
+	unsigned mask;
+	size_t i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(x, lo),
+				_mm256_cmpgt_epi8(hi, x));
+		__m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(x, quote),
+				_mm256_cmpeq_epi8(x, bs));
+		mask = ~_mm256_movemask_epi8(
+				_mm256_andnot_si256(special, printable));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + plain_len_dump_sse2(s + i, n - i);
+}
+#endif
+
+static plain_len_func pick_plain_len(int dump)
+{
+#ifdef STR_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return dump ? plain_len_dump_avx2 : plain_len_parse_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return dump ? plain_len_dump_sse2 : plain_len_parse_sse2;
+	}
+#endif
+	return dump ? plain_len_dump_scalar : plain_len_parse_scalar;
+}
+
+static size_t plain_len_parse(const char *s, size_t n)
+{
+	static plain_len_func impl;
+	plain_len_func f = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+	if (!f) {
+		f = pick_plain_len(0);
+		__atomic_store_n(&impl, f, __ATOMIC_RELAXED);
+	}
+	return f(s, n);
+}
+
+static size_t plain_len_dump(const char *s, size_t n)
+{
+	static plain_len_func impl;
+	plain_len_func f = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+	if (!f) {
+		f = pick_plain_len(1);
+		__atomic_store_n(&impl, f, __ATOMIC_RELAXED);
+	}
+	return f(s, n);
+}
 
 /* return >0 if converted, -EINVAL otherwise */
 static int unescape(char *out, const char *in)
 {
-	if (*in != '\'') {
+	int hi, lo;
+	if (*in != '\\') {
 		*out = *in;
 		return 1;
 	}
@@ -91,10 +818,11 @@ static int unescape(char *out, const char *in)
 		*out = '\?';
 		return 2;
 	case 'x':
-		if (!isxdigit(in[1]) || !isxdigit(in[2])) {
+		if ((hi = xdigit_to_int(in[1])) < 0 ||
+				(lo = xdigit_to_int(in[2])) < 0) {
 			return -EINVAL;
 		}
-		*out = (xdigit_to_int(in[1]) << 4) | xdigit_to_int(in[2]);
+		*out = hi << 4 | lo;
 		return 4;
 	default:
 		return -EINVAL;
@@ -112,7 +840,7 @@ static int parse_char(struct pass_to_conv *context, char *result, const struct n
 	case VAL_SCALE_CHAR:
 		ret = unescape(result, val->char_str);
 		if (ret > 0) {	/* parsed */
-			if (!val->char_str[ret]) {	/* still have something */
+			if (val->char_str[ret]) {	/* still have something */
 				context->node = val;
 				context->msg = "value cannot be converted to a character.";
 				return -EINVAL;
@@ -138,7 +866,7 @@ static int parse_schar(struct pass_to_conv *context, signed char *result, const
 	case VAL_SCALE_CHAR:
 		ret = unescape((char *)result, val->char_str);
 		if (ret > 0) {	/* parsed */
-			if (!val->char_str[ret]) {	/* still have something */
+			if (val->char_str[ret]) {	/* still have something */
 				context->node = val;
 				context->msg = "value cannot be converted to a character.";
 				return -EINVAL;
@@ -178,7 +906,7 @@ static int parse_uchar(struct pass_to_conv *context, unsigned char *result, cons
 	case VAL_SCALE_CHAR:
 		ret = unescape((char *)result, val->char_str);
 		if (ret > 0) {	/* parsed */
-			if (!val->char_str[ret]) {	/* still have something */
+			if (val->char_str[ret]) {	/* still have something */
 				context->node = val;
 				context->msg = "value cannot be converted to a character.";
 				return -EINVAL;
@@ -212,10 +940,10 @@ static int parse_uchar(struct pass_to_conv *context, unsigned char *result, cons
 
 static void char_dump(put_func func, struct dump_context *ctx, const char *c)
 {
-	if (0x20 <= *c && *c <= 126) {
+	if (0x20 <= *c && *c <= 126 && *c != '\'' && *c != '\\') {
 		func(ctx, "\'%c\'", *c);
 	} else {
-		func(ctx, "\'x%hhx\'", (unsigned char)*c);
+		func(ctx, "\'\\x%02hhx\'", (unsigned char)*c);
 	}
 }
 
@@ -234,9 +962,62 @@ static void dump_schar(put_func func, struct dump_context *ctx, const unsigned c
 	char_dump(func, ctx, (const char *)c);
 }
 
-static void free_char(char *val) {}
-static void free_schar(signed char *val) {}
-static void free_uchar(unsigned char *val) {}
+static void char_bdump(struct dump_buffer *buf, const char *c)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char u = *c;
+	if (0x20 <= *c && *c <= 126 && *c != '\'' && *c != '\\') {
+		char out[3] = {'\'', *c, '\''};
+		dump_buffer_put(buf, out, 3);
+	} else {
+		char out[6] = {'\'', '\\', 'x', hex[u >> 4], hex[u & 0xf], '\''};
+		dump_buffer_put(buf, out, 6);
+	}
+}
+
+static void bdump_char(struct dump_buffer *buf, const char *c)
+{
+	char_bdump(buf, c);
+}
+
+static void bdump_uchar(struct dump_buffer *buf, const unsigned char *c)
+{
+	char_bdump(buf, (const char *)c);
+}
+
+static void bdump_schar(struct dump_buffer *buf, const signed char *c)
+{
+	char_bdump(buf, (const char *)c);
+}
+
+#define char_compare(def_type, map_type) \
+	static uint64_t hash_##def_type(const map_type *c) \
+	{ \
+		return (unsigned char)*c; \
+	} \
+	\
+	static int equal_##def_type(const map_type *a, const map_type *b) \
+	{ \
+		return *a == *b; \
+	}
+
+char_compare(char, char)
+char_compare(schar, signed char)
+char_compare(uchar, unsigned char)
+
+static void free_char(struct pass_to_conv *context, char *val) {}
+static void free_schar(struct pass_to_conv *context, signed char *val) {}
+static void free_uchar(struct pass_to_conv *context, unsigned char *val) {}
+
+/* whether every value of an integer range is within [min, max] */
+static int range_within(const struct node_run *run, long long min,
+		unsigned long long max)
+{
+	long long last = run->first + (run->count - 1) * run->step;
+	long long lo = run->step > 0 ? run->first : last;
+	long long hi = run->step > 0 ? last : run->first;
+	return lo >= min && (hi < 0 || (unsigned long long)hi <= max);
+}
 
 #define signed_def(def_type, map_type, min, max) \
 	static int parse_##def_type(struct pass_to_conv *context, map_type *result, const struct node_value *val) \
@@ -270,7 +1051,65 @@ static void free_uchar(unsigned char *val) {}
 		func(ctx, "%lld", (long long)*val); \
 	} \
 	\
-	static void free_##def_type(map_type *val) {}
+	/* \
+	 * Convert n elements in one tight loop, the first bad one is parsed \
+	 * again by parse_##def_type to report the error. A repeated value \
+	 * is converted once and copied, a range is filled in place. \
+	 */ \
+	static int parse_##def_type##_array(struct pass_to_conv *context, map_type *result, \
+			const struct node_elems *elems, long n) \
+	{ \
+		const struct node_value *val; \
+		const struct node_run *run; \
+		struct elems_iter iter; \
+		long long tmp; \
+		long i, k; \
+		int ret; \
+		elems_iter_init(&iter, elems); \
+		for (i = 0; i < n; ++i) { \
+			run = elems_iter_range(&iter); \
+			if (run && run->count <= n - i && \
+					range_within(run, min, max)) { \
+				for (k = 0; k < run->count; ++k) { \
+					result[i + k] = run->first + k * run->step; \
+				} \
+				i += run->count - 1; \
+				elems_iter_skip(&iter); \
+				continue; \
+			} \
+			val = elems_iter_next(&iter); \
+			if (iter.same) { \
+				result[i] = result[i - 1]; \
+				continue; \
+			} \
+			if (val->type != VAL_SCALE_INT || \
+					to_longlong(&tmp, val->int_str) || tmp < min || tmp > max) { \
+				ret = parse_##def_type(context, &result[i], val); \
+				elems_iter_keep(&iter, context); \
+				return ret; \
+			} \
+			result[i] = tmp; \
+		} \
+		return 0; \
+	} \
+	\
+	static void bdump_##def_type(struct dump_buffer *buf, const map_type *val) \
+	{ \
+		dump_buffer_put_ll(buf, *val); \
+	} \
+	\
+	static uint64_t hash_##def_type(const map_type *val) \
+	{ \
+		return *val; \
+	} \
+	\
+	static int equal_##def_type(const map_type *a, const map_type *b) \
+	{ \
+		return *a == *b; \
+	} \
+	\
+	static void free_##def_type(struct pass_to_conv *context, \
+		map_type *val) {}
 
 #define unsigned_def(def_type, map_type, max) \
 	static int parse_##def_type(struct pass_to_conv *context, map_type *result, const struct node_value *val) \
@@ -279,7 +1118,7 @@ static void free_uchar(unsigned char *val) {}
 		unsigned long long i; \
 		switch (val->type) { \
 		case VAL_SCALE_INT: \
-			ret = to_longlong(&i, val->int_str); \
+			ret = to_ulonglong(&i, val->int_str); \
 			if (ret) { \
 				context->node = val; \
 				context->msg = "overflow occurred."; \
@@ -301,10 +1140,64 @@ static void free_uchar(unsigned char *val) {}
 	\
 	static void dump_##def_type(put_func func, struct dump_context *ctx, const map_type *val) \
 	{ \
-		func(ctx, "%lld", (long long)*val); \
+		func(ctx, "%llu", (unsigned long long)*val); \
+	} \
+	\
+	/* batch version of parse_##def_type, see signed_def */ \
+	static int parse_##def_type##_array(struct pass_to_conv *context, map_type *result, \
+			const struct node_elems *elems, long n) \
+	{ \
+		const struct node_value *val; \
+		const struct node_run *run; \
+		struct elems_iter iter; \
+		unsigned long long tmp; \
+		long i, k; \
+		int ret; \
+		elems_iter_init(&iter, elems); \
+		for (i = 0; i < n; ++i) { \
+			run = elems_iter_range(&iter); \
+			if (run && run->count <= n - i && \
+					range_within(run, 0, max)) { \
+				for (k = 0; k < run->count; ++k) { \
+					result[i + k] = run->first + k * run->step; \
+				} \
+				i += run->count - 1; \
+				elems_iter_skip(&iter); \
+				continue; \
+			} \
+			val = elems_iter_next(&iter); \
+			if (iter.same) { \
+				result[i] = result[i - 1]; \
+				continue; \
+			} \
+			if (val->type != VAL_SCALE_INT || \
+					to_ulonglong(&tmp, val->int_str) || tmp > max) { \
+				ret = parse_##def_type(context, &result[i], val); \
+				elems_iter_keep(&iter, context); \
+				return ret; \
+			} \
+			result[i] = tmp; \
+		} \
+		return 0; \
+	} \
+	\
+	static void bdump_##def_type(struct dump_buffer *buf, const map_type *val) \
+	{ \
+		dump_buffer_put_ull(buf, *val); \
+	} \
+	\
+	static uint64_t hash_##def_type(const map_type *val) \
+	{ \
+		return *val; \
 	} \
 	\
-	static void free_##def_type(map_type *val) {}
+	static int equal_##def_type(const map_type *a, const map_type *b) \
+	{ \
+		return *a == *b; \
+	} \
+	\
+	static void free_##def_type(struct pass_to_conv *context, \
+		map_type *val) {}
 
 signed_def(short, short, SHRT_MIN, SHRT_MAX)
 unsigned_def(ushort, unsigned short, USHRT_MAX)
@@ -324,11 +1217,409 @@ unsigned_def(u32, uint32_t, UINT32_MAX)
 signed_def(s64, int64_t, INT64_MIN, INT64_MAX)
 unsigned_def(u64, uint64_t, UINT64_MAX)
 
-#define fp_gen(func_name, out_type, convert_func) \
+/*
+ * Round-trip formatting of floating point values (Grisu2).
+ * strto{f,d} of the output gives the same value back. The digits are the
+ * shortest for all but about 0.1% of the values, which get one or two
+ * more as the boundaries are shrunk to stay exact.
+ */
+struct diyfp {
+	uint64_t f;
+	int e;
+};
+
+struct cached_power {
+	uint64_t f;
+	int e;
+	int k;
+};
+
+/* c_k = 10^k, normalized, for k = -300, -292, ..., 324 */
+static const struct cached_power cached_powers[] = {
+	{ 0xAB70FE17C79AC6CA, -1060, -300 },
+	{ 0xFF77B1FCBEBCDC4F, -1034, -292 },
+	{ 0xBE5691EF416BD60C, -1007, -284 },
+	{ 0x8DD01FAD907FFC3C,  -980, -276 },
+	{ 0xD3515C2831559A83,  -954, -268 },
+	{ 0x9D71AC8FADA6C9B5,  -927, -260 },
+	{ 0xEA9C227723EE8BCB,  -901, -252 },
+	{ 0xAECC49914078536D,  -874, -244 },
+	{ 0x823C12795DB6CE57,  -847, -236 },
+	{ 0xC21094364DFB5637,  -821, -228 },
+	{ 0x9096EA6F3848984F,  -794, -220 },
+	{ 0xD77485CB25823AC7,  -768, -212 },
+	{ 0xA086CFCD97BF97F4,  -741, -204 },
+	{ 0xEF340A98172AACE5,  -715, -196 },
+	{ 0xB23867FB2A35B28E,  -688, -188 },
+	{ 0x84C8D4DFD2C63F3B,  -661, -180 },
+	{ 0xC5DD44271AD3CDBA,  -635, -172 },
+	{ 0x936B9FCEBB25C996,  -608, -164 },
+	{ 0xDBAC6C247D62A584,  -582, -156 },
+	{ 0xA3AB66580D5FDAF6,  -555, -148 },
+	{ 0xF3E2F893DEC3F126,  -529, -140 },
+	{ 0xB5B5ADA8AAFF80B8,  -502, -132 },
+	{ 0x87625F056C7C4A8B,  -475, -124 },
+	{ 0xC9BCFF6034C13053,  -449, -116 },
+	{ 0x964E858C91BA2655,  -422, -108 },
+	{ 0xDFF9772470297EBD,  -396, -100 },
+	{ 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+	{ 0xF8A95FCF88747D94,  -343,  -84 },
+	{ 0xB94470938FA89BCF,  -316,  -76 },
+	{ 0x8A08F0F8BF0F156B,  -289,  -68 },
+	{ 0xCDB02555653131B6,  -263,  -60 },
+	{ 0x993FE2C6D07B7FAC,  -236,  -52 },
+	{ 0xE45C10C42A2B3B06,  -210,  -44 },
+	{ 0xAA242499697392D3,  -183,  -36 },
+	{ 0xFD87B5F28300CA0E,  -157,  -28 },
+	{ 0xBCE5086492111AEB,  -130,  -20 },
+	{ 0x8CBCCC096F5088CC,  -103,  -12 },
+	{ 0xD1B71758E219652C,   -77,   -4 },
+	{ 0x9C40000000000000,   -50,    4 },
+	{ 0xE8D4A51000000000,   -24,   12 },
+	{ 0xAD78EBC5AC620000,     3,   20 },
+	{ 0x813F3978F8940984,    30,   28 },
+	{ 0xC097CE7BC90715B3,    56,   36 },
+	{ 0x8F7E32CE7BEA5C70,    83,   44 },
+	{ 0xD5D238A4ABE98068,   109,   52 },
+	{ 0x9F4F2726179A2245,   136,   60 },
+	{ 0xED63A231D4C4FB27,   162,   68 },
+	{ 0xB0DE65388CC8ADA8,   189,   76 },
+	{ 0x83C7088E1AAB65DB,   216,   84 },
+	{ 0xC45D1DF942711D9A,   242,   92 },
+	{ 0x924D692CA61BE758,   269,  100 },
+	{ 0xDA01EE641A708DEA,   295,  108 },
+	{ 0xA26DA3999AEF774A,   322,  116 },
+	{ 0xF209787BB47D6B85,   348,  124 },
+	{ 0xB454E4A179DD1877,   375,  132 },
+	{ 0x865B86925B9BC5C2,   402,  140 },
+	{ 0xC83553C5C8965D3D,   428,  148 },
+	{ 0x952AB45CFA97A0B3,   455,  156 },
+	{ 0xDE469FBD99A05FE3,   481,  164 },
+	{ 0xA59BC234DB398C25,   508,  172 },
+	{ 0xF6C69A72A3989F5C,   534,  180 },
+	{ 0xB7DCBF5354E9BECE,   561,  188 },
+	{ 0x88FCF317F22241E2,   588,  196 },
+	{ 0xCC20CE9BD35C78A5,   614,  204 },
+	{ 0x98165AF37B2153DF,   641,  212 },
+	{ 0xE2A0B5DC971F303A,   667,  220 },
+	{ 0xA8D9D1535CE3B396,   694,  228 },
+	{ 0xFB9B7CD9A4A7443C,   720,  236 },
+	{ 0xBB764C4CA7A44410,   747,  244 },
+	{ 0x8BAB8EEFB6409C1A,   774,  252 },
+	{ 0xD01FEF10A657842C,   800,  260 },
+	{ 0x9B10A4E5E9913129,   827,  268 },
+	{ 0xE7109BFBA19C0C9D,   853,  276 },
+	{ 0xAC2820D9623BF429,   880,  284 },
+	{ 0x80444B5E7AA7CF85,   907,  292 },
+	{ 0xBF21E44003ACDD2D,   933,  300 },
+	{ 0x8E679C2F5E44FF8F,   960,  308 },
+	{ 0xD433179D9C8CB841,   986,  316 },
+	{ 0x9E19DB92B4E31BA9,  1013,  324 },
+};
+
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP (8)
+
+/* the products are kept in [2^-60, 2^-32) */
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+
+static struct diyfp diyfp_sub(struct diyfp x, struct diyfp y)
+{
+	struct diyfp r = {x.f - y.f, x.e};
+	return r;
+}
+
+/* round(x * y / 2^64) */
+static struct diyfp diyfp_mul(struct diyfp x, struct diyfp y)
+{
+	uint64_t a = x.f >> 32, b = x.f & 0xffffffffu;
+	uint64_t c = y.f >> 32, d = y.f & 0xffffffffu;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t mid = (bd >> 32) + (ad & 0xffffffffu) + (bc & 0xffffffffu);
+	struct diyfp r;
+	mid += 1u << 31;
+	r.f = ac + (ad >> 32) + (bc >> 32) + (mid >> 32);
+	r.e = x.e + y.e + 64;
+	return r;
+}
+
+static struct diyfp diyfp_normalize(struct diyfp x)
+{
+	int s = __builtin_clzll(x.f);
+	x.f <<= s;
+	x.e -= s;
+	return x;
+}
+
+/*
+ * v = f * 2^e of an IEEE value with prec bits of significand (including
+ * the hidden bit) and the given minimal exponent, compute the normalized
+ * v and the boundaries m- and m+ sharing the exponent of v.
+ */
+static void diyfp_boundaries(uint64_t bits, int prec, int bias,
+		struct diyfp *m_minus, struct diyfp *v, struct diyfp *m_plus)
+{
+	uint64_t hidden = (uint64_t)1 << (prec - 1);
+	uint64_t frac = bits & (hidden - 1);
+	uint64_t exp = bits >> (prec - 1);
+	struct diyfp lo, hi;
+
+	if (exp == 0) {
+		v->f = frac;
+		v->e = 1 - bias;
+	} else {
+		v->f = frac + hidden;
+		v->e = (int)exp - bias;
+	}
+	hi.f = 2 * v->f + 1;
+	hi.e = v->e - 1;
+	if (frac == 0 && exp > 1) {	/* lower boundary is closer */
+		lo.f = 4 * v->f - 1;
+		lo.e = v->e - 2;
+	} else {
+		lo.f = 2 * v->f - 1;
+		lo.e = v->e - 1;
+	}
+	*m_plus = diyfp_normalize(hi);
+	lo.f <<= lo.e - m_plus->e;
+	lo.e = m_plus->e;
+	*m_minus = lo;
+	*v = diyfp_normalize(*v);
+}
+
+static const struct cached_power *cached_power_for(int e)
+{
+	int f = GRISU_ALPHA - e - 1;
+	int k = (f * 78913) / (1 << 18) + (f > 0);
+	int index = (-CACHED_POWERS_MIN_DEC_EXP + k +
+			(CACHED_POWERS_DEC_STEP - 1)) / CACHED_POWERS_DEC_STEP;
+	return &cached_powers[index];
+}
+
+static void grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta,
+		uint64_t rest, uint64_t ten_k)
+{
+	while (rest < dist && delta - rest >= ten_k &&
+			(rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+		--buf[len - 1];
+		rest += ten_k;
+	}
+}
+
+/* generate digits of w into buf, such that M- < buf * 10^K < M+ */
+static int grisu2_digits(char *buf, int *K, struct diyfp m_minus,
+		struct diyfp w, struct diyfp m_plus)
+{
+	static const uint32_t pow10[] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+		100000000, 1000000000,
+	};
+	uint64_t delta = diyfp_sub(m_plus, m_minus).f;
+	uint64_t dist = diyfp_sub(m_plus, w).f;
+	int shift = -m_plus.e;
+	uint64_t one = (uint64_t)1 << shift;
+	uint32_t p1 = m_plus.f >> shift;
+	uint64_t p2 = m_plus.f & (one - 1);
+	uint64_t rest;
+	int len = 0, n, m;
+
+	for (n = 10; n > 1 && p1 < pow10[n - 1]; --n) {
+	}
+	while (n > 0) {
+		--n;
+		buf[len++] = '0' + p1 / pow10[n];
+		p1 %= pow10[n];
+		rest = ((uint64_t)p1 << shift) + p2;
+		if (rest <= delta) {
+			*K += n;
+			grisu2_round(buf, len, dist, delta, rest,
+					(uint64_t)pow10[n] << shift);
+			return len;
+		}
+	}
+	for (m = 0; ; ) {
+		p2 *= 10;
+		buf[len++] = '0' + (p2 >> shift);
+		p2 &= one - 1;
+		++m;
+		delta *= 10;
+		dist *= 10;
+		if (p2 <= delta) {
+			break;
+		}
+	}
+	*K -= m;
+	grisu2_round(buf, len, dist, delta, p2, one);
+	return len;
+}
+
+/* format digits * 10^K in a form the config lexer reads as a float */
+static int fp_format(char *out, const char *digits, int len, int K)
+{
+	int n = len + K;	/* position of the decimal point */
+	int i = 0, e;
+
+	if (0 < n && n <= 21) {
+		if (K >= 0) {
+			memcpy(out, digits, len);
+			memset(out + len, '0', K);
+			i = n;
+			memcpy(out + i, ".0", 2);
+			return i + 2;
+		}
+		memcpy(out, digits, n);
+		out[n] = '.';
+		memcpy(out + n + 1, digits + n, len - n);
+		return len + 1;
+	}
+	if (-6 < n && n <= 0) {
+		memcpy(out, "0.", 2);
+		memset(out + 2, '0', -n);
+		memcpy(out + 2 - n, digits, len);
+		return 2 - n + len;
+	}
+	out[i++] = digits[0];
+	out[i++] = '.';
+	if (len > 1) {
+		memcpy(out + i, digits + 1, len - 1);
+		i += len - 1;
+	} else {
+		out[i++] = '0';
+	}
+	out[i++] = 'e';
+	e = n - 1;
+	if (e < 0) {
+		out[i++] = '-';
+		e = -e;
+	}
+	if (e >= 100) {
+		out[i++] = '0' + e / 100;
+		e %= 100;
+		out[i++] = '0' + e / 10;
+	} else if (e >= 10) {
+		out[i++] = '0' + e / 10;
+	}
+	out[i++] = '0' + e % 10;
+	return i;
+}
+
+/* write a special value or the sign, return length, or -1 if finite */
+static int fp_special(char *out, int sign, int is_inf, int is_nan)
+{
+	if (is_nan) {
+		memcpy(out, "nan", 3);
+		return 3;
+	}
+	if (sign) {
+		*out++ = '-';
+	}
+	if (is_inf) {
+		memcpy(out, "inf", 3);
+		return sign + 3;
+	}
+	return -1;
+}
+
+/* out needs FP_STR_MAX bytes, '\0' is not appended */
+#define FP_STR_MAX (64)
+
+static int grisu2_format(char *out, uint64_t bits, int sign, int prec,
+		int bias)
+{
+	struct diyfp m_minus, v, m_plus, w, w_minus, w_plus, c;
+	const struct cached_power *cached;
+	char digits[24];
+	int len, K;
+
+	if (!bits) {
+		memcpy(out + sign, "0.0", 3);
+		return sign + 3;
+	}
+	diyfp_boundaries(bits, prec, bias, &m_minus, &v, &m_plus);
+	cached = cached_power_for(m_plus.e);
+	c.f = cached->f;
+	c.e = cached->e;
+	w = diyfp_mul(v, c);
+	w_minus = diyfp_mul(m_minus, c);
+	w_plus = diyfp_mul(m_plus, c);
+	/* conservatively shrink the interval by the error of the products */
+	++w_minus.f;
+	--w_plus.f;
+	K = -cached->k;
+	len = grisu2_digits(digits, &K, w_minus, w, w_plus);
+	return sign + fp_format(out + sign, digits, len, K);
+}
+
+static int double_to_str(char *out, double val)
+{
+	uint64_t bits;
+	int sign, ret;
+
+	memcpy(&bits, &val, sizeof(bits));
+	sign = bits >> 63;
+	ret = fp_special(out, sign, isinf(val), isnan(val));
+	if (ret >= 0) {
+		return ret;
+	}
+	return grisu2_format(out, bits & ~((uint64_t)1 << 63), sign, 53, 1075);
+}
+
+static int float_to_str(char *out, float val)
+{
+	uint32_t bits;
+	int sign, ret;
+
+	memcpy(&bits, &val, sizeof(bits));
+	sign = bits >> 31;
+	ret = fp_special(out, sign, isinf(val), isnan(val));
+	if (ret >= 0) {
+		return ret;
+	}
+	return grisu2_format(out, bits & ~((uint32_t)1 << 31), sign, 24, 150);
+}
+
+#ifndef LDBL_DECIMAL_DIG
+#define LDBL_DECIMAL_DIG (LDBL_DIG + 3)
+#endif
+
+/*
+ * No Grisu for long double: take the shortest of LDBL_DIG ...
+ * LDBL_DECIMAL_DIG significant digits which reads back the same.
+ */
+static int ldouble_to_str(char *out, long double val)
+{
+	int prec, len;
+	char *dot;
+
+	len = fp_special(out, signbit(val) != 0, isinf(val), isnan(val));
+	if (len >= 0) {
+		return len;
+	}
+	for (prec = LDBL_DIG; ; ++prec) {
+		len = snprintf(out, FP_STR_MAX - 2, "%.*Lg", prec, val);
+		if (prec >= LDBL_DECIMAL_DIG || strtold(out, NULL) == val) {
+			break;
+		}
+	}
+	if (!strchr(out, '.')) {
+		dot = strchr(out, 'e');
+		if (!dot) {
+			dot = out + len;
+		}
+		memmove(dot + 2, dot, out + len - dot);
+		memcpy(dot, ".0", 2);
+		len += 2;
+	}
+	return len;
+}
+
+#define fp_gen(func_name, out_type, convert_func) \
 	static int func_name(struct pass_to_conv *context, out_type *result, const struct node_value *val) \
 	{ \
 		out_type conved; \
 		const char *value; \
+		int ret; \
 		switch (val->type) { \
 		case VAL_SCALE_INT: \
 			value = val->int_str; \
@@ -341,38 +1632,101 @@ unsigned_def(u64, uint64_t, UINT64_MAX)
 			context->msg = "wrong type, expect integer and float."; \
 			return -EINVAL; \
 		} \
-		errno = 0; \
-		conved = convert_func(value, NULL); \
-		if (errno) { \
+		ret = convert_func(&conved, value); \
+		if (ret) { \
 			context->node = val; \
 			context->msg = "overflow or underflow occurred."; \
-			return -errno; \
+			return ret; \
 		} else { \
 			*result = conved; \
 			return 0; \
 		} \
+	} \
+	\
+	/* batch version of func_name, see signed_def */ \
+	static int func_name##_array(struct pass_to_conv *context, out_type *result, \
+			const struct node_elems *elems, long n) \
+	{ \
+		const struct node_value *val; \
+		struct elems_iter iter; \
+		long i; \
+		int ret; \
+		elems_iter_init(&iter, elems); \
+		for (i = 0; i < n; ++i) { \
+			val = elems_iter_next(&iter); \
+			if (iter.same) { \
+				result[i] = result[i - 1]; \
+				continue; \
+			} \
+			if ((val->type != VAL_SCALE_INT && val->type != VAL_SCALE_FLOAT) || \
+					convert_func(&result[i], val->float_str)) { \
+				ret = func_name(context, &result[i], val); \
+				elems_iter_keep(&iter, context); \
+				return ret; \
+			} \
+		} \
+		return 0; \
 	}
 
-#define fp_dump(func_name, in_type, fmt) \
+#define fp_dump(func_name, in_type, to_str) \
 	static void func_name(put_func func, struct dump_context *ctx, const in_type *val) \
 	{ \
-		func(ctx, fmt, *val); \
+		char out[FP_STR_MAX]; \
+		func(ctx, "%.*s", to_str(out, *val), out); \
 	}
 
-fp_gen(parse_float, float, strtof)
-fp_dump(dump_float, float, "%f");
-fp_gen(parse_double, double, strtod)
-fp_dump(dump_double, double, "%f");
-fp_gen(parse_ldouble, long double, strtold)
-fp_dump(dump_ldouble, long double, "%Lf");
-static void free_float(float *net) {}
-static void free_double(double *ret) {}
-static void free_ldouble(long double *ret) {}
+#define fp_bdump(func_name, in_type, to_str) \
+	static void func_name(struct dump_buffer *buf, const in_type *val) \
+	{ \
+		char out[FP_STR_MAX]; \
+		dump_buffer_put(buf, out, to_str(out, *val)); \
+	}
 
-static int parse_string(struct pass_to_conv *context, const char **result,
-		const struct node_value *val)
+/*
+ * Values which compare equal hash the same: 0.0 and -0.0 are equal, and
+ * so are any two NaNs. long double is hashed through double.
+ */
+#define fp_compare(hash_name, equal_name, in_type) \
+	static uint64_t hash_name(const in_type *val) \
+	{ \
+		double d = *val; \
+		uint64_t bits; \
+		if (d == 0 || d != d) { \
+			return d == 0 ? 0 : 1; \
+		} \
+		memcpy(&bits, &d, sizeof(bits)); \
+		return bits; \
+	} \
+	\
+	static int equal_name(const in_type *a, const in_type *b) \
+	{ \
+		return *a == *b || (*a != *a && *b != *b); \
+	}
+
+fp_gen(parse_float, float, to_float)
+fp_dump(dump_float, float, float_to_str);
+fp_bdump(bdump_float, float, float_to_str);
+fp_compare(hash_float, equal_float, float)
+fp_gen(parse_double, double, to_double)
+fp_dump(dump_double, double, double_to_str);
+fp_bdump(bdump_double, double, double_to_str);
+fp_compare(hash_double, equal_double, double)
+fp_gen(parse_ldouble, long double, to_ldouble)
+fp_dump(dump_ldouble, long double, ldouble_to_str);
+fp_bdump(bdump_ldouble, long double, ldouble_to_str);
+fp_compare(hash_ldouble, equal_ldouble, long double)
+static void free_float(struct pass_to_conv *context, float *net) {}
+static void free_double(struct pass_to_conv *context, double *ret) {}
+static void free_ldouble(struct pass_to_conv *context, long double *ret) {}
+
+/*
+ * unescape the string of val into *result, a block of strlen(val) + 1
+ * bytes, and give the length of the result, which may contain '\0'
+ */
+static int unescape_string(struct pass_to_conv *context, char **result,
+		size_t *n_result, const struct node_value *val)
 {
-	size_t len;
+	size_t len, n;
 	int t;
 	char *malloced, *dst;
 	const char *src;
@@ -387,7 +1741,7 @@ static int parse_string(struct pass_to_conv *context, const char **result,
 		context->msg = "string is too long."; \
 		return -EFBIG;
 	}
-	malloced = malloc(len + 1);
+	malloced = conv_alloc(context, len + 1, 1);
 	if (!malloced) {
 		context->node = val; \
 		context->msg = "memory insufficient."; \
@@ -396,54 +1750,412 @@ static int parse_string(struct pass_to_conv *context, const char **result,
 	src = val->string_str;
 	dst = malloced;
 	while (*src) {
+		n = plain_len_parse(src, len - (src - val->string_str));
+		memcpy(dst, src, n);
+		dst += n;
+		src += n;
+		if (!*src) {
+			break;
+		}
 		t = unescape(dst, src);
 		if (t < 0) {
 			context->node = val; \
 			context->msg = "is not a valid string."; \
-			free(malloced);
+			conv_free(context, malloced, len + 1);
 			return t;
 		}
 		src += t;
 		++dst;
 	}
 	*dst = '\0';
+	*result = malloced;
+	*n_result = dst - malloced;
+	return 0;
+}
+
+/* shrink what unescape_string() gives to size bytes, escapes make it shorter */
+static int shrink_string(struct pass_to_conv *context, char **result,
+		size_t size, const struct node_value *val)
+{
+	size_t old_size = strlen(val->string_str) + 1;
+	char *p;
+	if (size == old_size) {
+		return 0;
+	}
+	p = conv_realloc(context, *result, old_size, size);
+	if (!p) {
+		context->node = val;
+		context->msg = "memory insufficient.";
+		conv_free(context, *result, old_size);
+		return -ENOMEM;
+	}
+	*result = p;
+	return 0;
+}
+
+static int parse_string(struct pass_to_conv *context, const char **result,
+		const struct node_value *val)
+{
+	size_t n;
+	char *malloced;
+	int ret;
+	ret = unescape_string(context, &malloced, &n, val);
+	if (ret) {
+		return ret;
+	}
+	/* free_string() gives strlen() + 1 */
+	ret = shrink_string(context, &malloced, strlen(malloced) + 1, val);
+	if (ret) {
+		return ret;
+	}
 	*result = (const char *)malloced;
 	return 0;
 }
 
-static void dump_string(put_func func, struct dump_context *ctx, const char * const*val)
+/* parse into buf of cap bytes, -ENOSPC if it does not fit with its '\0' */
+static int parse_string_bounded(struct pass_to_conv *context, char *buf,
+		size_t cap, const struct node_value *val)
 {
-	const char *c = *val;
+	size_t len, n;
+	int t;
+	char *dst, c;
+	const char *src;
+	if (val->type != VAL_SCALE_STRING) {
+		context->node = val;
+		context->msg = "wrong type, expect string.";
+		return -EINVAL;
+	}
+	len = strlen(val->string_str);
+	src = val->string_str;
+	dst = buf;
+	while (*src) {
+		n = plain_len_parse(src, len - (src - val->string_str));
+		if (n >= cap - (dst - buf)) {
+			goto nospc;
+		}
+		memcpy(dst, src, n);
+		dst += n;
+		src += n;
+		if (!*src) {
+			break;
+		}
+		t = unescape(&c, src);
+		if (t < 0) {
+			context->node = val;
+			context->msg = "is not a valid string.";
+			return t;
+		}
+		if (dst + 1 >= buf + cap) {
+			goto nospc;
+		}
+		*dst++ = c;
+		src += t;
+	}
+	*dst = '\0';
+	return 0;
+
+nospc:
+	context->node = val;
+	context->msg = "string is too long.";
+	return -ENOSPC;
+}
+
+static void string_dump(put_func func, struct dump_context *ctx,
+		const char *c, size_t len)
+{
+	size_t n;
 	func(ctx, "\"");
-	while (*c) {
+	while (len) {
+		n = plain_len_dump(c, len < INT_MAX ? len : INT_MAX);
+		if (n) {
+			func(ctx, "%.*s", (int)n, c);
+			c += n;
+			len -= n;
+			continue;
+		}
 		if (*c == '"' || *c == '\\') {
 			func(ctx, "\\%c", *c);
-		}else if (0x20 <= *c && *c <= 126) {
-			func(ctx, "%c", *c);
 		} else {
-			func(ctx, "x%hhx", (unsigned char)*c);
+			func(ctx, "\\x%02hhx", (unsigned char)*c);
 		}
 		++c;
+		--len;
 	}
 	func(ctx, "\"");
 }
 
+static void dump_string(put_func func, struct dump_context *ctx, const char * const*val)
+{
+	string_dump(func, ctx, *val, strlen(*val));
+}
+
+/* copy runs of plain characters at once, escape the rest */
+static void string_bdump(struct dump_buffer *buf, const char *c, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t n;
+	dump_buffer_putc(buf, '"');
+	while (len) {
+		n = plain_len_dump(c, len);
+		dump_buffer_put(buf, c, n);
+		c += n;
+		len -= n;
+		if (!len) {
+			break;
+		}
+		if (*c == '"' || *c == '\\') {
+			char out[2] = {'\\', *c};
+			dump_buffer_put(buf, out, 2);
+		} else {
+			char out[4] = {'\\', 'x', hex[(unsigned char)*c >> 4],
+				hex[*c & 0xf]};
+			dump_buffer_put(buf, out, 4);
+		}
+		++c;
+		--len;
+	}
+	dump_buffer_putc(buf, '"');
+}
+
+static void bdump_string(struct dump_buffer *buf, const char * const*val)
+{
+	string_bdump(buf, *val, strlen(*val));
+}
+
+static uint64_t hash_string(const char * const*val)
+{
+	return config_hash_bytes(CONFIG_HASH_BASIS, *val, strlen(*val));
+}
+
+static int equal_string(const char * const*a, const char * const*b)
+{
+	return *a == *b || !strcmp(*a, *b);
+}
+
 /*
  * Free corresponding resources
  */
-static void free_string(const char **val)
+static void free_string(struct pass_to_conv *context, const char **val)
 {
-	free((char *)(*val));
+	if (*val) {
+		conv_free(context, (char *)(*val), strlen(*val) + 1);
+	}
 	*val = NULL;
 }
 
+/*
+ * Move into a packed block
+ */
+static void pack_string(struct config_pack *p, const char **val)
+{
+	const char *s = config_pack_ptr(p, *val,
+			*val && !p->reloc ? strlen(*val) + 1 : 0, 1);
+	if (p->base) {
+		*val = s;
+	}
+}
+
+/*
+ * A string with its length, which may contain '\0'. ptr is followed by a
+ * '\0' too, so that it is a C string if it has none.
+ */
+static int parse_strview(struct pass_to_conv *context, const char **ptr,
+		size_t *len, const struct node_value *val)
+{
+	size_t n;
+	char *malloced;
+	int ret;
+	ret = unescape_string(context, &malloced, &n, val);
+	if (ret) {
+		return ret;
+	}
+	/* free_strview() gives len + 1 */
+	ret = shrink_string(context, &malloced, n + 1, val);
+	if (ret) {
+		return ret;
+	}
+	*ptr = (const char *)malloced;
+	*len = n;
+	return 0;
+}
+
+static void dump_strview(put_func func, struct dump_context *ctx,
+		const char * const*ptr, const size_t *len)
+{
+	string_dump(func, ctx, *ptr, *len);
+}
+
+static void bdump_strview(struct dump_buffer *buf, const char * const*ptr,
+		const size_t *len)
+{
+	string_bdump(buf, *ptr, *len);
+}
+
+static uint64_t hash_strview(const char * const*ptr, const size_t *len)
+{
+	return config_hash_bytes(CONFIG_HASH_BASIS, *ptr, *len);
+}
+
+static int equal_strview(const char * const*a, const size_t *a_len,
+		const char * const*b, const size_t *b_len)
+{
+	return *a_len == *b_len && (*a == *b || !memcmp(*a, *b, *a_len));
+}
+
+static void free_strview(struct pass_to_conv *context, const char **ptr,
+		size_t *len)
+{
+	if (*ptr) {
+		conv_free(context, (char *)(*ptr), *len + 1);
+	}
+	*ptr = NULL;
+	*len = 0;
+}
+
+static void pack_strview(struct config_pack *p, const char **ptr,
+		size_t *len)
+{
+	const char *s = config_pack_ptr(p, *ptr,
+			*ptr && !p->reloc ? *len + 1 : 0, 1);
+	if (p->base) {
+		*ptr = s;
+	}
+}
+
+
+/*
+ * Single-pass address scanners, accepting the same forms as inet_pton.
+ * Return the end of the address in s, or NULL if s does not start with
+ * one.
+ */
+static const char *scan_inet4(const char *s, struct in_addr *addr)
+{
+	uint8_t out[4];
+	unsigned v;
+	int i;
+
+	for (i = 0; i < 4; ++i) {
+		if (i && *s++ != '.') {
+			return NULL;
+		}
+		if (!is_digit(*s)) {
+			return NULL;
+		}
+		v = *s++ - '0';
+		if (is_digit(*s)) {
+			if (!v) {	/* no leading zeros */
+				return NULL;
+			}
+			v = v * 10 + (*s++ - '0');
+			if (is_digit(*s)) {
+				v = v * 10 + (*s++ - '0');
+				if (v > 255 || is_digit(*s)) {
+					return NULL;
+				}
+			}
+		}
+		out[i] = v;
+	}
+	memcpy(addr, out, 4);
+	return s;
+}
+
+static const char *scan_inet6(const char *s, struct in6_addr *addr)
+{
+	uint8_t out[16];
+	struct in_addr ip4;
+	const char *group;
+	int n = 0, gap = -1, digits, x;
+	unsigned v;
+
+	if (s[0] == ':') {
+		if (s[1] != ':') {
+			return NULL;
+		}
+		gap = 0;
+		s += 2;
+	}
+	for (;;) {
+		group = s;
+		for (v = 0, digits = 0; (x = xdigit_to_int(*s)) >= 0; ++s) {
+			if (++digits > 4) {
+				return NULL;
+			}
+			v = v << 4 | x;
+		}
+		if (!digits) {	/* only allowed at the end, after "::" */
+			if (gap != n) {
+				return NULL;
+			}
+			break;
+		}
+		if (*s == '.') {	/* embedded ipv4 */
+			if (n > 12 || !(s = scan_inet4(group, &ip4))) {
+				return NULL;
+			}
+			memcpy(out + n, &ip4, 4);
+			n += 4;
+			break;
+		}
+		if (n == 16) {
+			return NULL;
+		}
+		out[n++] = v >> 8;
+		out[n++] = v;
+		if (*s != ':') {
+			break;
+		}
+		if (s[1] == ':') {
+			if (gap >= 0) {
+				return NULL;
+			}
+			gap = n;
+			s += 2;
+		} else {
+			++s;
+		}
+	}
+	if (gap >= 0) {
+		if (n == 16) {
+			return NULL;
+		}
+		memmove(out + 16 - (n - gap), out + gap, n - gap);
+		memset(out + gap, 0, 16 - n);
+	} else if (n != 16) {
+		return NULL;
+	}
+	memcpy(addr, out, 16);
+	return s;
+}
+
+/* "/prefix" of at most digits decimal digits, not above max */
+static const char *scan_prefix(const char *s, int digits, int max, int *prefix)
+{
+	int v = 0, i;
+
+	if (*s++ != '/' || !is_digit(*s)) {
+		return NULL;
+	}
+	for (i = 0; i < digits && is_digit(*s); ++i, ++s) {
+		v = v * 10 + (*s - '0');
+	}
+	if (is_digit(*s) || v > max) {
+		return NULL;
+	}
+	*prefix = v;
+	return s;
+}
 
 static int parse_inet4(struct pass_to_conv *context, struct in_addr *result,
 		const struct node_value *val)
 {
+	struct in_addr my_ip;
+	const char *end;
 	switch (val->type) {
 	case VAL_SCALE_STRING:
-		if (inet_pton(AF_INET, val->string_str, result)) {
+		end = scan_inet4(val->string_str, &my_ip);
+		if (end && !*end) {
+			*result = my_ip;
 			return 0;
 		} else {
 			context->node = val; \
@@ -460,19 +2172,35 @@ static int parse_inet4(struct pass_to_conv *context, struct in_addr *result,
 static void dump_inet4(put_func func, struct dump_context *ctx, const struct in_addr *val)
 {
 	char addr_str[IP4_ADDR_MAX + 1];
-	if (!inet_ntop(AF_INET, val, addr_str, IP4_ADDR_MAX)) {
+	if (!inet_ntop(AF_INET, val, addr_str, sizeof(addr_str))) {
 		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
 		return;
 	}
 	func(ctx, "\"%s\"", addr_str);
 }
 
-static int pasrse_inet6(struct pass_to_conv *context, struct in6_addr *result,
+static void bdump_inet4(struct dump_buffer *buf, const struct in_addr *val)
+{
+	char addr_str[IP4_ADDR_MAX + 1];
+	if (!inet_ntop(AF_INET, val, addr_str, sizeof(addr_str))) {
+		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
+		return;
+	}
+	dump_buffer_putc(buf, '"');
+	dump_buffer_put(buf, addr_str, strlen(addr_str));
+	dump_buffer_putc(buf, '"');
+}
+
+static int parse_inet6(struct pass_to_conv *context, struct in6_addr *result,
 		const struct node_value *val)
 {
+	struct in6_addr my_ip;
+	const char *end;
 	switch (val->type) {
 	case VAL_SCALE_STRING:
-		if (inet_pton(AF_INET6, val->string_str, result)) {
+		end = scan_inet6(val->string_str, &my_ip);
+		if (end && !*end) {
+			*result = my_ip;
 			return 0;
 		} else {
 			context->node = val; \
@@ -489,57 +2217,46 @@ static int pasrse_inet6(struct pass_to_conv *context, struct in6_addr *result,
 static void dump_inet6(put_func func, struct dump_context *ctx, const struct in6_addr *val)
 {
 	char addr_str[IP6_ADDR_MAX + 1];
-	if (!inet_ntop(AF_INET6, val, addr_str, IP6_ADDR_MAX)) {
+	if (!inet_ntop(AF_INET6, val, addr_str, sizeof(addr_str))) {
 		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
 		return;
 	}
 	func(ctx, "\"%s\"", addr_str);
 }
 
+static void bdump_inet6(struct dump_buffer *buf, const struct in6_addr *val)
+{
+	char addr_str[IP6_ADDR_MAX + 1];
+	if (!inet_ntop(AF_INET6, val, addr_str, sizeof(addr_str))) {
+		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
+		return;
+	}
+	dump_buffer_putc(buf, '"');
+	dump_buffer_put(buf, addr_str, strlen(addr_str));
+	dump_buffer_putc(buf, '"');
+}
+
 static int parse_inet4wp(struct pass_to_conv *context, struct in_addr *ip,
 		int *prefix, const struct node_value *val)
 {
-	char *slash;
-	char addr_str[IP4_ADDR_MAX + 1];
-	char prefix_str[IP4_PRE_MAX + 1], *prefix_end;
-	long my_prefix;
+	const char *end;
+	int my_prefix;
 	struct in_addr my_ip;
 	if (val->type != VAL_SCALE_STRING) {
 		context->node = val;
-		context->msg = "wrong type, expect string (in inet4 with prefix)."; 
-		return -EINVAL;
-	}
-
-	slash = strstr(val->string_str, "/");
-	if (!slash) {
-		context->node = val;
-		context->msg = "missing slash.";
+		context->msg = "wrong type, expect string (in inet4 with prefix).";
 		return -EINVAL;
 	}
 
-	if (slash - val->string_str > IP4_ADDR_MAX) {
+	end = scan_inet4(val->string_str, &my_ip);
+	if (!end || *end != '/') {
 		context->node = val;
-		context->msg = "address part is invalid.";
+		context->msg = strchr(val->string_str, '/') ?
+			"addr part is invalid." : "missing slash.";
 		return -EINVAL;
 	}
-	memcpy(addr_str, val->string_str, slash - val->string_str);
-	addr_str[slash - val->string_str] = '\0';
-	++slash;
-	if (strlen(slash) > IP4_PRE_MAX) {
-		context->node = val;
-		context->msg = "prefix part is invalid.";
-		return -EINVAL;
-	}
-	strcpy(prefix_str, slash);
-	
-	if (!inet_pton(AF_INET, addr_str, &my_ip)) {
-		context->node = val;
-		context->msg = "addr part is invalid.";
-		return -EINVAL;
-	}
-	errno = 0;
-	my_prefix = strtol(prefix_str, &prefix_end, 10);
-	if (my_prefix < 0 || my_prefix > 32 || *prefix_end) {
+	end = scan_prefix(end, IP4_PRE_MAX, 32, &my_prefix);
+	if (!end || *end) {
 		context->node = val;
 		context->msg = "prefix part is invalid.";
 		return -EINVAL;
@@ -552,57 +2269,48 @@ static int parse_inet4wp(struct pass_to_conv *context, struct in_addr *ip,
 static void dump_inet4wp(put_func func, struct dump_context *ctx, const struct in_addr *val, const int *prefix)
 {
 	char addr_str[IP4_ADDR_MAX + 1];
-	if (!inet_ntop(AF_INET, val, addr_str, IP4_ADDR_MAX)) {
+	if (!inet_ntop(AF_INET, val, addr_str, sizeof(addr_str))) {
 		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
 		return;
 	}
 	func(ctx, "\"%s/%d\"", addr_str, *prefix);
 }
 
+static void bdump_inet4wp(struct dump_buffer *buf, const struct in_addr *val, const int *prefix)
+{
+	char addr_str[IP4_ADDR_MAX + 1];
+	if (!inet_ntop(AF_INET, val, addr_str, sizeof(addr_str))) {
+		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
+		return;
+	}
+	dump_buffer_putc(buf, '"');
+	dump_buffer_put(buf, addr_str, strlen(addr_str));
+	dump_buffer_putc(buf, '/');
+	dump_buffer_put_ll(buf, *prefix);
+	dump_buffer_putc(buf, '"');
+}
+
 static int parse_inet6wp(struct pass_to_conv *context, struct in6_addr *ip,
 		int *prefix, const struct node_value *val)
 {
-	char *slash;
-	char addr_str[IP6_ADDR_MAX + 1];
-	char prefix_str[IP6_PRE_MAX + 1], *prefix_end;
-	long my_prefix;
+	const char *end;
+	int my_prefix;
 	struct in6_addr my_ip;
 	if (val->type != VAL_SCALE_STRING) {
-		context->node = val; \
-		context->msg = "wrong type, expect string (in inet6 with prefix)."; \
-		return -EINVAL;
-	}
-
-	slash = strstr(val->string_str, "/");
-	if (!slash) {
 		context->node = val;
-		context->msg = "missing slash.";
+		context->msg = "wrong type, expect string (in inet6 with prefix).";
 		return -EINVAL;
 	}
 
-	if (slash - val->string_str > IP6_ADDR_MAX) {
-		context->node = val;
-		context->msg = "address part is invalid.";
-		return -EINVAL;
-	}
-	memcpy(addr_str, val->string_str, slash - val->string_str);
-	addr_str[slash - val->string_str] = '\0';
-	++slash;
-	if (strlen(slash) > IP6_PRE_MAX) {
-		context->node = val;
-		context->msg = "prefix part is invalid.";
-		return -EINVAL;
-	}
-	strcpy(prefix_str, slash);
-	
-	if (!inet_pton(AF_INET6, addr_str, &my_ip)) {
+	end = scan_inet6(val->string_str, &my_ip);
+	if (!end || *end != '/') {
 		context->node = val;
-		context->msg = "addr part is invalid.";
+		context->msg = strchr(val->string_str, '/') ?
+			"addr part is invalid." : "missing slash.";
 		return -EINVAL;
 	}
-	errno = 0;
-	my_prefix = strtol(prefix_str, &prefix_end, 10);
-	if (my_prefix < 0 || my_prefix > 128 || *prefix_end) {
+	end = scan_prefix(end, IP6_PRE_MAX, 128, &my_prefix);
+	if (!end || *end) {
 		context->node = val;
 		context->msg = "prefix part is invalid.";
 		return -EINVAL;
@@ -615,37 +2323,109 @@ static int parse_inet6wp(struct pass_to_conv *context, struct in6_addr *ip,
 static void dump_inet6wp(put_func func, struct dump_context *ctx, const struct in6_addr *val, const int *prefix)
 {
 	char addr_str[IP6_ADDR_MAX + 1];
-	if (!inet_ntop(AF_INET6, val, addr_str, IP6_ADDR_MAX)) {
+	if (!inet_ntop(AF_INET6, val, addr_str, sizeof(addr_str))) {
 		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
 		return;
 	}
 	func(ctx, "\"%s/%d\"", addr_str, *prefix);
 }
 
-static void free_inet4(struct in_addr *net) {}
-static void free_inet6(struct in6_addr *net) {}
-static void free_inet4wp(struct in_addr *net, int *val) {}
-static void free_inet6wp(struct in6_addr *net, int *val) {}
+static void bdump_inet6wp(struct dump_buffer *buf, const struct in6_addr *val, const int *prefix)
+{
+	char addr_str[IP6_ADDR_MAX + 1];
+	if (!inet_ntop(AF_INET6, val, addr_str, sizeof(addr_str))) {
+		fprintf(stderr, "%s: buffer length requirement estimation error.\n", __func__);
+		return;
+	}
+	dump_buffer_putc(buf, '"');
+	dump_buffer_put(buf, addr_str, strlen(addr_str));
+	dump_buffer_putc(buf, '/');
+	dump_buffer_put_ll(buf, *prefix);
+	dump_buffer_putc(buf, '"');
+}
+
+static uint64_t hash_inet4(const struct in_addr *val)
+{
+	return val->s_addr;
+}
+
+static int equal_inet4(const struct in_addr *a, const struct in_addr *b)
+{
+	return a->s_addr == b->s_addr;
+}
+
+static uint64_t hash_inet6(const struct in6_addr *val)
+{
+	return config_hash_bytes(CONFIG_HASH_BASIS, val, sizeof(*val));
+}
+
+static int equal_inet6(const struct in6_addr *a, const struct in6_addr *b)
+{
+	return !memcmp(a, b, sizeof(*a));
+}
+
+static uint64_t hash_inet4wp(const struct in_addr *val, const int *prefix)
+{
+	return config_hash_mix(hash_inet4(val), *prefix);
+}
+
+static int equal_inet4wp(const struct in_addr *a, const int *a_prefix,
+		const struct in_addr *b, const int *b_prefix)
+{
+	return equal_inet4(a, b) && *a_prefix == *b_prefix;
+}
+
+static uint64_t hash_inet6wp(const struct in6_addr *val, const int *prefix)
+{
+	return config_hash_mix(hash_inet6(val), *prefix);
+}
 
+static int equal_inet6wp(const struct in6_addr *a, const int *a_prefix,
+		const struct in6_addr *b, const int *b_prefix)
+{
+	return equal_inet6(a, b) && *a_prefix == *b_prefix;
+}
+
+static void free_inet4(struct pass_to_conv *context, struct in_addr *net) {}
+static void free_inet6(struct pass_to_conv *context, struct in6_addr *net) {}
+static void free_inet4wp(struct pass_to_conv *context,
+		struct in_addr *net, int *val) {}
+static void free_inet6wp(struct pass_to_conv *context,
+		struct in6_addr *net, int *val) {}
+
+/* six groups of one or two hex digits, separated by all ':' or all '-' */
 static int parse_eth_mac(struct pass_to_conv *context, struct eth_mac *mac, const struct node_value *val)
 {
-	int i;
-	char t;
+	struct eth_mac my_mac;
+	const char *s;
+	char sep = 0;
+	int i, x;
 	if (val->type != VAL_SCALE_STRING) {
 		context->node = val;
 		context->msg = "wrong type, expect string (in mac address)."; \
 		return -EINVAL;
 	}
-	i = sscanf(val->string_str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx%c",
-			&mac->a[0], &mac->a[1], &mac->a[2], &mac->a[3],
-			&mac->a[4], &mac->a[5], &t);
-	if (i == 6) {
-		return 0;
+	s = val->string_str;
+	for (i = 0; i < 6; ++i) {
+		if (i) {
+			if (!sep && (*s == ':' || *s == '-')) {
+				sep = *s;
+			}
+			if (!sep || *s++ != sep) {
+				break;
+			}
+		}
+		if ((x = xdigit_to_int(*s)) < 0) {
+			break;
+		}
+		my_mac.a[i] = x;
+		if ((x = xdigit_to_int(*++s)) >= 0) {
+			my_mac.a[i] = my_mac.a[i] << 4 | x;
+			++s;
+		}
 	}
-	i = sscanf(val->string_str, "%hhx-%hhx-%hhx-%hhx-%hhx-%hhx%c",
-			&mac->a[0], &mac->a[1], &mac->a[2], &mac->a[3],
-			&mac->a[4], &mac->a[5], &t);
-	if (i == 6) {
+	if (i == 6 && !*s) {
+		*mac = my_mac;
 		return 0;
 	}
 	context->node = val;
@@ -659,5 +2439,30 @@ static int dump_eth_mac(put_func func, struct dump_context *ctx, const struct et
 			val->a[0], val->a[1], val->a[2], val->a[3], val->a[4], val->a[5]);
 }
 
-static int free_eth_mac(struct eth_mac *val) {}
+static void bdump_eth_mac(struct dump_buffer *buf, const struct eth_mac *val)
+{
+	static const char hex[] = "0123456789abcdef";
+	char out[19];
+	int i;
+	out[0] = '"';
+	for (i = 0; i < 6; ++i) {
+		out[i * 3 + 1] = hex[val->a[i] >> 4];
+		out[i * 3 + 2] = hex[val->a[i] & 0xf];
+		out[i * 3 + 3] = ':';
+	}
+	out[18] = '"';
+	dump_buffer_put(buf, out, 19);
+}
+
+static uint64_t hash_eth_mac(const struct eth_mac *val)
+{
+	return config_hash_bytes(CONFIG_HASH_BASIS, val->a, sizeof(val->a));
+}
+
+static int equal_eth_mac(const struct eth_mac *a, const struct eth_mac *b)
+{
+	return !memcmp(a->a, b->a, sizeof(a->a));
+}
+
+static int free_eth_mac(struct pass_to_conv *context, struct eth_mac *val) {}
 
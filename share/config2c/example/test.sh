@@ -0,0 +1,9 @@
+#!/bin/sh
+
+./make.sh || exit 1
+cd make
+
+for test in test_parse test_prims test_rcu ; do
+	echo "${test}"
+	./"${test}" || exit 1
+done
@@ -0,0 +1,1086 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "demo_0-converter.h"
+#include "parser.h"
+
+static int failed;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failed++; \
+	} \
+} while (0)
+
+static const char *write_file(const char *path, const char *text)
+{
+	FILE *fp = fopen(path, "w");
+	if (!fp) {
+		perror(path);
+		exit(1);
+	}
+	fputs(text, fp);
+	fclose(fp);
+	return path;
+}
+
+static int same_msg(const char *a, const char *b)
+{
+	return a && b ? !strcmp(a, b) : a == b;
+}
+
+/* a s_foo with a float array large enough to be parsed in chunks */
+static char *big_s_foo(const char *sep, int bad, const char *bad_elem)
+{
+	size_t size = 1 << 20, len;
+	char *buf = malloc(size);
+	int i;
+
+	len = sprintf(buf, "{ .s_foo_s = [ \"a\", \"b\", \"c\", \"d\", \"e\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [],\n.s_foo_f = [\n");
+	for (i = 0; i < 20000; ++i) {
+		if (i == bad) {
+			len += sprintf(buf + len, "%s,%s", bad_elem, sep);
+		} else {
+			len += sprintf(buf + len, "%d.5,%s", i, sep);
+		}
+	}
+	sprintf(buf + len, "],\n}\n");
+	return buf;
+}
+
+static void test_parallel_error_location(void)
+{
+	static const struct {
+		const char *sep;
+		int bad;
+		const char *elem;
+	} cases[] = {
+		{ "\n", 15000, "$" },
+		{ "\n", 15000, "  $" },
+		{ "\n  ", 12345, "$" },
+		{ " ", 15000, "$" },
+		{ " ", 19999, "1.5 2" },
+		{ "\n", 1, "{ ]" },
+		{ "\n", 9999, "include \"no-such-file\"" },
+	};
+	struct s_foo a, b;
+	const char *e1, *e2;
+	char *text;
+	int i, r1, r2;
+
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		text = big_s_foo(cases[i].sep, cases[i].bad, cases[i].elem);
+		write_file("big.conf", text);
+		free(text);
+		e1 = e2 = NULL;
+		r1 = config_parse_s_foo(&a, "big.conf", &e1);
+		r2 = config_parse_parallel_s_foo(&b, "big.conf", 4, &e2);
+		CHECK(r1 && r1 == r2 && same_msg(e1, e2),
+				"case %d: serial %d \"%s\", parallel %d \"%s\"",
+				i, r1, e1, r2, e2);
+		if (!r1) {
+			config_free_s_foo(&a);
+		}
+		if (!r2) {
+			config_free_s_foo(&b);
+		}
+		free((char *)e1);
+		free((char *)e2);
+	}
+	remove("big.conf");
+}
+
+static void test_range_without_spaces(void)
+{
+	static const float expect[] = { 0, 1, 2, 3, 5, 4, -1, 0, 8, 9, 7, };
+	struct s_foo value;
+	const char *err_msg = NULL;
+	int i, ret;
+
+	write_file("range.conf", "{ .s_foo_s = [ \"a\", \"b\", \"c\", \"d\", \"e\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [],\n"
+			".s_foo_f = [ 0...3, 5...4, -1...0, 010...011, 7, ],\n}\n");
+	ret = config_parse_s_foo(&value, "range.conf", &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	if (!ret) {
+		CHECK(value.s_foo_f_len == sizeof(expect) / sizeof(expect[0]),
+				"%ld elements", value.s_foo_f_len);
+		for (i = 0; i < value.s_foo_f_len &&
+				i < (int)(sizeof(expect) / sizeof(expect[0])); ++i) {
+			CHECK(value.s_foo_f[i] == expect[i], "[%d] = %f", i,
+					value.s_foo_f[i]);
+		}
+		config_free_s_foo(&value);
+	}
+	free((char *)err_msg);
+	remove("range.conf");
+}
+
+/* the node of a range element lives in the iterator, the error outlives it */
+static void test_range_error(void)
+{
+	struct cfg value;
+	const char *err_msg = NULL;
+	int ret;
+
+	write_file("range.conf", "{ .foo = { .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", \"5\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [], .s_foo_f = [], },\n"
+			".bar = { .s_foo = 5, .s_bar = [ \"1\", \"2\", \"3\", ],\n"
+			".s_enum = [ E_FOO_FOO, 7...9, ], .s_str = [],\n"
+			".s_u = { .i = 1, }, .s_u_v = [], },\n"
+			".baz = [], .f = 5, .addr = \"01:02:03:04:05:06\", }\n");
+	ret = config_parse_cfg(&value, "range.conf", &err_msg);
+	CHECK(ret == -EINVAL && err_msg && !strcmp(err_msg,
+			".bar.s_enum.[1]: invalid type, expecting enum."),
+			"%d %s", ret, err_msg);
+	if (!ret) {
+		config_free_cfg(&value);
+	}
+	free((char *)err_msg);
+	remove("range.conf");
+}
+
+static char *dump_cfg(const struct cfg *value)
+{
+	struct dump_buffer buf;
+
+	dump_buffer_init(&buf, NULL, 0, DUMP_BUFFER_GROW);
+	if (config_dump_cfg_to_buffer(&buf, value)) {
+		free(buf.data);
+		return NULL;
+	}
+	return buf.data;
+}
+
+/* a cfg with a .baz array large enough to be parsed in chunks */
+static char *big_cfg(int anchors)
+{
+	size_t size = 1 << 20, len;
+	char *buf = malloc(size);
+	int i;
+
+	len = sprintf(buf, "{ .foo = { .s_foo_s = [ \"1\", \"2\", \"3\", "
+			"\"4\", \"5\", ],\n.ip6p = \"::1/120\", .ip4p = [], "
+			".s_foo_f = [], },\n.bar = { .bar = \"x\", },\n"
+			".baz = [\n%s", anchors ? "&u { .k = [ 1, 2, ], },\n" : "");
+	for (i = 0; i < 20000; ++i) {
+		if (anchors && i % 7 == 0) {
+			len += sprintf(buf + len, "*u,\n");
+		} else {
+			len += sprintf(buf + len, "{ .i = %d, },\n", i);
+		}
+	}
+	sprintf(buf + len, "],\n.f = 5, .addr = \"01:02:03:04:05:06\", }\n");
+	return buf;
+}
+
+/* anchors are not seen across chunks, such a file is parsed serially */
+static void test_parallel_same_result(void)
+{
+	struct cfg a, b;
+	const char *e1, *e2;
+	char *text, *d1, *d2;
+	int anchors, r1, r2;
+
+	for (anchors = 0; anchors < 2; ++anchors) {
+		text = big_cfg(anchors);
+		write_file("big.conf", text);
+		free(text);
+		e1 = e2 = NULL;
+		r1 = config_parse_cfg(&a, "big.conf", &e1);
+		r2 = config_parse_parallel_cfg(&b, "big.conf", 4, &e2);
+		CHECK(!r1 && !r2, "anchors %d: serial %d \"%s\", parallel %d \"%s\"",
+				anchors, r1, e1, r2, e2);
+		if (!r1 && !r2) {
+			d1 = dump_cfg(&a);
+			d2 = dump_cfg(&b);
+			CHECK(b.baz_len == 20000 + anchors && same_msg(d1, d2),
+					"anchors %d: %ld elements, dumps differ",
+					anchors, b.baz_len);
+			free(d1);
+			free(d2);
+		}
+		if (!r1) {
+			config_free_cfg(&a);
+		}
+		if (!r2) {
+			config_free_cfg(&b);
+		}
+		free((char *)e1);
+		free((char *)e2);
+	}
+	remove("big.conf");
+}
+
+/*
+ * merging layers must not reparent the nodes of a cached include, a later
+ * parse of the include with the cache would follow a freed parent
+ */
+static void test_layered_then_cached(void)
+{
+	static const char *const layers[] = { "layer1.conf", "layer2.conf" };
+	struct parse_cache *cache = parse_cache_new();
+	struct pass_to_bison opaque;
+	struct mem_pool pool;
+	struct s_foo value;
+	const char *err_msg = NULL;
+	int ret;
+
+	write_file("inc.conf", "{ .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", \"5\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [], .s_foo_f = [ \"x\", ], }\n");
+	write_file("layer1.conf", "include \"inc.conf\"\n");
+	write_file("layer2.conf", "{ .s_foo_i = 2, }\n");
+	write_file("user.conf", "include \"inc.conf\"\n");
+
+	mem_pool_init(&pool);
+	init_pass_to_bison(&opaque, &pool);
+	opaque.cache = cache;
+	ret = yacc_parse_layers(layers, 2, &err_msg, &opaque);
+	CHECK(!ret, "%s", err_msg);
+	free((char *)err_msg);
+	err_msg = NULL;
+	mem_pool_destroy(&pool);
+
+	ret = config_parse_cached_s_foo(&value, "user.conf", cache, &err_msg);
+	CHECK(ret == -EINVAL && err_msg && strstr(err_msg,
+			"wrong type, expect integer and float."), "%d %s",
+			ret, err_msg);
+	if (!ret) {
+		config_free_s_foo(&value);
+	}
+	free((char *)err_msg);
+	parse_cache_free(cache);
+	remove("inc.conf");
+	remove("layer1.conf");
+	remove("layer2.conf");
+	remove("user.conf");
+}
+
+/* a cached file is parsed again when a file it includes changes */
+static void test_cache_dependency(void)
+{
+	struct parse_cache *cache = parse_cache_new();
+	struct cfg value;
+	const char *err_msg = NULL;
+	int ret, i;
+
+	write_file("dep-f.conf", "[ 1.5, ]\n");
+	write_file("dep-foo.conf", "{ .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", "
+			"\"5\", ],\n.ip6p = \"::1/120\", .ip4p = [],\n"
+			".s_foo_f = include \"dep-f.conf\", }\n");
+	write_file("dep.conf", "{ .foo = include \"dep-foo.conf\",\n"
+			".bar = { .bar = \"x\", }, .baz = [], .f = 1,\n"
+			".addr = \"01:02:03:04:05:06\", }\n");
+	for (i = 0; i < 3; ++i) {
+		if (i == 2) {
+			write_file("dep-f.conf", "[ 2.5, 3.5, ]\n");
+		}
+		ret = config_parse_cached_cfg(&value, "dep.conf", cache,
+				&err_msg);
+		CHECK(!ret, "%d %s", ret, err_msg);
+		if (ret) {
+			free((char *)err_msg);
+			err_msg = NULL;
+			continue;
+		}
+		if (i < 2) {
+			CHECK(value.foo.s_foo_f_len == 1 &&
+					value.foo.s_foo_f[0] == 1.5f,
+					"parse %d: %ld", i, value.foo.s_foo_f_len);
+		} else {
+			CHECK(value.foo.s_foo_f_len == 2 &&
+					value.foo.s_foo_f[0] == 2.5f &&
+					value.foo.s_foo_f[1] == 3.5f,
+					"parse %d: %ld", i, value.foo.s_foo_f_len);
+		}
+		config_free_cfg(&value);
+	}
+	parse_cache_free(cache);
+	remove("dep-f.conf");
+	remove("dep-foo.conf");
+	remove("dep.conf");
+}
+
+#define BASE_CFG "{ .foo = { .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", \"5\", ],\n" \
+		".ip6p = \"::1/120\", .ip4p = [], .s_foo_f = [], },\n" \
+		".bar = { .bar = \"x\", }, .baz = [], .f = 5,\n" \
+		".addr = \"01:02:03:04:05:06\", %s}\n"
+
+static void test_layers(void)
+{
+	static const char *const layers[] = { "layer1.conf", "layer2.conf" };
+	static const struct {
+		const char *lower, *upper, *msg;
+	} cases[] = {
+		{ "", "{ .foo = { .s_foo_i = 7, }, .f = 9, }", NULL },
+		{ "", "{ .foo = { .s_foo_i = 7, .s_foo_i = 8, }, }",
+			".foo.s_foo_i: member is already defined." },
+		{ ".addr = \"01:02:03:04:05:07\",",
+			"{ .addr = \"01:02:03:04:05:08\", }",
+			".addr: member is already defined." },
+		{ "", "{ .g = [ 1, 2, ], }",
+			".f: union is inited with another type in another layer." },
+		{ "", "{ .bar = { .e_net = [ \"1.2.3.4\", ], }, }",
+			".bar.bar: union is inited with another type in another layer." },
+	};
+	char text[1024];
+	struct cfg value;
+	const char *err_msg;
+	int i, ret;
+
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		snprintf(text, sizeof(text), BASE_CFG, cases[i].lower);
+		write_file("layer1.conf", text);
+		write_file("layer2.conf", cases[i].upper);
+		err_msg = NULL;
+		ret = config_parse_layered_cfg(&value, layers, 2, &err_msg);
+		if (!cases[i].msg) {
+			CHECK(!ret, "case %d: %s", i, err_msg);
+		} else {
+			CHECK(ret == -EINVAL && same_msg(err_msg, cases[i].msg),
+					"case %d: %d %s", i, ret, err_msg);
+		}
+		if (!ret) {
+			CHECK(value.foo.s_foo_i == 7 && value.u_a_type == CFG_A_I &&
+					value.f == 9 && !strcmp(value.foo.s_foo_s[4], "5"),
+					"case %d: wrong value", i);
+			config_free_cfg(&value);
+		}
+		free((char *)err_msg);
+	}
+	remove("layer1.conf");
+	remove("layer2.conf");
+}
+
+/* members given by a fragment are replaced, the others are left alone */
+static void test_apply(void)
+{
+	struct cfg value;
+	const char *err_msg = NULL;
+	char text[1024];
+	int ret;
+
+	snprintf(text, sizeof(text), BASE_CFG, "");
+	write_file("apply.conf", text);
+	ret = config_parse_cfg(&value, "apply.conf", &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	remove("apply.conf");
+	if (ret) {
+		free((char *)err_msg);
+		return;
+	}
+
+	ret = config_apply_cfg(&value, ".foo.s_foo_i = 7, .foo.ip6p = "
+			"\"::2/64\", .baz = [ { .i = 9, }, ], .g = [ 1, 2, ]",
+			&err_msg);
+	CHECK(!ret, "%s", err_msg);
+	CHECK(value.foo.s_foo_i == 7 && value.foo.prefix6 == 64 &&
+			value.foo.ip6.s6_addr[15] == 2 &&
+			!strcmp(value.foo.s_foo_s[4], "5") &&
+			value.baz_len == 1 && value.baz_type[0] == S_V_I &&
+			value.baz[0].i == 9 && value.u_a_type == CFG_A_F &&
+			value.g[1] == 2 && value.addr.a[5] == 6,
+			"wrong value after apply");
+
+	/* the members before the failing one stay updated */
+	ret = config_apply_cfg(&value, ".addr = \"0a:0b:0c:0d:0e:0f\",\n"
+			".foo.s_foo_i = \"x\",", &err_msg);
+	CHECK(ret == -EINVAL && err_msg && !strncmp(err_msg,
+			".foo.s_foo_i: ", 14), "%d %s", ret, err_msg);
+	CHECK(value.addr.a[0] == 0x0a && value.foo.s_foo_i == 7,
+			"wrong value after a failed apply");
+	free((char *)err_msg);
+	config_free_cfg(&value);
+}
+
+static int apply_cfg(struct cfg *value, const char *fragment)
+{
+	const char *err_msg = NULL;
+	int ret;
+
+	ret = config_apply_cfg(value, fragment, &err_msg);
+	CHECK(!ret, "%s: %s", fragment, err_msg);
+	free((char *)err_msg);
+	return ret;
+}
+
+/* BASE_CFG updated by fragment */
+static int parse_base(struct cfg *value, const char *fragment)
+{
+	const char *err_msg = NULL;
+	char text[1024];
+	int ret;
+
+	snprintf(text, sizeof(text), BASE_CFG, "");
+	write_file("base.conf", text);
+	ret = config_parse_cfg(value, "base.conf", &err_msg);
+	remove("base.conf");
+	CHECK(!ret, "%s", err_msg);
+	free((char *)err_msg);
+	if (!ret && apply_cfg(value, fragment)) {
+		config_free_cfg(value);
+		ret = -EINVAL;
+	}
+	return ret;
+}
+
+/* appends path to the diff in arg */
+static void add_path(const char *path, void *arg)
+{
+	char *diff = arg;
+
+	strcat(diff, path);
+	strcat(diff, " ");
+}
+
+/* the diff reports changed members only, with or without the trees */
+static void test_compare(void)
+{
+	struct config_hash ta = CONFIG_HASH_INITIALIZER;
+	struct config_hash tb = CONFIG_HASH_INITIALIZER;
+	struct cfg a, b;
+	char diff[256];
+	int n;
+
+	if (parse_base(&a, ".baz = [ { .i = 1, }, { .j = 2, }, "
+				"{ .k = [ 1, 2, ], }, ]")) {
+		return;
+	}
+	if (parse_base(&b, ".baz = [ { .i = 1, }, { .j = 2, }, "
+				"{ .k = [ 1, 2, ], }, ]")) {
+		config_free_cfg(&a);
+		return;
+	}
+	CHECK(config_hash_cfg(&a, &ta) == config_hash_cfg(&b, &tb) &&
+			!ta.err && !tb.err, "hashes of equal values differ");
+	CHECK(config_equal_cfg(&a, &b), "equal values are not equal");
+	diff[0] = '\0';
+	n = config_diff_cfg(&a, &ta, &b, &tb, add_path, diff);
+	CHECK(n == 0 && !diff[0], "%d %s", n, diff);
+
+	apply_cfg(&b, ".foo.s_foo_i = 7, .baz = [ { .i = 1, }, { .j = 3, }, "
+			"{ .k = [ 1, 2, ], }, ], .name = \"de\\x00mo\"");
+	CHECK(config_hash_cfg(&a, NULL) != config_hash_cfg(&b, &tb) &&
+			!config_equal_cfg(&a, &b), "changed values are equal");
+	diff[0] = '\0';
+	n = config_diff_cfg(&a, &ta, &b, &tb, add_path, diff);
+	CHECK(n == 3 && !strcmp(diff, ".foo.s_foo_i .baz[1].j .name "),
+			"%d %s", n, diff);
+	diff[0] = '\0';
+	n = config_diff_cfg(&a, NULL, &b, NULL, add_path, diff);
+	CHECK(n == 3 && !strcmp(diff, ".foo.s_foo_i .baz[1].j .name "),
+			"without trees: %d %s", n, diff);
+
+	/* a union with another member selected is reported as a whole */
+	apply_cfg(&b, ".baz = [ { .i = 1, }, { .i = 2, }, "
+			"{ .k = [ 1, 2, ], }, ], .foo.s_foo_i = 1");
+	apply_cfg(&b, ".name = \"demo\\x00\", .g = [ 1, 2, ]");
+	diff[0] = '\0';
+	n = config_diff_cfg(&a, &ta, &b, NULL, add_path, diff);
+	CHECK(n == 3 && !strcmp(diff, ".baz[1] .f .g "), "%d %s", n, diff);
+
+	config_hash_free(&ta);
+	config_hash_free(&tb);
+	config_free_cfg(&a);
+	config_free_cfg(&b);
+}
+
+static void count_call(const struct cfg *value, void *arg)
+{
+	++*(int *)arg;
+}
+
+/* a cfg with s_foo_i and the second element of baz given */
+static void write_sub_cfg(const char *path, int i, int j)
+{
+	char text[1024];
+
+	snprintf(text, sizeof(text), "{ .foo = { .s_foo_i = %d,\n"
+			".s_foo_s = [ \"1\", \"2\", \"3\", \"4\", \"5\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [], .s_foo_f = [], },\n"
+			".bar = { .bar = \"x\", }, .baz = [ { .i = 1, }, "
+			"{ .i = %d, }, ],\n.f = 5, .addr = \"01:02:03:04:05:06\", }\n",
+			i, j);
+	write_file(path, text);
+}
+
+/* a subscription is called by the reloads that change its subtree */
+static void test_subscribe(void)
+{
+	static const struct {
+		int i, j;
+		int foo, baz, any;
+	} reloads[] = {
+		{ 1, 1, 1, 1, 1 },	/* the first load calls all */
+		{ 1, 1, 1, 1, 1 },
+		{ 2, 1, 2, 1, 2 },
+		{ 2, 3, 2, 2, 3 },
+		{ 3, 3, 2, 2, 4 },	/* foo was unsubscribed */
+	};
+	struct config_sub *foo, *baz, *any;
+	const char *err_msg = NULL;
+	int nfoo = 0, nbaz = 0, nany = 0;
+	int i, ret;
+
+	foo = config_subscribe_cfg(".foo", count_call, &nfoo);
+	baz = config_subscribe_cfg(".baz[1]", count_call, &nbaz);
+	any = config_subscribe_cfg(NULL, count_call, &nany);
+	CHECK(foo && baz && any, "out of memory");
+	for (i = 0; i < (int)(sizeof(reloads) / sizeof(reloads[0])); ++i) {
+		if (i == 4) {
+			config_unsubscribe_cfg(foo);
+		}
+		write_sub_cfg("sub.conf", reloads[i].i, reloads[i].j);
+		ret = config_reload_cfg("sub.conf", &err_msg);
+		CHECK(!ret, "reload %d: %s", i, err_msg);
+		if (ret) {
+			free((char *)err_msg);
+			err_msg = NULL;
+		}
+		CHECK(nfoo == reloads[i].foo && nbaz == reloads[i].baz &&
+				nany == reloads[i].any, "reload %d: %d %d %d",
+				i, nfoo, nbaz, nany);
+	}
+	/* retiring the snapshot calls none */
+	config_reload_cfg(NULL, &err_msg);
+	CHECK(nbaz == 2 && nany == 4, "retire: %d %d", nbaz, nany);
+	config_unsubscribe_cfg(baz);
+	config_unsubscribe_cfg(any);
+	remove("sub.conf");
+}
+
+/* a shared struct referenced by an anchor is converted once and freed once */
+static void test_anchors(void)
+{
+	struct cfg value;
+	const char *err_msg = NULL;
+	int ret;
+
+	write_file("anchor.conf", "{ .foo = &f { .s_foo_s = [ \"1\", \"2\", "
+			"\"3\", \"4\", \"5\", ],\n.ip6p = \"::1/120\", "
+			".ip4p = [], .s_foo_f = [ 1.5, 2.5, ], },\n"
+			".bar = { .foo = *f, }, .baz = [ &v { .k = [ 1, 2, ], }, "
+			"*v, *v, ],\n.f = 5, .addr = \"01:02:03:04:05:06\", }\n");
+	ret = config_parse_cfg(&value, "anchor.conf", &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	if (!ret) {
+		CHECK(value.bar_type == S_U_TYPE_FOO &&
+				value.foo.config2c_shared +
+				value.bar.foo.config2c_shared == 3,
+				"shared %d %d", value.foo.config2c_shared,
+				value.bar.foo.config2c_shared);
+		CHECK(value.foo.s_foo_s[0] == value.bar.foo.s_foo_s[0] &&
+				value.foo.s_foo_f == value.bar.foo.s_foo_f &&
+				value.bar.foo.s_foo_f_len == 2,
+				"the copy does not share its storage");
+		/* a union is not shared, each reference has its own array */
+		CHECK(value.baz_len == 3 && value.baz[2].k_len == 2 &&
+				value.baz[2].k[1] == 2 &&
+				value.baz[1].k != value.baz[2].k,
+				"baz %ld", value.baz_len);
+		config_free_cfg(&value);
+	}
+	free((char *)err_msg);
+	err_msg = NULL;
+
+	/* errors in the anchored value are reported at the anchor */
+	write_file("anchor.conf", "{ .foo = &f { .s_foo_s = [ \"1\", \"2\", "
+			"\"3\", \"4\", \"5\", ],\n.ip6p = \"::1/120\", "
+			".ip4p = [], .s_foo_f = [ 1.5, \"x\", ], },\n"
+			".bar = { .foo = *f, }, .baz = [],\n"
+			".f = 5, .addr = \"01:02:03:04:05:06\", }\n");
+	ret = config_parse_cfg(&value, "anchor.conf", &err_msg);
+	CHECK(ret == -EINVAL && err_msg && !strncmp(err_msg,
+			".foo.s_foo_f.[1]: ", 18), "%d %s", ret, err_msg);
+	if (!ret) {
+		config_free_cfg(&value);
+	}
+	free((char *)err_msg);
+	remove("anchor.conf");
+}
+
+static int in_block(const void *p, const void *block, size_t size)
+{
+	return (const char *)p >= (const char *)block &&
+		(const char *)p < (const char *)block + size;
+}
+
+/* the arrays and strings of a packed cfg are all in its block */
+static int packed_in_block(const struct cfg *p, size_t size)
+{
+	int i;
+
+	for (i = 0; i < 5; ++i) {
+		if (!in_block(p->foo.s_foo_s[i], p, size) ||
+				!in_block(p->bar.foo.s_foo_s[i], p, size)) {
+			return 0;
+		}
+	}
+	return in_block(p->foo.s_foo_f, p, size) &&
+		in_block(p->bar.foo.s_foo_f, p, size) &&
+		in_block(p->foo.ip4, p, size) &&
+		in_block(p->baz, p, size) && in_block(p->baz_type, p, size) &&
+		in_block(p->baz[2].k, p, size) && in_block(p->name, p, size);
+}
+
+/* a packed value and its clone dump and compare as the value */
+static void test_pack(void)
+{
+	struct cfg value, *packed, *clone;
+	const char *err_msg = NULL;
+	char *text, *packed_text;
+	size_t size, clone_size;
+	int ret;
+
+	write_file("pack.conf", "{ .foo = &f { .s_foo_s = [ \"1\", \"2\", "
+			"\"3\", \"4\", \"5\", ],\n.ip6p = \"::1/120\", "
+			".ip4p = [ \"1.2.3.4/24\", ], .s_foo_f = [ 1.5, 2.5, ], },\n"
+			".bar = { .foo = *f, }, .baz = [ { .i = 1, }, { .j = 2, }, "
+			"{ .k = [ 1, 2, 3, ], }, ],\n.s = \"str\", "
+			".addr = \"01:02:03:04:05:06\", .name = \"a\\x00b\", }\n");
+	ret = config_parse_cfg(&value, "pack.conf", &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		remove("pack.conf");
+		return;
+	}
+	text = dump_cfg(&value);
+
+	packed = config_pack_cfg(&value, &size);
+	CHECK(packed && config_equal_cfg(&value, packed) &&
+			packed_in_block(packed, size) &&
+			in_block(packed->s, packed, size),
+			"packed value differs");
+	clone = packed ? config_clone_packed_cfg(packed, size) : NULL;
+	free(packed);
+	CHECK(clone && config_equal_cfg(&value, clone) &&
+			packed_in_block(clone, size) &&
+			config_hash_cfg(&value, NULL) ==
+			config_hash_cfg(clone, NULL), "clone differs");
+	packed_text = clone ? dump_cfg(clone) : NULL;
+	CHECK(text && packed_text && !strcmp(text, packed_text),
+			"dump of the clone differs");
+	free(packed_text);
+	free(clone);
+
+	ret = config_parse_packed_cfg(&packed, &clone_size, "pack.conf",
+			&err_msg);
+	CHECK(!ret && clone_size == size && config_equal_cfg(&value, packed),
+			"%d %s", ret, err_msg);
+	if (!ret) {
+		free(packed);
+	} else {
+		free((char *)err_msg);
+	}
+	free(text);
+	config_free_cfg(&value);
+	remove("pack.conf");
+}
+
+static void *plain_alloc(void *user, size_t size)
+{
+	return malloc(size);
+}
+
+static void plain_free(void *user, void *p, size_t size)
+{
+	free(p);
+}
+
+static void write_table(const char *path, const char *dev3)
+{
+	char text[1024];
+	int len, i;
+
+	len = sprintf(text, "{ .name = \"t\", .routes = [\n");
+	for (i = 0; i < 8; ++i) {
+		len += sprintf(text + len, "{ .dst = \"10.0.%d.0/24\", "
+				".dev = \"%s\", },\n", i, i == 3 ? dev3 : "eth0");
+	}
+	sprintf(text + len, "], }\n");
+	write_file(path, text);
+}
+
+static void *plain_realloc(void *user, void *p, size_t old_size, size_t size)
+{
+	return realloc(p, size);
+}
+
+/* everything a table takes from its allocator is given back */
+static void test_allocator(void)
+{
+	struct config_allocator alloc = {
+		plain_alloc, NULL, plain_realloc, plain_free, NULL,
+	};
+	struct table value;
+	const char *err_msg = NULL;
+	size_t bytes;
+	int ret;
+
+	write_table("table.conf", "eth0");
+	ret = config_parse_with_table(&value, "table.conf", &alloc, &err_msg);
+	CHECK(!ret, "%d %s", ret, err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		remove("table.conf");
+		return;
+	}
+	/* the name, the array of routes and the dev of each */
+	CHECK(value.config2c_alloc == &alloc && alloc.bytes &&
+			alloc.blocks == 1 + 1 + 8,
+			"%zu bytes in %zu blocks", alloc.bytes, alloc.blocks);
+	bytes = alloc.bytes;
+
+	ret = config_apply_table(&value, ".name = \"longer name\", "
+			".routes = [ { .dst = \"10.1.0.0/16\", .dev = \"eth1\", }, ]",
+			&err_msg);
+	CHECK(!ret && value.routes_len == 1 && alloc.peak >= bytes &&
+			alloc.blocks == 3, "%d %s, %zu blocks", ret, err_msg,
+			alloc.blocks);
+	if (ret) {
+		free((char *)err_msg);
+		err_msg = NULL;
+	}
+
+	/* a failed apply gives back what it converted */
+	bytes = alloc.bytes;
+	ret = config_apply_table(&value, ".routes = [ { .dst = \"10.1.0.0/16\", "
+			".dev = \"eth1\", }, { .dst = \"x\", .dev = \"eth2\", }, ]",
+			&err_msg);
+	CHECK(ret == -EINVAL && alloc.bytes == bytes, "%d, %zu bytes",
+			ret, alloc.bytes);
+	free((char *)err_msg);
+
+	config_free_table(&value);
+	CHECK(alloc.bytes == 0 && alloc.blocks == 0, "%zu bytes in %zu blocks",
+			alloc.bytes, alloc.blocks);
+
+	/* the other parse functions use malloc() */
+	ret = config_parse_table(&value, "table.conf", &err_msg);
+	CHECK(!ret && !value.config2c_alloc, "%d", ret);
+	if (!ret) {
+		config_free_table(&value);
+	} else {
+		free((char *)err_msg);
+	}
+	remove("table.conf");
+}
+
+/* what value takes over from old is freed once, the rest by release */
+static void test_reparse_release(void)
+{
+	struct config_allocator alloc = {
+		plain_alloc, NULL, NULL, plain_free, NULL,
+	};
+	struct table old, value;
+	const char *err_msg = NULL;
+	size_t bytes;
+	int ret;
+
+	write_table("table.conf", "eth0");
+	ret = config_parse_with_table(&old, "table.conf", &alloc, &err_msg);
+	CHECK(!ret, "%d %s", ret, err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		return;
+	}
+	bytes = alloc.bytes;
+
+	/* a failed reparse leaves old and frees what it converted */
+	write_file("table.conf", "{ .name = \"u\", .routes = [ "
+			"{ .dst = \"10.0.0.0/24\", .dev = \"eth1\", }, "
+			"{ .dst = \"x\", .dev = \"eth1\", }, ], }\n");
+	ret = config_reparse_table(&old, "table.conf", &value, &err_msg);
+	CHECK(ret == -EINVAL && alloc.bytes == bytes &&
+			!strcmp(old.routes[3].dev, "eth0"),
+			"%d %zu %zu", ret, alloc.bytes, bytes);
+	free((char *)err_msg);
+	err_msg = NULL;
+
+	write_table("table.conf", "eth1");
+	ret = config_reparse_table(&old, "table.conf", &value, &err_msg);
+	CHECK(!ret, "%d %s", ret, err_msg);
+	if (!ret) {
+		CHECK(value.config2c_alloc == &alloc &&
+				value.routes[0].dev == old.routes[0].dev &&
+				value.routes[3].dev != old.routes[3].dev &&
+				!strcmp(value.routes[3].dev, "eth1"),
+				"%s", value.routes[3].dev);
+		config_release_table(&old, &value);
+		config_free_table(&value);
+	} else {
+		free((char *)err_msg);
+		config_free_table(&old);
+	}
+	CHECK(alloc.bytes == 0 && alloc.blocks == 0, "%zu bytes in %zu blocks",
+			alloc.bytes, alloc.blocks);
+	remove("table.conf");
+}
+
+/* the arena of a zone takes its chunks from alloc, and gives all back */
+static void test_arena(void)
+{
+	struct config_allocator alloc = {
+		plain_alloc, NULL, NULL, plain_free, NULL,
+	};
+	struct zone value;
+	const char *err_msg = NULL;
+	size_t size;
+	int ret;
+
+	write_file("zone.conf", "{ .origin = \"example.org\", .hosts = [\n"
+			"{ .host = \"a\", .addr = \"10.0.0.1\", },\n"
+			"{ .host = \"b\", .addr = \"10.0.0.2\", }, ],\n"
+			".aliases = [ \"www\", \"mail\", ], }\n");
+	ret = config_parse_with_zone(&value, "zone.conf", &alloc, &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		remove("zone.conf");
+		return;
+	}
+	size = config_arena_size_zone(&value);
+	CHECK(value.config2c_arena && size && alloc.bytes >= size &&
+			!strcmp(value.hosts[1].host, "b") &&
+			!strcmp(value.aliases[1], "mail"),
+			"arena of %zu bytes, %zu allocated", size, alloc.bytes);
+
+	/* apply converts into the same arena */
+	ret = config_apply_zone(&value, ".origin = \"example.net\"", &err_msg);
+	CHECK(!ret && !strcmp(value.origin, "example.net") &&
+			config_arena_size_zone(&value) >= size, "%s", err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		err_msg = NULL;
+	}
+	config_free_zone(&value);
+	CHECK(!value.config2c_arena && alloc.bytes == 0 && alloc.blocks == 0,
+			"%zu bytes in %zu blocks", alloc.bytes, alloc.blocks);
+
+	/* a failed parse frees its arena */
+	write_file("zone.conf", "{ .origin = \"example.org\", .hosts = [\n"
+			"{ .host = \"a\", .addr = \"x\", }, ], .aliases = [], }\n");
+	ret = config_parse_with_zone(&value, "zone.conf", &alloc, &err_msg);
+	CHECK(ret == -EINVAL && alloc.bytes == 0 && alloc.blocks == 0,
+			"%d, %zu bytes in %zu blocks", ret, alloc.bytes,
+			alloc.blocks);
+	free((char *)err_msg);
+	remove("zone.conf");
+}
+
+/* a fixed struct reports what does not fit instead of allocating */
+static void test_fixed(void)
+{
+	static const struct {
+		const char *text, *msg;
+	} cases[] = {
+		{ "{ .host = \"0123456789abcde\", .ports = [ 1, 2, 3, 4, ], "
+			".allow = [ \"10.0.0.1\", \"10.0.0.2\", ], }", NULL },
+		{ "{ .host = \"0123456789abcdef\", .ports = [], .allow = [], }",
+			".host: " },
+		{ "{ .host = \"h\", .ports = [ 1, 2, 3, 4, 5, ], .allow = [], }",
+			".ports: too many elements." },
+		{ "{ .host = \"h\", .ports = [], .allow = [ \"10.0.0.1\", "
+			"\"10.0.0.2\", \"10.0.0.3\", ], }",
+			".allow: too many elements." },
+	};
+	struct listen value;
+	const char *err_msg;
+	int i, ret;
+
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		write_file("listen.conf", cases[i].text);
+		err_msg = NULL;
+		ret = config_parse_listen(&value, "listen.conf", &err_msg);
+		if (!cases[i].msg) {
+			CHECK(!ret && value.ports_len == 4 &&
+					value.allow_len == 2 &&
+					!strcmp(value.host, "0123456789abcde"),
+					"case %d: %s", i, err_msg);
+		} else {
+			CHECK(ret == -ENOSPC && err_msg && !strncmp(err_msg,
+					cases[i].msg, strlen(cases[i].msg)),
+					"case %d: %d %s", i, ret, err_msg);
+		}
+		if (!ret) {
+			config_free_listen(&value);
+		}
+		free((char *)err_msg);
+	}
+
+	/* an apply that does not fit keeps the old value */
+	write_file("listen.conf", cases[0].text);
+	err_msg = NULL;
+	ret = config_parse_listen(&value, "listen.conf", &err_msg);
+	CHECK(!ret, "%s", err_msg);
+	if (!ret) {
+		ret = config_apply_listen(&value, ".host = \"a\", "
+				".ports = [ 1, 2, 3, 4, 5, ]", &err_msg);
+		CHECK(ret == -ENOSPC && value.ports_len == 4 &&
+				value.ports[3] == 4, "%d %s", ret, err_msg);
+		config_free_listen(&value);
+	}
+	free((char *)err_msg);
+	remove("listen.conf");
+}
+
+/* a title past its capacity spills, through apply and pack too */
+static void test_spill(void)
+{
+	static const char *const long_title = "a title of more than 16 bytes";
+	struct motd value, *packed, *clone;
+	const char *err_msg = NULL;
+	size_t size;
+	int ret;
+
+	write_file("motd.conf", "{ .title = \"short\", .lines = [ \"hi\", ], }\n");
+	ret = config_parse_motd(&value, "motd.conf", &err_msg);
+	remove("motd.conf");
+	CHECK(!ret, "%s", err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		return;
+	}
+	CHECK(!value.title_spill && !strcmp(CONFIG_BOUNDED(&value, title),
+			"short"), "short title spilled");
+
+	ret = config_apply_motd(&value, ".title = \"a title of more than 16 "
+			"bytes\"", &err_msg);
+	CHECK(!ret && value.title_spill &&
+			!strcmp(CONFIG_BOUNDED(&value, title), long_title),
+			"%d %s", ret, err_msg);
+
+	packed = config_pack_motd(&value, &size);
+	CHECK(packed && config_equal_motd(&value, packed) &&
+			in_block(packed->title_spill, packed, size) &&
+			!strcmp(CONFIG_BOUNDED(packed, title), long_title),
+			"packed spill");
+	clone = packed ? config_clone_packed_motd(packed, size) : NULL;
+	free(packed);
+	CHECK(clone && in_block(clone->title_spill, clone, size) &&
+			!strcmp(CONFIG_BOUNDED(clone, title), long_title),
+			"cloned spill");
+	free(clone);
+
+	/* a title that fits again goes back inline */
+	ret = config_apply_motd(&value, ".title = \"again\"", &err_msg);
+	CHECK(!ret && !value.title_spill &&
+			!strcmp(CONFIG_BOUNDED(&value, title), "again"),
+			"%d %s", ret, err_msg);
+	if (ret) {
+		free((char *)err_msg);
+	}
+	config_free_motd(&value);
+}
+
+static int load_sites(struct sites *value, const struct sites *old,
+		struct config_dir *dir)
+{
+	const char *err_msg = NULL;
+	int ret;
+
+	memset(value, 0, sizeof(*value));
+	ret = config_load_dir_sites_site(value, old, "sites.d", dir, 2,
+			&err_msg);
+	CHECK(!ret, "%s", err_msg);
+	free((char *)err_msg);
+	return ret;
+}
+
+/* a reload of a directory takes over the elements of unchanged files */
+static void test_load_dir(void)
+{
+	struct config_dir *dir = config_dir_new();
+	struct sites old, value;
+	const char *err_msg = NULL;
+	int ret;
+
+	mkdir("sites.d", 0755);
+	write_file("sites.d/a.conf", "{ .host = \"a\", .addr = \"10.0.0.1\", }\n");
+	write_file("sites.d/b.conf", "{ .host = \"b\", .addr = \"10.0.0.2\", "
+			".port = 8080, }\n");
+	write_file("sites.d/c.conf", "{ .host = \"c\", .addr = \"10.0.0.3\", }\n");
+	write_file("sites.d/.hidden", "not a config\n");
+	if (load_sites(&old, NULL, dir)) {
+		goto out;
+	}
+	CHECK(old.site_len == 3 && !strcmp(old.site[0].host, "a") &&
+			old.site[1].port == 8080 && old.site[2].port == 80,
+			"%ld sites", old.site_len);
+
+	/* b is rewritten with another size, c only rewritten */
+	write_file("sites.d/b.conf", "{ .host = \"bb\", .addr = \"10.0.0.2\", }\n");
+	write_file("sites.d/c.conf", "{ .host = \"c\", .addr = \"10.0.0.3\", }\n");
+	if (load_sites(&value, &old, dir)) {
+		config_free_sites(&old);
+		goto out;
+	}
+	CHECK(value.site_len == 3 && value.site[0].host == old.site[0].host &&
+			value.site[2].host == old.site[2].host &&
+			value.site[1].host != old.site[1].host &&
+			!strcmp(value.site[1].host, "bb") && value.site[1].port == 80,
+			"%ld sites", value.site_len);
+	config_release_dir_sites_site(&old, dir);
+
+	/* a file that fails keeps the value and the dir as they were */
+	old = value;
+	write_file("sites.d/d.conf", "{ .host = \"d\", .addr = \"x\", }\n");
+	memset(&value, 0, sizeof(value));
+	ret = config_load_dir_sites_site(&value, &old, "sites.d", dir, 2,
+			&err_msg);
+	CHECK(ret == -EINVAL && err_msg && strstr(err_msg, "d.conf") &&
+			!value.site_len, "%d %s", ret, err_msg);
+	free((char *)err_msg);
+	remove("sites.d/d.conf");
+	if (!load_sites(&value, &old, dir)) {
+		CHECK(value.site_len == 3 && value.site[1].host == old.site[1].host,
+				"%ld sites", value.site_len);
+		config_release_dir_sites_site(&old, dir);
+		config_free_sites(&value);
+	} else {
+		config_free_sites(&old);
+	}
+out:
+	config_dir_free(dir);
+	remove("sites.d/a.conf");
+	remove("sites.d/b.conf");
+	remove("sites.d/c.conf");
+	remove("sites.d/.hidden");
+	rmdir("sites.d");
+}
+
+int main(void)
+{
+	test_parallel_error_location();
+	test_parallel_same_result();
+	test_range_without_spaces();
+	test_range_error();
+	test_layered_then_cached();
+	test_cache_dependency();
+	test_layers();
+	test_apply();
+	test_compare();
+	test_subscribe();
+	test_anchors();
+	test_pack();
+	test_allocator();
+	test_reparse_release();
+	test_load_dir();
+	test_arena();
+	test_fixed();
+	test_spill();
+	if (failed) {
+		fprintf(stderr, "%d failed\n", failed);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
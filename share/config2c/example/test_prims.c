@@ -0,0 +1,692 @@
+/* the example types are static in the converter, include it to reach them */
+#include "demo_0-converter.c"
+
+static int failed;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failed++; \
+	} \
+} while (0)
+
+/* dump by put_func and by the bdump hook, expect the same text */
+#define CHECK_DUMP(type, ...) do { \
+	struct dump_buffer a, b; \
+	dump_buffer_init(&a, NULL, 0, DUMP_BUFFER_GROW); \
+	dump_buffer_init(&b, NULL, 0, DUMP_BUFFER_GROW); \
+	dump_##type(dump_buffer_printf, (struct dump_context *)&a, __VA_ARGS__); \
+	bdump_##type(&b, __VA_ARGS__); \
+	dump_buffer_finish(&a); \
+	dump_buffer_finish(&b); \
+	CHECK(!strcmp(a.data, b.data), #type ": dump \"%s\", bdump \"%s\"", \
+			a.data, b.data); \
+	free(a.data); \
+	free(b.data); \
+} while (0)
+
+static void test_dump_equal(void)
+{
+	static const long long ll[] = {
+		0, 1, -1, 9, 10, -10, 12345, LLONG_MAX, LLONG_MIN,
+	};
+	static const unsigned long long ull[] = {
+		0, 1, 9, 10, 12345, LLONG_MAX, (unsigned long long)LLONG_MAX + 1,
+		ULLONG_MAX - 1, ULLONG_MAX,
+	};
+	static const double d[] = {
+		0.0, -0.0, 1.0, 0.1, -2.5, 1e23, 5e-324, 1.7976931348623157e308,
+		123456789.125,
+	};
+	static const char *s[] = {
+		"", "plain", "quote \" and \\", "\t\n\x01\x7f\xff",
+	};
+	unsigned u;
+	float f;
+	int i, n;
+
+	for (i = 0; i < (int)(sizeof(ll) / sizeof(ll[0])); ++i) {
+		CHECK_DUMP(llong, &ll[i]);
+		n = (int)ll[i];
+		CHECK_DUMP(int, &n);
+	}
+	for (i = 0; i < (int)(sizeof(ull) / sizeof(ull[0])); ++i) {
+		CHECK_DUMP(ullong, &ull[i]);
+		u = (unsigned)ull[i];
+		CHECK_DUMP(uint, &u);
+	}
+	for (i = 0; i < (int)(sizeof(d) / sizeof(d[0])); ++i) {
+		CHECK_DUMP(double, &d[i]);
+		f = (float)d[i];
+		CHECK_DUMP(float, &f);
+	}
+	for (i = 0; i < (int)(sizeof(s) / sizeof(s[0])); ++i) {
+		CHECK_DUMP(string, &s[i]);
+	}
+}
+
+static uint64_t rand_state = 88172645463325252ull;
+
+/* xorshift64, reproducible across runs */
+static uint64_t rand64(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/* significant digits of a decimal string, trailing zeros excluded */
+static int sig_digits(const char *s)
+{
+	int n = 0, zeros = 0, lead = 1;
+	for (; *s && *s != 'e'; ++s) {
+		if (*s < '0' || *s > '9') {
+			continue;
+		}
+		if (*s != '0') {
+			lead = 0;
+		}
+		if (!lead) {
+			++n;
+			zeros = *s == '0' ? zeros + 1 : 0;
+		}
+	}
+	return n - zeros;
+}
+
+static void check_double_round_trip(double val)
+{
+	char out[FP_STR_MAX + 1];
+	double back;
+	int len;
+
+	len = double_to_str(out, val);
+	out[len] = '\0';
+	back = strtod(out, NULL);
+	CHECK(!memcmp(&back, &val, sizeof(val)), "double %a: \"%s\" reads %a",
+			val, out, back);
+	CHECK(sig_digits(out) <= 17, "double %a: \"%s\" too long", val, out);
+}
+
+static void check_float_round_trip(float val)
+{
+	char out[FP_STR_MAX + 1];
+	float back;
+	int len;
+
+	len = float_to_str(out, val);
+	out[len] = '\0';
+	back = strtof(out, NULL);
+	CHECK(!memcmp(&back, &val, sizeof(val)), "float %a: \"%s\" reads %a",
+			val, out, back);
+	CHECK(sig_digits(out) <= 9, "float %a: \"%s\" too long", val, out);
+}
+
+static void test_grisu2(void)
+{
+	static const struct {
+		double val;
+		const char *str;
+	} fixed[] = {
+		{ 0.0, "0.0" },
+		{ -0.0, "-0.0" },
+		{ 0.1, "0.1" },
+		{ 0.3, "0.3" },
+		{ 1.0, "1.0" },
+		{ 100.0, "100.0" },
+		{ 123456789.125, "123456789.125" },
+		{ 1e21, "1.0e21" },
+		{ 1e-7, "1.0e-7" },
+		{ 5e-324, "5.0e-324" },
+		{ 2.2250738585072014e-308, "2.2250738585072014e-308" },
+		{ 1.7976931348623157e308, "1.7976931348623157e308" },
+	};
+	char out[FP_STR_MAX + 1];
+	uint64_t bits;
+	uint32_t fbits;
+	double d;
+	float f;
+	int i, len;
+
+	for (i = 0; i < (int)(sizeof(fixed) / sizeof(fixed[0])); ++i) {
+		len = double_to_str(out, fixed[i].val);
+		out[len] = '\0';
+		CHECK(!strcmp(out, fixed[i].str), "double %a: \"%s\", expect \"%s\"",
+				fixed[i].val, out, fixed[i].str);
+	}
+	/* boundaries of the exponent range and of the mantissa */
+	for (bits = 0; bits < 64; ++bits) {
+		check_double_round_trip(ldexp(1.0, bits * 32 - 1074));
+		check_double_round_trip(nextafter(ldexp(1.0, bits * 32 - 1022), 0));
+		check_float_round_trip(ldexpf(1.0f, bits * 4 - 149));
+	}
+	for (i = 0; i < 200000; ++i) {
+		bits = rand64();
+		memcpy(&d, &bits, sizeof(d));
+		if (!isnan(d) && !isinf(d)) {
+			check_double_round_trip(d);
+		}
+		fbits = bits >> 32;
+		memcpy(&f, &fbits, sizeof(f));
+		if (!isnan(f) && !isinf(f)) {
+			check_float_round_trip(f);
+		}
+	}
+}
+
+/* to_double/to_float must agree with strtod/strtof, errors included */
+static void check_decimal(const char *str)
+{
+	double d, ref;
+	float f, reff;
+	int ret, err;
+
+	errno = 0;
+	ref = strtod(str, NULL);
+	err = errno;
+	d = 0;
+	ret = to_double(&d, str);
+	CHECK(ret == -err && (ret || !memcmp(&d, &ref, sizeof(d))),
+			"to_double(\"%s\") = %d %a, strtod %d %a",
+			str, ret, d, -err, ref);
+
+	errno = 0;
+	reff = strtof(str, NULL);
+	err = errno;
+	f = 0;
+	ret = to_float(&f, str);
+	CHECK(ret == -err && (ret || !memcmp(&f, &reff, sizeof(f))),
+			"to_float(\"%s\") = %d %a, strtof %d %a",
+			str, ret, f, -err, reff);
+}
+
+static void test_to_double(void)
+{
+	static const char *fixed[] = {
+		"0.0", "-0.0", "1.0", "0.1", "3.0e0", "123456789.125",
+		/* halfway between two doubles, rounds to even */
+		"9007199254740993.0", "9007199254740995.0",
+		"9223372036854776832.0", "9223372036854778880.0",
+		"4503599627370496.5", "4503599627370497.5",
+		"1125899906842624.125", "1125899906842624.375",
+		/* halfway between two floats */
+		"16777217.0", "16777219.0", "33554434.0", "33554438.0",
+		"8388608.5", "8388609.5",
+		/* ends of the fast paths and of the table */
+		"9007199254740992.0e22", "1.0e23", "1.0e-22", "1.0e-23",
+		"1.0e100", "1.0e-100", "1.0e101", "1.0e-101",
+		"9999999999999999999.0e100", "1.0e-80", "7.0e-46",
+		/* limits and overflow */
+		"1.7976931348623157e308", "1.7976931348623158e308",
+		"1.7976931348623159e308", "1.0e309", "-1.0e400",
+		"2.2250738585072014e-308", "2.2250738585072011e-308",
+		"4.9406564584124654e-324", "1.0e-400",
+		"3.4028234e38", "3.4028236e38", "1.17549435e-38", "1.0e-46",
+		/* more than 19 significant digits, hex */
+		"12345678901234567890.0", "0.12345678901234567890123",
+		"0x1.8p1", "0x10.0p-2",
+	};
+	char str[64];
+	uint64_t r, w;
+	int i, q;
+
+	for (i = 0; i < (int)(sizeof(fixed) / sizeof(fixed[0])); ++i) {
+		check_decimal(fixed[i]);
+	}
+	for (i = 0; i < 200000; ++i) {
+		r = rand64();
+		w = rand64() >> (r & 63);
+		q = (int)(r >> 8 & 1023) - 512;
+		if (i & 1) {
+			q = q % 120;
+		}
+		snprintf(str, sizeof(str), "%s%llu.0e%d", r >> 40 & 1 ? "-" : "",
+				(unsigned long long)w, q);
+		check_decimal(str);
+	}
+}
+
+/* strto{u,}ll() stop at a bad digit, to_{u,}longlong() fail with -EINVAL */
+static void check_integer(const char *str)
+{
+	unsigned long long u, refu;
+	long long l, refl;
+	char *end;
+	int ret, err;
+
+	if (str[0] != '-') {
+		errno = 0;
+		refu = strtoull(str, &end, 0);
+		err = *end ? EINVAL : errno;
+		u = 0;
+		ret = to_ulonglong(&u, str);
+		CHECK(ret == -err && (ret || u == refu),
+				"to_ulonglong(\"%s\") = %d %llu, strtoull %d %llu",
+				str, ret, u, -err, refu);
+	}
+	errno = 0;
+	refl = strtoll(str, &end, 0);
+	err = *end ? EINVAL : errno;
+	l = 0;
+	ret = to_longlong(&l, str);
+	CHECK(ret == -err && (ret || l == refl),
+			"to_longlong(\"%s\") = %d %lld, strtoll %d %lld",
+			str, ret, l, -err, refl);
+}
+
+static void test_to_integer(void)
+{
+	static const char *fixed[] = {
+		"0", "1", "-1", "12345678", "123456789", "1234567812345678",
+		"9223372036854775807", "9223372036854775808",
+		"-9223372036854775808", "-9223372036854775809",
+		"18446744073709551615", "18446744073709551616",
+		"99999999999999999999", "000", "0777", "01777777777777777777777",
+		"02000000000000000000000", "0x0", "0xffffffffffffffff",
+		"0x10000000000000000", "0x7FFFFFFFFFFFFFFF", "-0x8000000000000000",
+	};
+	char str[64];
+	uint64_t r;
+	int i;
+
+	for (i = 0; i < (int)(sizeof(fixed) / sizeof(fixed[0])); ++i) {
+		check_integer(fixed[i]);
+	}
+	for (i = 0; i < 200000; ++i) {
+		r = rand64() >> (i & 63);
+		switch (i % 4) {
+		case 0:
+			snprintf(str, sizeof(str), "%llu", (unsigned long long)r);
+			break;
+		case 1:
+			snprintf(str, sizeof(str), "-%llu", (unsigned long long)r);
+			break;
+		case 2:
+			snprintf(str, sizeof(str), "0x%llx", (unsigned long long)r);
+			break;
+		default:
+			snprintf(str, sizeof(str), "%llu%d", (unsigned long long)r,
+					i % 10);
+			break;
+		}
+		check_integer(str);
+	}
+}
+
+static void test_eth_mac(void)
+{
+	static const struct {
+		const char *str;
+		int ok;
+		uint8_t a[6];
+	} cases[] = {
+		{ "01:02:03:04:05:06", 1, { 1, 2, 3, 4, 5, 6 } },
+		{ "aa-BB-cc-DD-ee-FF", 1, { 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff } },
+		{ "1:2:3:a:b:c", 1, { 1, 2, 3, 10, 11, 12 } },
+		{ "01:02:03:04:05", 0 },
+		{ "01:02:03:04:05:06:", 0 },
+		{ "01:02-03:04:05:06", 0 },
+		{ "01:02:03:04:05:0g", 0 },
+		{ "001:02:03:04:05:06", 0 },
+		{ "01:02:03:04:05:\xe0", 0 },
+		{ "\xff\xfe:02:03:04:05:06", 0 },
+		{ "ab", 0 },
+		{ "a", 0 },
+		{ "ab:", 0 },
+		{ "", 0 },
+	};
+	struct pass_to_conv context = {};
+	struct node_value val = {};
+	struct eth_mac mac;
+	char *str;
+	int i, ret;
+
+	val.type = VAL_SCALE_STRING;
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		/* on the heap, so a read past the end is caught */
+		str = strdup(cases[i].str);
+		val.string_str = str;
+		ret = parse_eth_mac(&context, &mac, &val);
+		CHECK(cases[i].ok ? !ret && !memcmp(mac.a, cases[i].a, 6) :
+				ret == -EINVAL, "mac \"%s\": %d", cases[i].str, ret);
+		free(str);
+	}
+}
+
+/* the address parsers accept what inet_pton accepts */
+static void check_inet(const char *str)
+{
+	struct pass_to_conv context = {};
+	struct node_value val = {};
+	struct in6_addr a6, b6;
+	struct in_addr a4, b4;
+	char *copy = strdup(str);
+	int ret, ok;
+
+	val.type = VAL_SCALE_STRING;
+	val.string_str = copy;
+	ret = parse_inet4(&context, &a4, &val);
+	ok = inet_pton(AF_INET, str, &b4) == 1;
+	CHECK(ok ? !ret && !memcmp(&a4, &b4, sizeof(a4)) : ret == -EINVAL,
+			"inet4 \"%s\": %d, inet_pton %d", str, ret, ok);
+	ret = parse_inet6(&context, &a6, &val);
+	ok = inet_pton(AF_INET6, str, &b6) == 1;
+	CHECK(ok ? !ret && !memcmp(&a6, &b6, sizeof(a6)) : ret == -EINVAL,
+			"inet6 \"%s\": %d, inet_pton %d", str, ret, ok);
+	free(copy);
+}
+
+static void test_inet(void)
+{
+	static const char *fixed[] = {
+		"0.0.0.0", "255.255.255.255", "1.2.3.4", "256.1.1.1",
+		"01.2.3.4", "1.2.3", "1.2.3.4.", "1.2.3.4.5", "1..2.3",
+		"1.2.3.4 ", " 1.2.3.4", "1.2.3.-4", "1.2.3.0x4", "",
+		"::", "::1", "1::", "1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7::",
+		"::2:3:4:5:6:7:8", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7",
+		"1::2::3", ":1::2", "1::2:", "12345::", "fFfF::AbCd",
+		"::ffff:1.2.3.4", "::1.2.3.4", "1:2:3:4:5:6:1.2.3.4",
+		"1:2:3:4:5:6:7:1.2.3.4", "::ffff:1.2.3", "::ffff:01.2.3.4",
+		"1.2.3.4::", "::g", "0:0:0:0:0:0:0:0", ":::",
+	};
+	char text[INET6_ADDRSTRLEN];
+	uint64_t words[2];
+	int i;
+
+	for (i = 0; i < (int)(sizeof(fixed) / sizeof(fixed[0])); ++i) {
+		check_inet(fixed[i]);
+	}
+	for (i = 0; i < 20000; ++i) {
+		words[0] = rand64();
+		/* runs of zero groups for "::" */
+		words[1] = i & 1 ? rand64() & rand64() & rand64() : rand64();
+		inet_ntop(AF_INET6, words, text, sizeof(text));
+		check_inet(text);
+		inet_ntop(AF_INET, words, text, sizeof(text));
+		check_inet(text);
+	}
+}
+
+static void test_inet_prefix(void)
+{
+	static const struct {
+		const char *str;
+		int ok4, ok6, prefix;
+	} cases[] = {
+		{ "1.2.3.4/0", 1, 0, 0 },
+		{ "1.2.3.4/32", 1, 0, 32 },
+		{ "1.2.3.4/33", 0, 0 },
+		{ "1.2.3.4/", 0, 0 },
+		{ "1.2.3.4", 0, 0 },
+		{ "1.2.3.4/1a", 0, 0 },
+		{ "1.2.3.4/008", 0, 0 },
+		{ "1.2.3/8", 0, 0 },
+		{ "::1/128", 0, 1, 128 },
+		{ "::1/129", 0, 0 },
+		{ "::/0", 0, 1, 0 },
+		{ "::1/1280", 0, 0 },
+		{ "::ffff:1.2.3.4/96", 0, 1, 96 },
+		{ "::1", 0, 0 },
+	};
+	struct pass_to_conv context = {};
+	struct node_value val = {};
+	struct in6_addr a6;
+	struct in_addr a4;
+	char *copy;
+	int i, ret, prefix;
+
+	val.type = VAL_SCALE_STRING;
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		copy = strdup(cases[i].str);
+		val.string_str = copy;
+		prefix = -1;
+		ret = parse_inet4wp(&context, &a4, &prefix, &val);
+		CHECK(cases[i].ok4 ? !ret && prefix == cases[i].prefix :
+				ret == -EINVAL, "inet4wp \"%s\": %d /%d",
+				cases[i].str, ret, prefix);
+		prefix = -1;
+		ret = parse_inet6wp(&context, &a6, &prefix, &val);
+		CHECK(cases[i].ok6 ? !ret && prefix == cases[i].prefix :
+				ret == -EINVAL, "inet6wp \"%s\": %d /%d",
+				cases[i].str, ret, prefix);
+		free(copy);
+	}
+}
+
+/* a batch kernel keeps the node of a bad range element for the message */
+static void test_range_batch_error(void)
+{
+	struct pass_to_conv context = {};
+	struct pass_to_bison opaque;
+	struct mem_pool pool;
+	const char *err_msg = NULL, *msg;
+	int result[4], ret;
+
+	mem_pool_init(&pool);
+	init_pass_to_bison(&opaque, &pool);
+	ret = yacc_parse_string("[ 2147483646 ... 2147483649, ]", &err_msg,
+			&opaque);
+	CHECK(!ret, "%s", err_msg);
+	if (!ret) {
+		set_parent_elems(opaque.output->elems, opaque.output);
+		ret = parse_int_array(&context, result, opaque.output->elems, 4);
+		CHECK(ret == -ERANGE && context.node == &context.node_copy,
+				"%d", ret);
+		msg = make_msg_loc(context.node, context.msg);
+		CHECK(msg && !strcmp(msg, ".[2]: overflow occurred."), "%s", msg);
+		free((char *)msg);
+	}
+	free((char *)err_msg);
+	mem_pool_destroy(&pool);
+}
+
+/* the lengths of the runs add up past LONG_MAX and wrap to 5 */
+static void test_range_too_large(void)
+{
+	struct pass_to_bison opaque;
+	struct mem_pool pool;
+	struct cfg value;
+	const char *err_msg = NULL;
+	FILE *fp;
+	int ret;
+
+	fp = fopen("range.conf", "w");
+	fprintf(fp, "{ .foo = { .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", \"5\", ],\n"
+			".ip6p = \"::1/120\", .ip4p = [], .s_foo_f = [], },\n"
+			".bar = { .bar = \"x\", }, .f = 5,\n"
+			".baz = [ { .k = [ 0 ... 9223372036854775806, "
+			"0 ... 9223372036854775806, 1, 2, 3, 4, 5, 6, 7, ], }, ],\n"
+			".addr = \"01:02:03:04:05:06\", }\n");
+	fclose(fp);
+	ret = config_parse_cfg(&value, "range.conf", &err_msg);
+	CHECK(ret == -EINVAL && err_msg && strstr(err_msg, "array too large"),
+			"%d %s", ret, err_msg);
+	if (!ret) {
+		config_free_cfg(&value);
+	}
+	free((char *)err_msg);
+	err_msg = NULL;
+	remove("range.conf");
+
+	/* one below the limit is fine for the grammar */
+	mem_pool_init(&pool);
+	init_pass_to_bison(&opaque, &pool);
+	ret = yacc_parse_string("[ 1 ... 9223372036854775806, 0, ]", &err_msg,
+			&opaque);
+	CHECK(!ret && len_node_elems(opaque.output->elems) == LONG_MAX,
+			"%d %s", ret, err_msg);
+	free((char *)err_msg);
+	mem_pool_destroy(&pool);
+}
+
+/* a batch kernel fills no more than n elements from a longer range */
+static void test_range_batch_bound(void)
+{
+	struct pass_to_conv context = {};
+	struct pass_to_bison opaque;
+	struct mem_pool pool;
+	const char *err_msg = NULL;
+	long *result = malloc(5 * sizeof(*result));
+	unsigned *uresult = malloc(5 * sizeof(*uresult));
+	int i, ret;
+
+	mem_pool_init(&pool);
+	init_pass_to_bison(&opaque, &pool);
+	ret = yacc_parse_string("[ 0 ... 9, ]", &err_msg, &opaque);
+	CHECK(!ret, "%s", err_msg);
+	if (!ret) {
+		ret = parse_long_array(&context, result, opaque.output->elems, 5);
+		CHECK(!ret, "parse_long_array %d", ret);
+		ret = parse_uint_array(&context, uresult, opaque.output->elems, 5);
+		CHECK(!ret, "parse_uint_array %d", ret);
+		for (i = 0; i < 5; ++i) {
+			CHECK(result[i] == i && uresult[i] == (unsigned)i,
+					"[%d] = %ld %u", i, result[i], uresult[i]);
+		}
+	}
+	free(result);
+	free(uresult);
+	free((char *)err_msg);
+	mem_pool_destroy(&pool);
+}
+
+/* n * size would wrap to a small block */
+static void test_conv_alloc_overflow(void)
+{
+	struct pass_to_conv context = {};
+	void *p;
+
+	p = conv_alloc(&context, SIZE_MAX / 8 + 1, 16);
+	CHECK(!p, "conv_alloc returned %p", p);
+	free(p);
+}
+
+/* a strview keeps the bytes after an embedded '\0' all the way */
+static void test_strview(void)
+{
+	struct pass_to_conv context = {};
+	struct node_value val = {};
+	struct dump_buffer buf;
+	struct cfg value, *packed;
+	const char *v, *w, *err_msg = NULL;
+	size_t v_len, w_len, size;
+	char *text;
+	FILE *fp;
+	int ret;
+
+	val.type = VAL_SCALE_STRING;
+	val.string_str = "a\\x00b\\x00";
+	ret = parse_strview(&context, &v, &v_len, &val);
+	CHECK(!ret && v_len == 4 && !memcmp(v, "a\0b\0", 5), "%d %zu",
+			ret, v_len);
+	val.string_str = "a\\x00c\\x00";
+	ret = parse_strview(&context, &w, &w_len, &val);
+	CHECK(!ret && !equal_strview(&v, &v_len, &w, &w_len) &&
+			hash_strview(&v, &v_len) != hash_strview(&w, &w_len),
+			"differ after the '\\0' only");
+	free_strview(&context, &w, &w_len);
+	val.string_str = "a";
+	ret = parse_strview(&context, &w, &w_len, &val);
+	CHECK(!ret && !equal_strview(&v, &v_len, &w, &w_len),
+			"a prefix up to the '\\0'");
+	free_strview(&context, &w, &w_len);
+	CHECK_DUMP(strview, &v, &v_len);
+
+	/* the dump parses back to the same bytes */
+	dump_buffer_init(&buf, NULL, 0, DUMP_BUFFER_GROW);
+	bdump_strview(&buf, &v, &v_len);
+	dump_buffer_finish(&buf);
+	text = buf.data;
+	CHECK(buf.len > 2 && text[0] == '"' && text[buf.len - 1] == '"',
+			"%s", text);
+	text[buf.len - 1] = '\0';
+	val.string_str = text + 1;
+	ret = parse_strview(&context, &w, &w_len, &val);
+	CHECK(!ret && equal_strview(&v, &v_len, &w, &w_len), "dump %s",
+			buf.data);
+	free_strview(&context, &w, &w_len);
+	free(buf.data);
+	free_strview(&context, &v, &v_len);
+
+	/* a member of a struct keeps them through parse, pack and apply */
+	fp = fopen("strview.conf", "w");
+	fprintf(fp, "{ .foo = { .s_foo_s = [ \"1\", \"2\", \"3\", \"4\", "
+			"\"5\", ],\n.ip6p = \"::1/120\", .ip4p = [], "
+			".s_foo_f = [], },\n.bar = { .bar = \"x\", }, .f = 5, "
+			".baz = [],\n.addr = \"01:02:03:04:05:06\", "
+			".name = \"x\\x00yz\", }\n");
+	fclose(fp);
+	ret = config_parse_cfg(&value, "strview.conf", &err_msg);
+	remove("strview.conf");
+	CHECK(!ret, "%s", err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		return;
+	}
+	CHECK(value.name_len == 4 && !memcmp(value.name, "x\0yz", 5),
+			"name of %zu bytes", value.name_len);
+	packed = config_pack_cfg(&value, &size);
+	CHECK(packed && packed->name_len == 4 &&
+			!memcmp(packed->name, "x\0yz", 5) &&
+			config_equal_cfg(&value, packed), "packed name");
+	free(packed);
+	ret = config_apply_cfg(&value, ".name = \"x\\x00yy\"", &err_msg);
+	CHECK(!ret && value.name_len == 4 && value.name[3] == 'y',
+			"%d %s", ret, err_msg);
+	if (ret) {
+		free((char *)err_msg);
+	}
+	config_free_cfg(&value);
+}
+
+static void test_dump_cfg(const char *path)
+{
+	struct dump_buffer a, b;
+	const char *err_msg = NULL;
+	struct cfg value;
+	int ret;
+
+	ret = config_parse_cfg(&value, path, &err_msg);
+	CHECK(!ret, "%s: %s", path, err_msg);
+	if (ret) {
+		free((char *)err_msg);
+		return;
+	}
+	dump_buffer_init(&a, NULL, 0, DUMP_BUFFER_GROW);
+	dump_buffer_init(&b, NULL, 0, DUMP_BUFFER_GROW);
+	config_dump_cfg(dump_buffer_printf, (struct dump_context *)&a, &value);
+	dump_buffer_finish(&a);
+	CHECK(!config_dump_cfg_to_buffer(&b, &value), "%s: to_buffer", path);
+	CHECK(!strcmp(a.data, b.data), "%s: dump\n%s\nto_buffer\n%s",
+			path, a.data, b.data);
+	free(a.data);
+	free(b.data);
+	config_free_cfg(&value);
+}
+
+int main(void)
+{
+	test_dump_equal();
+	test_grisu2();
+	test_to_double();
+	test_to_integer();
+	test_eth_mac();
+	test_inet();
+	test_inet_prefix();
+	test_range_batch_error();
+	test_range_too_large();
+	test_range_batch_bound();
+	test_conv_alloc_overflow();
+	test_strview();
+	test_dump_cfg("../demo_0-example");
+	test_dump_cfg("../demo_0-default");
+	if (failed) {
+		fprintf(stderr, "%d failed\n", failed);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demo_0-converter.h"
+#include "parser.h"
+
+/* built with -fsanitize=thread, a reader must never see a freed snapshot */
+
+#define READERS 4
+#define RELOADS 200
+#define WRITERS 4
+#define ROUTES 8
+
+static int stop, failed;
+
+static void write_cfg(const char *path, int n)
+{
+	FILE *fp = fopen(path, "w");
+	if (!fp) {
+		perror(path);
+		exit(1);
+	}
+	fprintf(fp, "{ .foo = { .s_foo_i = %d, .s_foo_s = [ \"%d\", \"%d\", "
+			"\"%d\", \"%d\", \"%d\", ], .ip6p = \"::1/120\", "
+			".ip4p = [], .s_foo_f = [ %d, ], },\n"
+			".bar = { .bar = \"x\", }, .baz = [], .f = %d,\n"
+			".addr = \"01:02:03:04:05:06\", }\n",
+			n, n, n, n, n, n, n, n);
+	fclose(fp);
+}
+
+/* a table of which route i changes with n, the others stay the same */
+static void write_table(const char *path, int n)
+{
+	FILE *fp = fopen(path, "w");
+	int i;
+
+	if (!fp) {
+		perror(path);
+		exit(1);
+	}
+	fprintf(fp, "{ .name = \"%d\", .routes = [\n", n);
+	for (i = 0; i < ROUTES; ++i) {
+		fprintf(fp, "{ .dst = \"10.0.%d.0/24\", .metric = %d, "
+				".dev = \"%d\", },\n", i,
+				i == n % ROUTES ? n : i, i == n % ROUTES ? n : i);
+	}
+	fprintf(fp, "], }\n");
+	fclose(fp);
+}
+
+/* every member of a snapshot comes from the same file and stays put */
+static void *reader(void *arg)
+{
+	struct config_pin pin;
+	const struct cfg *value;
+	char num[16];
+	int f, i;
+
+	(void)arg;
+	while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+		value = config_current_cfg(&pin);
+		if (value) {
+			f = value->f;
+			snprintf(num, sizeof(num), "%d", f);
+			for (i = 0; i < 5; ++i) {
+				if (strcmp(value->foo.s_foo_s[i], num)) {
+					break;
+				}
+			}
+			if (i < 5 || value->foo.s_foo_i != f ||
+					value->foo.s_foo_f_len != 1 ||
+					value->foo.s_foo_f[0] != f ||
+					value->f != f) {
+				__atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+			}
+		}
+		config_rcu_unpin(&pin);
+	}
+	return NULL;
+}
+
+static void *table_reader(void *arg)
+{
+	struct config_pin pin;
+	const struct table *value;
+	char num[16];
+	int n, i, m;
+
+	(void)arg;
+	while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+		value = config_current_table(&pin);
+		if (value) {
+			n = atoi(value->name);
+			for (i = 0; i < value->routes_len; ++i) {
+				m = i == n % ROUTES ? n : i;
+				snprintf(num, sizeof(num), "%d", m);
+				if (value->routes[i].metric != m ||
+						strcmp(value->routes[i].dev, num)) {
+					break;
+				}
+			}
+			if (value->routes_len != ROUTES || i < ROUTES) {
+				__atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+			}
+		}
+		config_rcu_unpin(&pin);
+	}
+	return NULL;
+}
+
+/*
+ * each reload reparses against the current snapshot, which another
+ * reloading thread must not free meanwhile
+ */
+static void *table_writer(void *arg)
+{
+	const char *err_msg = NULL;
+	char path[32];
+	long w = (long)arg;
+	int i;
+
+	for (i = 0; i < RELOADS / WRITERS; ++i) {
+		snprintf(path, sizeof(path), "table-%ld.conf", (w + i) % 3);
+		if (config_reload_table(path, &err_msg)) {
+			fprintf(stderr, "FAIL reload %s: %s\n", path, err_msg);
+			free((char *)err_msg);
+			__atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void test_concurrent_reloads(void)
+{
+	pthread_t readers[READERS], writers[WRITERS];
+	const char *err_msg = NULL;
+	char path[32];
+	long i;
+
+	for (i = 0; i < 3; ++i) {
+		snprintf(path, sizeof(path), "table-%ld.conf", i);
+		write_table(path, i);
+	}
+	__atomic_store_n(&stop, 0, __ATOMIC_RELEASE);
+	for (i = 0; i < READERS; ++i) {
+		pthread_create(&readers[i], NULL, table_reader, NULL);
+	}
+	for (i = 0; i < WRITERS; ++i) {
+		pthread_create(&writers[i], NULL, table_writer, (void *)i);
+	}
+	for (i = 0; i < WRITERS; ++i) {
+		pthread_join(writers[i], NULL);
+	}
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < READERS; ++i) {
+		pthread_join(readers[i], NULL);
+	}
+	config_reload_table(NULL, &err_msg);
+	for (i = 0; i < 3; ++i) {
+		snprintf(path, sizeof(path), "table-%ld.conf", i);
+		remove(path);
+	}
+}
+
+int main(void)
+{
+	pthread_t threads[READERS];
+	const char *err_msg = NULL;
+	int i;
+
+	write_cfg("rcu-1.conf", 1);
+	write_cfg("rcu-2.conf", 2);
+	for (i = 0; i < READERS; ++i) {
+		pthread_create(&threads[i], NULL, reader, NULL);
+	}
+	for (i = 0; i < RELOADS; ++i) {
+		if (config_reload_cfg(i & 1 ? "rcu-2.conf" : "rcu-1.conf",
+				&err_msg)) {
+			fprintf(stderr, "FAIL reload %d: %s\n", i, err_msg);
+			free((char *)err_msg);
+			__atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < READERS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	config_reload_cfg(NULL, &err_msg);
+	remove("rcu-1.conf");
+	remove("rcu-2.conf");
+	test_concurrent_reloads();
+	if (failed) {
+		fprintf(stderr, "%d failed\n", failed);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
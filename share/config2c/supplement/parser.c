@@ -4,8 +4,20 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #include "parser.h"
 
 typedef void *yyscan_t;
@@ -55,6 +67,185 @@ void mem_pool_destroy(struct mem_pool *p)
 	}
 }
 
+/* size more bytes in blocks more blocks, both may wrap to subtract */
+static void allocator_account(struct config_allocator *a, size_t size,
+		size_t blocks)
+{
+	size_t bytes, peak;
+
+	bytes = __atomic_add_fetch(&a->bytes, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&a->blocks, blocks, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&a->peak, __ATOMIC_RELAXED);
+	while (bytes > peak && !__atomic_compare_exchange_n(&a->peak, &peak,
+				bytes, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+void *config_allocator_alloc(struct config_allocator *a, size_t n,
+		size_t size, int zero)
+{
+	void *p;
+
+	if (size && n > SIZE_MAX / size) {
+		return NULL;
+	}
+	if (zero && a->calloc) {
+		p = a->calloc(a->user, n, size);
+	} else {
+		p = a->alloc(a->user, n * size);
+		if (p && zero) {
+			memset(p, 0, n * size);
+		}
+	}
+	if (p) {
+		allocator_account(a, n * size, 1);
+	}
+	return p;
+}
+
+void *config_allocator_realloc(struct config_allocator *a, void *p,
+		size_t old_size, size_t size)
+{
+	void *q;
+
+	if (!p) {
+		return config_allocator_alloc(a, 1, size, 0);
+	}
+	if (a->realloc) {
+		q = a->realloc(a->user, p, old_size, size);
+	} else {
+		q = a->alloc(a->user, size);
+		if (q) {
+			memcpy(q, p, old_size < size ? old_size : size);
+			a->free(a->user, p, old_size);
+		}
+	}
+	if (q) {
+		allocator_account(a, size - old_size, 0);
+	}
+	return q;
+}
+
+void config_allocator_free(struct config_allocator *a, void *p, size_t size)
+{
+	if (!p) {
+		return;
+	}
+	a->free(a->user, p, size);
+	allocator_account(a, -size, -1);
+}
+
+#define ARENA_CHUNK_MIN	(4 << 10)
+#define ARENA_CHUNK_MAX	(1 << 20)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
+
+struct config_arena {
+	struct arena_chunk *head;	/* being carved */
+	size_t next_size;
+	size_t total;
+	struct config_allocator *alloc;
+};
+
+static void *arena_get(struct config_allocator *alloc, size_t size)
+{
+	return alloc ? config_allocator_alloc(alloc, 1, size, 0) : malloc(size);
+}
+
+static void arena_put(struct config_allocator *alloc, void *p, size_t size)
+{
+	if (alloc) {
+		config_allocator_free(alloc, p, size);
+	} else {
+		free(p);
+	}
+}
+
+struct config_arena *config_arena_new(struct config_allocator *alloc)
+{
+	struct config_arena *arena = arena_get(alloc, sizeof(*arena));
+	if (!arena) {
+		return NULL;
+	}
+	arena->head = NULL;
+	arena->next_size = ARENA_CHUNK_MIN;
+	arena->total = 0;
+	arena->alloc = alloc;
+	return arena;
+}
+
+void config_arena_free(struct config_arena *arena)
+{
+	struct arena_chunk *c, *next;
+	if (!arena) {
+		return;
+	}
+	for (c = arena->head; c; c = next) {
+		next = c->next;
+		arena_put(arena->alloc, c, sizeof(*c) + c->size);
+	}
+	arena_put(arena->alloc, arena, sizeof(*arena));
+}
+
+void *config_arena_alloc(struct config_arena *arena, size_t size,
+		size_t align)
+{
+	struct arena_chunk *c = arena->head;
+	size_t off, chunk;
+
+	if (c) {
+		off = (c->used + align - 1) & ~(align - 1);
+		if (off <= c->size && size <= c->size - off) {
+			c->used = off + size;
+			return (char *)c->data + off;
+		}
+	}
+	/* a large block gets a chunk of its own behind the one being carved */
+	if (size > arena->next_size / 4) {
+		if (size > SIZE_MAX - sizeof(*c)) {
+			return NULL;
+		}
+		c = arena_get(arena->alloc, sizeof(*c) + size);
+		if (!c) {
+			return NULL;
+		}
+		c->size = c->used = size;
+		if (arena->head) {
+			c->next = arena->head->next;
+			arena->head->next = c;
+		} else {
+			c->next = NULL;
+			arena->head = c;
+		}
+		arena->total += sizeof(*c) + size;
+		return c->data;
+	}
+	chunk = arena->next_size;
+	if (arena->next_size < ARENA_CHUNK_MAX) {
+		arena->next_size *= 2;
+	}
+	c = arena_get(arena->alloc, sizeof(*c) + chunk);
+	if (!c) {
+		return NULL;
+	}
+	c->size = chunk;
+	c->used = size;
+	c->next = arena->head;
+	arena->head = c;
+	arena->total += sizeof(*c) + chunk;
+	return c->data;
+}
+
+size_t config_arena_size(const struct config_arena *arena)
+{
+	return arena ? arena->total : 0;
+}
+
 const char *make_message(const char *fmt, ...)
 {
 	int size = 0;
@@ -171,6 +362,29 @@ err:
 	return NULL;
 }
 
+int conv_parsed(struct mem_pool *pool, const struct node_value *tree,
+		struct config_allocator *alloc, struct config_arena *arena,
+		conv_func func, void *value, const void *old,
+		const char **err_msg)
+{
+	struct pass_to_conv context;
+	int ret;
+
+	memset(&context, 0, sizeof(context));
+	context.pool = pool;
+	context.arena = arena;
+	context.alloc = alloc;
+	ret = func(&context, value, old, tree);
+	if (ret) {
+		if (context.msg) {
+			*err_msg = make_msg_loc(context.node, context.msg);
+		} else {
+			*err_msg = make_msg_loc(context.node, "");
+		}
+	}
+	return ret;
+}
+
 void init_pass_to_bison(struct pass_to_bison *ctx, struct mem_pool *pool)
 {
 	ctx->pool = pool;
@@ -182,104 +396,2220 @@ void init_pass_to_bison(struct pass_to_bison *ctx, struct mem_pool *pool)
 	ctx->myerrno = 0;
 	ctx->err_reason = NULL;
 	ctx->output = NULL;
+	ctx->anchors = NULL;
+	ctx->path = NULL;
+	ctx->cache = NULL;
+	ctx->deps = NULL;
+	ctx->depth = 0;
 }
 
-static const char *msg_conflict = "internal error, got impossible result: "
-	"ok: %d, myerror: %d, output: %p";
+void *conv_share_find(struct pass_to_conv *ctx,
+		const struct node_value *input, const char *type)
+{
+	const struct conv_share *p;
+	for (p = ctx->shared; p; p = p->next) {
+		if (p->node == input->members && !strcmp(p->type, type)) {
+			return p->value;
+		}
+	}
+	return NULL;
+}
 
+int conv_share_add(struct pass_to_conv *ctx, const struct node_value *input,
+		const char *type, void *value)
+{
+	struct conv_share *p = mem_pool_alloc(ctx->pool, sizeof(*p));
+	if (!p) {
+		return -ENOMEM;
+	}
+	p->node = input->members;
+	p->type = type;
+	p->value = value;
+	p->next = ctx->shared;
+	ctx->shared = p;
+	return 0;
+}
 
+/*
+ * the next element of a run, a range element is built in it->cur, the
+ * first one too so that "010...011" is 8, 9 for every element type
+ */
+const struct node_value *elems_iter_run(struct elems_iter *it)
+{
+	const struct node_run *run = it->elem->value->run;
+	const struct node_value *val = run->value;
 
-int yacc_parse_file(const char *path, const char **err_msg,
-		struct pass_to_bison *ctx)
+	it->same = !run->step && it->k;
+	if (run->step) {
+		snprintf(it->cur_str, sizeof(it->cur_str), "%lld",
+				run->first + it->k * run->step);
+		it->cur.parent = val->parent;
+		it->cur.index = val->index + it->k;
+		val = &it->cur;
+	}
+	if (++it->k == run->count) {
+		it->elem = it->elem->next;
+		it->k = 0;
+	}
+	return val;
+}
+
+/* the lexer only passes [A-Za-z0-9+/] in b64"..." */
+static const unsigned char base64_value[128] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 62,  0,  0,  0, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61,  0,  0,  0,  0,  0,  0,
+	 0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,  0,  0,  0,  0,  0,
+	 0, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,  0,  0,  0,  0,  0,
+};
+
+#define b64(c) base64_value[(unsigned char)(c) & 0x7f]
+
+/* number of base64 digits without the trailing '=' */
+static size_t base64_digits(const char *in, size_t len)
 {
-	FILE *fp;
-	int ret;
-	yyscan_t scanner;
+	while (len && in[len - 1] == '=') {
+		--len;
+	}
+	return len;
+}
 
-	*err_msg = NULL;
-	fp = fopen(path, "r");
-	if (!fp) {
-		ret = -errno;
-		*err_msg = make_message("failed to open config file %s.\n",
-				path);
-		goto fail_open;
+/* return the decoded size of a blob, -1 if malformed */
+static long blob_size(const struct node_value *val)
+{
+	size_t len = strlen(val->blob_str), n;
+
+	if (val->type == VAL_BLOB_HEX) {
+		return len % 2 ? -1 : (long)(len / 2);
 	}
-	ret = yylex_init(&scanner);
-	if (ret) {
-		ret = -errno;
-		*err_msg = make_message("failed to create scanner for lex");
-		goto err_yylex_init;
+	n = base64_digits(val->blob_str, len);
+	if (n % 4 == 1 || (n != len && len % 4)) {
+		return -1;
 	}
-	yyset_in(fp, scanner);
-	
-	yyparse(scanner, ctx);
+	return n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0);
+}
 
-	if ((ctx->ok && (ctx->myerrno || !ctx->output)) ||
-			(!ctx->ok && (!ctx->myerrno || ctx->output))) {
-		ret = -EINVAL;
-		*err_msg = make_message(msg_conflict, ctx->ok,
-				ctx->myerrno, ctx->output);
-		goto err_yacc;
+long blob_elems(struct pass_to_conv *ctx, const struct node_value *val,
+		size_t elem_size)
+{
+	long size = blob_size(val);
+
+	if (size < 0) {
+		ctx->node = val;
+		ctx->msg = val->type == VAL_BLOB_HEX ?
+			"odd number of hex digits." : "invalid base64 length.";
+		return -EINVAL;
 	}
-	if (!ctx->output) {
-		ret = ctx->myerrno;
-		*err_msg = ctx->err_reason;
-		goto err_yacc;
+	if (size % elem_size) {
+		ctx->node = val;
+		ctx->msg = "blob size is not a multiple of element size.";
+		return -EINVAL;
 	}
+	return size / elem_size;
+}
 
-	yylex_destroy(scanner);
-	fclose(fp);
-	return 0;
+/* 8 hex digits to 4 bytes, a nibble per byte then a byte per pair */
+static void hex_eight(unsigned char *out, const char *in)
+{
+	uint64_t v;
+	uint32_t r;
 
-err_yacc:
-	yylex_destroy(scanner);
-err_yylex_init:
-	fclose(fp);
-fail_open:
-	return ret;
+	memcpy(&v, in, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	/* '0'-'9' are 0x3?, letters have bit 6 set and a..f map to 1..6 */
+	v = (v & 0x0f0f0f0f0f0f0f0full) +
+		((v >> 6) & 0x0101010101010101ull) * 9;
+	v = ((v & 0x000f000f000f000full) << 4) |
+		((v >> 8) & 0x000f000f000f000full);
+	v = (v | (v >> 8)) & 0x0000ffff0000ffffull;
+	r = v | (v >> 16);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	r = __builtin_bswap32(r);
+#endif
+	memcpy(out, &r, sizeof(r));
 }
 
-int yacc_parse_string(const char *str, const char **err_msg,
-		struct pass_to_bison *ctx)
+static int hex_digit(char c)
 {
-	yyscan_t scanner;
-	void *buffer_state;
-	int ret;
+	return (c & 0xf) + (c >> 6) * 9;
+}
 
-	*err_msg = NULL;
-	ret = yylex_init(&scanner);
-	if (ret) {
-		ret = -errno;
-		goto err_yylex_init;
+static void decode_hex(unsigned char *out, const char *in, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= size; i += 4) {
+		hex_eight(out + i, in + i * 2);
 	}
-	buffer_state = yy_scan_string(str, scanner);
-	if (!buffer_state) {
-		ret = -ENOMEM;
-		goto err_scan_string;
+	for (; i < size; ++i) {
+		out[i] = hex_digit(in[i * 2]) << 4 | hex_digit(in[i * 2 + 1]);
 	}
+}
 
-	yyparse(scanner, ctx);
-	
-	if ((ctx->ok && (ctx->myerrno || !ctx->output)) ||
-			(!ctx->ok && (!ctx->myerrno || ctx->output))) {
-		ret = -EINVAL;
-		*err_msg = make_message(msg_conflict, ctx->ok,
-				ctx->myerrno, ctx->output);
-		goto err_yacc;
+static void decode_base64(unsigned char *out, const char *in, size_t size)
+{
+	uint32_t v;
+	size_t i;
+
+	for (i = 0; i + 3 <= size; i += 3, in += 4) {
+		v = b64(in[0]) << 18 | b64(in[1]) << 12 | b64(in[2]) << 6 |
+			b64(in[3]);
+		out[i] = v >> 16;
+		out[i + 1] = v >> 8;
+		out[i + 2] = v;
 	}
-	if (!ctx->output) {
-		ret = ctx->myerrno;
-		*err_msg = ctx->err_reason;
-		goto err_yacc;
+	if (i < size) { /* 2 or 3 digits left */
+		v = b64(in[0]) << 18 | b64(in[1]) << 12;
+		if (i + 1 < size) {
+			v |= b64(in[2]) << 6;
+			out[i + 1] = v >> 8;
+		}
+		out[i] = v >> 16;
 	}
-	
-	yylex_destroy(scanner);
+}
+
+void blob_decode(void *out, const struct node_value *val, long n,
+		size_t elem_size)
+{
+	size_t size = n * elem_size;
+
+	if (val->type == VAL_BLOB_HEX) {
+		decode_hex(out, val->blob_str, size);
+	} else {
+		decode_base64(out, val->blob_str, size);
+	}
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	if (elem_size > 1) {
+		unsigned char *p;
+		for (p = out; p < (unsigned char *)out + size; p += elem_size) {
+			rev_str((char *)p, (char *)p + elem_size - 1);
+		}
+	}
+#endif
+}
+
+void dump_buffer_init(struct dump_buffer *buf, char *mem, size_t size,
+		int flags)
+{
+	buf->data = mem;
+	buf->len = 0;
+	buf->cap = mem ? size : 0;
+	buf->flags = flags;
+	buf->err = 0;
+}
+
+/* make room for n more bytes and '\0', return 0 if succeeded */
+int dump_buffer_grow(struct dump_buffer *buf, size_t n)
+{
+	size_t cap;
+	char *data;
+
+	if (buf->err) {
+		return buf->err;
+	}
+	if (!(buf->flags & DUMP_BUFFER_GROW)) {
+		buf->err = -ENOSPC;
+		return buf->err;
+	}
+	cap = buf->cap < 256 ? 256 : buf->cap;
+	while (cap - buf->len <= n) {
+		cap *= 2;
+	}
+	data = realloc(buf->data, cap);
+	if (!data) {
+		buf->err = -ENOMEM;
+		return buf->err;
+	}
+	buf->data = data;
+	buf->cap = cap;
 	return 0;
+}
 
-err_yacc:
-err_scan_string:
-	yylex_destroy(scanner);
-err_yylex_init:
-	return ret;
+int dump_buffer_finish(struct dump_buffer *buf)
+{
+	if (buf->cap > buf->len) {
+		buf->data[buf->len] = '\0';
+	}
+	return buf->err;
+}
+
+void dump_buffer_indent(struct dump_buffer *buf, int indents)
+{
+	static const char spaces[] = "                                "
+		"                                ";
+	size_t n;
+
+	if (buf->flags & DUMP_BUFFER_COMPACT) {
+		return;
+	}
+	for (n = indents * 2; n > sizeof(spaces) - 1; n -= sizeof(spaces) - 1) {
+		dump_buffer_put(buf, spaces, sizeof(spaces) - 1);
+	}
+	dump_buffer_put(buf, spaces, n);
+}
+
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+void dump_buffer_put_ull(struct dump_buffer *buf, unsigned long long val)
+{
+	char str[20];
+	char *p = str + sizeof(str);
+
+	while (val >= 100) {
+		p -= 2;
+		memcpy(p, digit_pairs + val % 100 * 2, 2);
+		val /= 100;
+	}
+	if (val >= 10) {
+		p -= 2;
+		memcpy(p, digit_pairs + val * 2, 2);
+	} else {
+		*--p = '0' + val;
+	}
+	dump_buffer_put(buf, p, str + sizeof(str) - p);
+}
+
+void dump_buffer_put_ll(struct dump_buffer *buf, long long val)
+{
+	if (val < 0) {
+		dump_buffer_putc(buf, '-');
+		dump_buffer_put_ull(buf, -(unsigned long long)val);
+	} else {
+		dump_buffer_put_ull(buf, val);
+	}
+}
+
+void dump_buffer_printf(struct dump_context *ctx, const char *fmt, ...)
+{
+	struct dump_buffer *buf = (struct dump_buffer *)ctx;
+	size_t left;
+	va_list ap;
+	int n;
+
+	left = buf->cap - buf->len;
+	va_start(ap, fmt);
+	n = vsnprintf(buf->data ? buf->data + buf->len : NULL, left, fmt, ap);
+	va_end(ap);
+	if (n < 0) {
+		return;
+	}
+	if ((size_t)n >= left) {
+		if (dump_buffer_grow(buf, n)) {
+			buf->len = buf->cap > buf->len ? buf->cap - 1 : buf->len;
+			return;
+		}
+		va_start(ap, fmt);
+		vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, ap);
+		va_end(ap);
+	}
+	buf->len += n;
+}
+
+void config_hash_free(struct config_hash *tree)
+{
+	free(tree->hash);
+	free(tree->next);
+	tree->hash = NULL;
+	tree->next = NULL;
+	tree->n = 0;
+	tree->cap = 0;
+	tree->err = 0;
+}
+
+long config_hash_push(struct config_hash *tree)
+{
+	uint64_t *hash;
+	long *next;
+	long cap;
+
+	if (!tree || tree->err) {
+		return -1;
+	}
+	if (tree->n == tree->cap) {
+		cap = tree->cap ? tree->cap * 2 : 64;
+		hash = realloc(tree->hash, cap * sizeof(*hash));
+		if (!hash) {
+			goto error;
+		}
+		tree->hash = hash;
+		next = realloc(tree->next, cap * sizeof(*next));
+		if (!next) {
+			goto error;
+		}
+		tree->next = next;
+		tree->cap = cap;
+	}
+	return tree->n++;
+error:
+	tree->err = -ENOMEM;
+	return -1;
+}
+
+uint64_t config_hash_bytes(uint64_t h, const void *p, size_t n)
+{
+	const unsigned char *c = p;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		h = (h ^ c[i]) * 1099511628211ULL;
+	}
+	return h;
 }
 
+/* a word at a time, node_fingerprint() hashes every byte of the tree */
+static uint64_t fingerprint_str(uint64_t h, const char *str)
+{
+	size_t len = strlen(str), n;
+	uint64_t w;
+
+	for (n = len; n >= sizeof(w); n -= sizeof(w), str += sizeof(w)) {
+		memcpy(&w, str, sizeof(w));
+		h = config_hash_mix(h, w);
+	}
+	w = 0;
+	memcpy(&w, str, n);
+	h = config_hash_mix(h, w);
+	return config_hash_mix(h, len);
+}
+
+/* open addressing on the address of the node */
+struct node_fps {
+	struct node_fp {
+		const struct node_value *node;
+		uint64_t fp;
+	} *slot;
+	size_t n;
+	size_t mask;
+};
+
+static struct node_fp *fps_find(const struct node_fps *fps,
+		const struct node_value *value)
+{
+	size_t i = ((uint64_t)(uintptr_t)value * 0x9e3779b97f4a7c15ULL >> 32) &
+		fps->mask;
+
+	while (fps->slot[i].node && fps->slot[i].node != value) {
+		i = (i + 1) & fps->mask;
+	}
+	return &fps->slot[i];
+}
+
+/* the old table is left to the pool */
+static int fps_resize(struct pass_to_conv *ctx, size_t cap)
+{
+	struct node_fps *fps = ctx->fps;
+	struct node_fp *old = fps->slot;
+	size_t i, n = fps->slot ? fps->mask + 1 : 0;
+
+	fps->slot = mem_pool_alloc(ctx->pool, cap * sizeof(*fps->slot));
+	if (!fps->slot) {
+		fps->slot = old;
+		return -ENOMEM;
+	}
+	memset(fps->slot, 0, cap * sizeof(*fps->slot));
+	fps->mask = cap - 1;
+	for (i = 0; i < n; ++i) {
+		if (old[i].node) {
+			*fps_find(fps, old[i].node) = old[i];
+		}
+	}
+	return 0;
+}
+
+/* remembers the fingerprint of a list of members unless memory is short */
+static void fps_add(struct pass_to_conv *ctx, const struct node_value *value,
+		uint64_t fp)
+{
+	struct node_fp *p;
+
+	if (!ctx->fps) {
+		ctx->fps = mem_pool_alloc(ctx->pool, sizeof(*ctx->fps));
+		if (!ctx->fps) {
+			return;
+		}
+		ctx->fps->slot = NULL;
+		ctx->fps->n = 0;
+		if (fps_resize(ctx, 1024)) {
+			ctx->fps = NULL;
+			return;
+		}
+	}
+	if (2 * (ctx->fps->n + 1) > ctx->fps->mask + 1 &&
+			fps_resize(ctx, 2 * (ctx->fps->mask + 1))) {
+		return;
+	}
+	p = fps_find(ctx->fps, value);
+	p->node = value;
+	p->fp = fp;
+	++ctx->fps->n;
+}
+
+uint64_t node_fingerprint(struct pass_to_conv *ctx,
+		const struct node_value *value)
+{
+	const struct node_members *memb;
+	const struct node_elems *elem;
+	const struct node_run *run;
+	const struct node_fp *p;
+	uint64_t h;
+
+	if (value->type == VAL_MEMBERS && ctx->fps) {
+		p = fps_find(ctx->fps, value);
+		if (p->node) {
+			return p->fp;
+		}
+	}
+	h = config_hash_mix(CONFIG_HASH_BASIS,
+			(uint64_t)value->type << 1 | value->merged);
+	switch (value->type) {
+	case VAL_MEMBERS:
+		for (memb = value->members; memb; memb = memb->next) {
+			h = fingerprint_str(h, memb->name);
+			h = config_hash_mix(h, node_fingerprint(ctx, memb->value));
+		}
+		break;
+	case VAL_ELEMS:
+		for (elem = value->elems; elem; elem = elem->next) {
+			h = config_hash_mix(h, node_fingerprint(ctx, elem->value));
+		}
+		break;
+	case VAL_RUN:
+		run = value->run;
+		h = config_hash_mix(h, node_fingerprint(ctx, run->value));
+		h = config_hash_mix(h, run->count);
+		h = config_hash_mix(h, run->first);
+		h = config_hash_mix(h, run->step);
+		break;
+	default:
+		/* the text of a scalar or blob */
+		h = fingerprint_str(h, value->char_str);
+		break;
+	}
+	h = h ? h : 1;
+	if (value->type == VAL_MEMBERS) {
+		fps_add(ctx, value, h);
+	}
+	return h;
+}
+
+static size_t diff_vappend(struct config_diff *d, const char *fmt, va_list ap)
+{
+	size_t len = d->len;
+	size_t cap;
+	va_list aq;
+	char *path;
+	int n;
+
+	va_copy(aq, ap);
+	n = vsnprintf(d->path ? d->path + len : NULL,
+			d->path ? d->cap - len : 0, fmt, aq);
+	va_end(aq);
+	if (n < 0) {
+		return len;
+	}
+	if (!d->path || (size_t)n >= d->cap - len) {
+		cap = d->cap ? d->cap : 64;
+		while (cap - len <= (size_t)n) {
+			cap *= 2;
+		}
+		path = realloc(d->path, cap);
+		if (!path) {
+			d->err = -ENOMEM;
+			return len;
+		}
+		d->path = path;
+		d->cap = cap;
+		vsnprintf(d->path + len, d->cap - len, fmt, ap);
+	}
+	d->len += n;
+	return len;
+}
+
+size_t config_diff_enter(struct config_diff *d, const char *fmt, ...)
+{
+	va_list ap;
+	size_t len;
+
+	va_start(ap, fmt);
+	len = diff_vappend(d, fmt, ap);
+	va_end(ap);
+	return len;
+}
+
+void config_diff_leave(struct config_diff *d, size_t len)
+{
+	d->len = len;
+	if (d->path) {
+		d->path[len] = '\0';
+	}
+}
+
+void config_diff_report(struct config_diff *d, const char *fmt, ...)
+{
+	size_t len = d->len;
+	va_list ap;
+
+	if (fmt) {
+		va_start(ap, fmt);
+		diff_vappend(d, fmt, ap);
+		va_end(ap);
+	}
+	d->changed(d->path ? d->path : "", d->arg);
+	++d->count;
+	config_diff_leave(d, len);
+}
+
+static const char *msg_conflict = "internal error, got impossible result: "
+	"ok: %d, myerror: %d, output: %p";
+
+
+
+int yacc_parse_file(const char *path, const char **err_msg,
+		struct pass_to_bison *ctx)
+{
+	FILE *fp;
+	int ret;
+	yyscan_t scanner;
+
+	*err_msg = NULL;
+	fp = fopen(path, "r");
+	if (!fp) {
+		ret = -errno;
+		*err_msg = make_message("failed to open config file %s.\n",
+				path);
+		goto fail_open;
+	}
+	ret = yylex_init(&scanner);
+	if (ret) {
+		ret = -errno;
+		*err_msg = make_message("failed to create scanner for lex");
+		goto err_yylex_init;
+	}
+	yyset_in(fp, scanner);
+	ctx->path = path;
+	
+	yyparse(scanner, ctx);
+
+	if ((ctx->ok && (ctx->myerrno || !ctx->output)) ||
+			(!ctx->ok && (!ctx->myerrno || ctx->output))) {
+		ret = -EINVAL;
+		*err_msg = make_message(msg_conflict, ctx->ok,
+				ctx->myerrno, ctx->output);
+		goto err_yacc;
+	}
+	if (!ctx->output) {
+		ret = ctx->myerrno;
+		*err_msg = ctx->err_reason;
+		goto err_yacc;
+	}
+
+	yylex_destroy(scanner);
+	fclose(fp);
+	return 0;
+
+err_yacc:
+	yylex_destroy(scanner);
+err_yylex_init:
+	fclose(fp);
+fail_open:
+	return ret;
+}
+
+int yacc_parse_string(const char *str, const char **err_msg,
+		struct pass_to_bison *ctx)
+{
+	yyscan_t scanner;
+	void *buffer_state;
+	int ret;
+
+	*err_msg = NULL;
+	ret = yylex_init(&scanner);
+	if (ret) {
+		ret = -errno;
+		goto err_yylex_init;
+	}
+	buffer_state = yy_scan_string(str, scanner);
+	if (!buffer_state) {
+		ret = -ENOMEM;
+		goto err_scan_string;
+	}
+
+	yyparse(scanner, ctx);
+	
+	if ((ctx->ok && (ctx->myerrno || !ctx->output)) ||
+			(!ctx->ok && (!ctx->myerrno || ctx->output))) {
+		ret = -EINVAL;
+		*err_msg = make_message(msg_conflict, ctx->ok,
+				ctx->myerrno, ctx->output);
+		goto err_yacc;
+	}
+	if (!ctx->output) {
+		ret = ctx->myerrno;
+		*err_msg = ctx->err_reason;
+		goto err_yacc;
+	}
+	
+	yylex_destroy(scanner);
+	return 0;
+
+err_yacc:
+err_scan_string:
+	yylex_destroy(scanner);
+err_yylex_init:
+	return ret;
+}
+
+
+#define INCLUDE_MAX_DEPTH	16
+
+/* an included file, valid while the file and its own includes are unchanged */
+struct cached_file {
+	struct cached_file *next;
+	const char *path;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	unsigned long gen;		/* times parsed */
+	struct cache_dep *deps;
+	struct node_value *value;
+};
+
+struct cache_dep {
+	struct cache_dep *next;
+	struct cached_file *file;
+	unsigned long gen;
+};
+
+struct parse_cache {
+	struct mem_pool pool;
+	struct cached_file *files;
+};
+
+struct parse_cache *parse_cache_new(void)
+{
+	struct parse_cache *cache = malloc(sizeof(*cache));
+	if (!cache) {
+		return NULL;
+	}
+	mem_pool_init(&cache->pool);
+	cache->files = NULL;
+	return cache;
+}
+
+void parse_cache_free(struct parse_cache *cache)
+{
+	if (cache) {
+		mem_pool_destroy(&cache->pool);
+		free(cache);
+	}
+}
+
+static int cache_valid(const struct cached_file *p, const struct stat *st)
+{
+	const struct cache_dep *dep;
+	struct stat dep_st;
+	if (p->dev != st->st_dev || p->ino != st->st_ino ||
+			p->size != st->st_size ||
+			p->mtime.tv_sec != st->st_mtim.tv_sec ||
+			p->mtime.tv_nsec != st->st_mtim.tv_nsec) {
+		return 0;
+	}
+	for (dep = p->deps; dep; dep = dep->next) {
+		if (dep->gen != dep->file->gen ||
+				stat(dep->file->path, &dep_st) ||
+				!cache_valid(dep->file, &dep_st)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* the entry of path, *old is set instead if it is out of date */
+static struct cached_file *cache_lookup(struct parse_cache *cache,
+		const char *path, const struct stat *st, struct cached_file **old)
+{
+	struct cached_file *p;
+	*old = NULL;
+	for (p = cache->files; p; p = p->next) {
+		if (strcmp(p->path, path)) {
+			continue;
+		}
+		if (cache_valid(p, st)) {
+			return p;
+		}
+		*old = p;
+		return NULL;
+	}
+	return NULL;
+}
+
+static struct cached_file *cache_store(struct parse_cache *cache,
+		struct cached_file *old, const char *path, const struct stat *st,
+		struct pass_to_bison *sub)
+{
+	struct cached_file *p = old;
+	char *path_copy;
+	if (!p) {
+		p = mem_pool_alloc(&cache->pool, sizeof(*p));
+		path_copy = mem_pool_alloc(&cache->pool, strlen(path) + 1);
+		if (!p || !path_copy) {
+			return NULL;
+		}
+		strcpy(path_copy, path);
+		p->path = path_copy;
+		p->gen = 0;
+		p->next = cache->files;
+		cache->files = p;
+	}
+	/* an out of date tree stays in the pool until the cache is freed */
+	p->dev = st->st_dev;
+	p->ino = st->st_ino;
+	p->size = st->st_size;
+	p->mtime = st->st_mtim;
+	++p->gen;
+	p->deps = sub->deps;
+	p->value = sub->output;
+	return p;
+}
+
+/* file is included by the file being parsed, which is to be cached */
+static int cache_add_dep(struct pass_to_bison *opaque, struct cached_file *file)
+{
+	struct cache_dep *dep = mem_pool_alloc(&opaque->cache->pool,
+			sizeof(*dep));
+	if (!dep) {
+		return -ENOMEM;
+	}
+	dep->file = file;
+	dep->gen = file->gen;
+	dep->next = opaque->deps;
+	opaque->deps = dep;
+	return 0;
+}
+
+static char *include_path(const char *base, const char *name)
+{
+	const char *slash = base ? strrchr(base, '/') : NULL;
+	char *path;
+	size_t dir_len;
+	if (name[0] == '/' || !slash) {
+		return strdup(name);
+	}
+	dir_len = slash - base + 1;
+	path = malloc(dir_len + strlen(name) + 1);
+	if (path) {
+		memcpy(path, base, dir_len);
+		strcpy(path + dir_len, name);
+	}
+	return path;
+}
+
+static void include_error(struct pass_to_bison *opaque, int err,
+		const char *path, const char *msg)
+{
+	opaque->ok = 0;
+	opaque->myerrno = err;
+	opaque->err_reason = make_message("%d:%d : include %s: %s",
+			opaque->first_line, opaque->first_column, path,
+			msg ? msg : "");
+}
+
+struct node_value *include_file(struct pass_to_bison *opaque, const char *name)
+{
+	struct pass_to_bison sub;
+	struct cached_file *file = NULL, *old = NULL;
+	struct node_value *value, *ret = NULL;
+	const char *err_msg = NULL;
+	struct stat st;
+	char *path;
+
+	if (!opaque->ok) {
+		return NULL;
+	}
+	if (opaque->depth >= INCLUDE_MAX_DEPTH) {
+		include_error(opaque, -ELOOP, name, "nested too deeply");
+		return NULL;
+	}
+	path = include_path(opaque->path, name);
+	if (!path) {
+		goto nomem;
+	}
+	if (stat(path, &st)) {
+		include_error(opaque, -errno, path, strerror(errno));
+		goto out;
+	}
+	if (opaque->cache) {
+		file = cache_lookup(opaque->cache, path, &st, &old);
+	}
+	if (!file) {
+		init_pass_to_bison(&sub, opaque->cache ?
+				&opaque->cache->pool : opaque->pool);
+		sub.cache = opaque->cache;
+		sub.depth = opaque->depth + 1;
+		if (yacc_parse_file(path, &err_msg, &sub)) {
+			include_error(opaque, sub.myerrno ? sub.myerrno : -EINVAL,
+					path, err_msg);
+			free((char *)err_msg);
+			goto out;
+		}
+		value = sub.output;
+		if (opaque->cache) {
+			file = cache_store(opaque->cache, old, path, &st, &sub);
+			if (!file) {
+				goto nomem;
+			}
+		}
+	}
+	if (file) {
+		value = file->value;
+		if (opaque->depth && cache_add_dep(opaque, file)) {
+			goto nomem;
+		}
+	}
+	/*
+	 * a new node for this place sharing the members or elements, like a
+	 * reference to an anchor
+	 */
+	ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
+	if (!ret) {
+		goto nomem;
+	}
+	*ret = *value;
+	ret->anchored = 1;
+	ret->parent = NULL;
+out:
+	free(path);
+	return ret;
+
+nomem:
+	opaque->ok = 0;
+	opaque->myerrno = -ENOMEM;
+	goto out;
+}
+
+static struct node_members *find_member(struct node_members *p,
+		const char *name)
+{
+	for (; p; p = p->next) {
+		if (!strcmp(p->name, name)) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+static int push_member(struct mem_pool *pool, struct node_members **list,
+		const char *name, struct node_value *value)
+{
+	struct node_members *p = mem_pool_alloc(pool, sizeof(*p));
+	if (!p) {
+		return -ENOMEM;
+	}
+	p->name = name;
+	p->value = value;
+	p->next = *list;
+	*list = p;
+	return 0;
+}
+
+/*
+ * Members of the layers, and the nodes a parse_cache keeps for an include,
+ * are shared with their own trees, a merged value reparents copies of them.
+ */
+static struct node_value *layer_member(struct mem_pool *pool,
+		const struct node_value *value, int lower)
+{
+	struct node_value *ret = mem_pool_alloc(pool, sizeof(*ret));
+	if (!ret) {
+		return NULL;
+	}
+	*ret = *value;
+	ret->lower = lower;
+	return ret;
+}
+
+struct node_value *merge_node_value(struct mem_pool *pool,
+		struct node_value *base, struct node_value *over)
+{
+	struct node_members *list = NULL, *p, *q;
+	struct node_value *ret, *value;
+
+	if (base->type != VAL_MEMBERS || over->type != VAL_MEMBERS) {
+		return over;
+	}
+	ret = mem_pool_alloc(pool, sizeof(*ret));
+	if (!ret) {
+		return NULL;
+	}
+	for (p = over->members; p; p = p->next) {
+		q = find_member(base->members, p->name);
+		if (q) {
+			value = merge_node_value(pool, q->value, p->value);
+		} else {
+			value = p->value;
+		}
+		if (value == p->value) {
+			value = layer_member(pool, p->value, 0);
+		}
+		if (!value || push_member(pool, &list, p->name, value)) {
+			return NULL;
+		}
+	}
+	for (p = base->members; p; p = p->next) {
+		/* a member repeated in the lower layer is still an error */
+		if (find_member(over->members, p->name) &&
+				find_member(base->members, p->name) == p) {
+			continue;
+		}
+		value = layer_member(pool, p->value, !!over->members);
+		if (!value || push_member(pool, &list, p->name, value)) {
+			return NULL;
+		}
+	}
+	ret->type = VAL_MEMBERS;
+	ret->members = rev_node_members(list);
+	ret->anchored = 0;
+	ret->merged = 1;
+	ret->lower = 0;
+	ret->parent = NULL;
+	set_parent_members(ret->members, ret);
+	return ret;
+}
+
+int yacc_parse_layers(const char *const *paths, int n, const char **err_msg,
+		struct pass_to_bison *ctx)
+{
+	struct parse_cache *cache = ctx->cache;
+	struct node_value *merged = NULL;
+	const char *msg;
+	int i, ret;
+
+	if (n <= 0) {
+		*err_msg = make_message("no layers to parse");
+		return -EINVAL;
+	}
+	for (i = 0; i < n; ++i) {
+		init_pass_to_bison(ctx, ctx->pool);
+		ctx->cache = cache;
+		ret = yacc_parse_file(paths[i], &msg, ctx);
+		if (ret) {
+			*err_msg = make_message("%s: %s", paths[i],
+					msg ? msg : "");
+			free((char *)msg);
+			return ret;
+		}
+		merged = merged ? merge_node_value(ctx->pool, merged,
+				ctx->output) : ctx->output;
+		if (!merged) {
+			*err_msg = make_message("failed to merge %s", paths[i]);
+			return -ENOMEM;
+		}
+	}
+	ctx->output = merged;
+	return 0;
+}
+
+/* later members replace or are merged into earlier ones of the same name */
+static int fold_members(struct mem_pool *pool, struct node_value *value)
+{
+	struct node_members **pp = &value->members, *p, *q;
+	struct node_value *merged;
+
+	while ((p = *pp)) {
+		for (q = value->members; q != p; q = q->next) {
+			if (!strcmp(q->name, p->name)) {
+				break;
+			}
+		}
+		if (q == p) {
+			pp = &p->next;
+			continue;
+		}
+		merged = merge_node_value(pool, q->value, p->value);
+		if (!merged) {
+			return -ENOMEM;
+		}
+		merged->parent = value;
+		merged->name_copy = q->name;
+		q->value = merged;
+		*pp = p->next;
+	}
+	return 0;
+}
+
+int yacc_parse_fragment(const char *text, const char **err_msg,
+		struct pass_to_bison *ctx)
+{
+	size_t len = strlen(text);
+	const char *end = text + len;
+	char *buf;
+	int ret;
+
+	while (end > text && strchr(" \t\r\n", end[-1])) {
+		--end;
+	}
+	buf = malloc(len + 4);
+	if (!buf) {
+		*err_msg = make_message("failed to allocate buffer");
+		return -ENOMEM;
+	}
+	/* a fragment is the inside of a struct, the last ',' may be left out */
+	buf[0] = '{';
+	memcpy(buf + 1, text, len);
+	len = 1 + len;
+	if (end > text && end[-1] != ',') {
+		buf[len++] = ',';
+	}
+	buf[len++] = '}';
+	buf[len] = '\0';
+
+	/* the leading '{' is not part of the text */
+	ctx->first_column = ctx->last_column = 0;
+	ret = yacc_parse_string(buf, err_msg, ctx);
+	free(buf);
+	if (ret) {
+		return ret;
+	}
+	if (fold_members(ctx->pool, ctx->output)) {
+		*err_msg = make_message("failed to merge fragment");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void config_rcu_wait(struct config_rcu *rcu)
+{
+	unsigned long idx = __atomic_load_n(&rcu->epoch, __ATOMIC_RELAXED) & 1;
+
+	__atomic_fetch_add(&rcu->epoch, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&rcu->readers[idx], __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+}
+
+void config_rcu_publish(struct config_rcu *rcu, void *value)
+{
+	void *old;
+
+	pthread_mutex_lock(&rcu->lock);
+	old = __atomic_exchange_n(&rcu->current, value, __ATOMIC_SEQ_CST);
+	if (old) {
+		config_rcu_wait(rcu);
+		config_rcu_wait(rcu);
+	}
+	pthread_mutex_unlock(&rcu->lock);
+	if (old) {
+		rcu->free_func(old);
+	}
+}
+
+struct config_sub {
+	struct config_sub *next;
+	char *path;
+	size_t len;
+	int changed;
+	void (*notify)(const void *value, void *arg);
+	void *arg;
+};
+
+struct config_sub *config_sub_add(struct config_subs *subs,
+		const char *path, void (*notify)(const void *value, void *arg),
+		void *arg)
+{
+	struct config_sub *sub = malloc(sizeof(*sub));
+	struct config_sub **p;
+
+	if (!sub) {
+		return NULL;
+	}
+	sub->path = strdup(path ? path : "");
+	if (!sub->path) {
+		free(sub);
+		return NULL;
+	}
+	sub->len = strlen(sub->path);
+	sub->changed = 0;
+	sub->notify = notify;
+	sub->arg = arg;
+	sub->next = NULL;
+	pthread_mutex_lock(&subs->lock);
+	for (p = &subs->list; *p; p = &(*p)->next) {
+	}
+	*p = sub;
+	pthread_mutex_unlock(&subs->lock);
+	return sub;
+}
+
+void *config_sub_remove(struct config_subs *subs, struct config_sub *sub)
+{
+	struct config_sub **p;
+	void *arg = sub->arg;
+
+	pthread_mutex_lock(&subs->lock);
+	for (p = &subs->list; *p; p = &(*p)->next) {
+		if (*p == sub) {
+			*p = sub->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&subs->lock);
+	free(sub->path);
+	free(sub);
+	return arg;
+}
+
+/* whether one path is the other one, or a member or element of it */
+static int path_overlap(const char *a, size_t a_len,
+		const char *b, size_t b_len)
+{
+	size_t n = a_len < b_len ? a_len : b_len;
+	char c;
+
+	if (memcmp(a, b, n)) {
+		return 0;
+	}
+	if (a_len == b_len) {
+		return 1;
+	}
+	c = a_len > b_len ? a[n] : b[n];
+	return c == '.' || c == '[';
+}
+
+void config_sub_changed(const char *path, void *arg)
+{
+	struct config_subs *subs = arg;
+	struct config_sub *sub;
+	size_t len = path ? strlen(path) : 0;
+
+	for (sub = subs->list; sub; sub = sub->next) {
+		if (!path || path_overlap(sub->path, sub->len, path, len)) {
+			sub->changed = 1;
+		}
+	}
+}
+
+void config_subs_notify(struct config_subs *subs, struct config_rcu *rcu)
+{
+	struct config_sub *sub;
+	struct config_pin pin;
+	const void *value = config_rcu_pin(rcu, &pin);
+
+	for (sub = subs->list; sub; sub = sub->next) {
+		if (sub->changed && value) {
+			sub->notify(value, sub->arg);
+		}
+		sub->changed = 0;
+	}
+	config_rcu_unpin(&pin);
+}
+
+/*
+ * Speculative parallel parsing.
+ *
+ * The file is pre-scanned for the largest array which is either the
+ * top-level value or the value of a member of the top-level struct. Its
+ * elements are split into chunks at top-level commas, each chunk is parsed
+ * by a thread of its own, while the rest of the file (with the array
+ * blanked out) is parsed by the caller. The element lists are then
+ * stitched in order.
+ * A chunk is balanced and parsed with the position it has in the file, so
+ * the error of the first failed chunk is the one of the serial parse and is
+ * returned as is. Anchors are not seen across chunks, a file with '&' or '*'
+ * is parsed serially, as is any file the pre-scan gives up on or whose
+ * skeleton fails to parse.
+ */
+
+#define PARALLEL_MIN_SIZE (1 << 16)
+#define PRESCAN_MAX_DEPTH (256)
+
+struct scan_pos {
+	size_t off;
+	int line;
+	int column;
+};
+
+struct split_target {
+	size_t open;		/* offset of '[' */
+	size_t close;		/* offset of the matching ']' */
+	const char *name;	/* member name, NULL if top-level array */
+	size_t name_len;
+};
+
+struct parse_chunk {
+	pthread_t thread;
+	int started;
+	char *text;
+	const char *path;	/* for includes, parsed without a cache */
+	struct scan_pos pos;
+	struct mem_pool pool;
+	struct pass_to_bison opaque;
+	const char *err_msg;
+	struct node_elems *tail;
+	struct mem_elem *pool_tail;
+	int ret;
+};
+
+static void advance_pos(struct scan_pos *pos, const char *buf, size_t to)
+{
+	for (; pos->off < to; ++pos->off) {
+		if (buf[pos->off] == '\n') {
+			pos->line++;
+			pos->column = 0;
+		} else {
+			pos->column++;
+		}
+	}
+}
+
+/* return the offset just after a string or char literal, 0 if unterminated */
+static size_t skip_literal(const char *buf, size_t len, size_t i)
+{
+	char quote = buf[i];
+	for (++i; i < len; ++i) {
+		if (buf[i] == '\\') {
+			++i;
+		} else if (buf[i] == quote) {
+			return i + 1;
+		} else if (buf[i] == '\n') {
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/* return the offset of the next '\n' (or len) */
+static size_t skip_comment(const char *buf, size_t len, size_t i)
+{
+	const char *nl = memchr(buf + i, '\n', len - i);
+	return nl ? (size_t)(nl - buf) : len;
+}
+
+static int is_iden_char(char c)
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+		('0' <= c && c <= '9') || c == '_';
+}
+
+/* find ".name =" in front of an array, return 0 if found */
+static int find_member_name(const char *buf, size_t open,
+		struct split_target *t)
+{
+	size_t i = open, end;
+	while (i > 0 && strchr(" \t\v\n\f", buf[i - 1])) {
+		--i;
+	}
+	if (i == 0 || buf[i - 1] != '=') {
+		return -1;
+	}
+	--i;
+	while (i > 0 && strchr(" \t\v\n\f", buf[i - 1])) {
+		--i;
+	}
+	end = i;
+	while (i > 0 && is_iden_char(buf[i - 1])) {
+		--i;
+	}
+	if (i == end) {
+		return -1;
+	}
+	t->name = buf + i;
+	t->name_len = end - i;
+	while (i > 0 && strchr(" \t\v\n\f", buf[i - 1])) {
+		--i;
+	}
+	if (i == 0 || buf[i - 1] != '.') {
+		return -1;
+	}
+	return 0;
+}
+
+/* return 0 if a target large enough to be split is found */
+static int find_split_target(const char *buf, size_t len,
+		struct split_target *t)
+{
+	char stack[PRESCAN_MAX_DEPTH];
+	size_t i, j, open = 0, top_open = 0;
+	int depth = 0, found = 0;
+	char c;
+
+	for (i = 0; i < len; ++i) {
+		c = buf[i];
+		switch (c) {
+		case '"':
+		case '\'':
+			j = skip_literal(buf, len, i);
+			if (!j) {
+				return -1;
+			}
+			i = j - 1;
+			break;
+		case '/':
+			if (i + 1 < len && buf[i + 1] == '/') {
+				i = skip_comment(buf, len, i) - 1;
+			}
+			break;
+		case '&':
+		case '*':
+			return -1;	/* an anchor or a reference */
+		case '{':
+		case '[':
+			if (depth == PRESCAN_MAX_DEPTH) {
+				return -1;
+			}
+			if (depth == 0) {
+				if (found) { /* more than one value */
+					return -1;
+				}
+				top_open = i;
+			} else if (depth == 1 && c == '[' && stack[0] == '{') {
+				open = i;
+			}
+			stack[depth++] = c;
+			break;
+		case '}':
+		case ']':
+			if (depth == 0 || stack[depth - 1] != (c == '}' ? '{' : '[')) {
+				return -1;
+			}
+			--depth;
+			if (depth == 0) {
+				found = 1;
+				if (c == ']') {
+					t->open = top_open;
+					t->close = i;
+					t->name = NULL;
+				}
+			} else if (depth == 1 && c == ']' && stack[0] == '{' &&
+					(!t->close || i - open > t->close - t->open)) {
+				t->open = open;
+				t->close = i;
+			}
+			break;
+		}
+	}
+	if (depth || !found || !t->close ||
+			t->close - t->open < PARALLEL_MIN_SIZE) {
+		return -1;
+	}
+	if (buf[top_open] == '{') {
+		return find_member_name(buf, t->open, t);
+	}
+	return 0;
+}
+
+/*
+ * split the array into at most n chunks, return the number of chunks;
+ * each chunk is balanced, so its errors are the ones of the serial parse
+ */
+static int split_chunks(const char *buf, const struct split_target *t,
+		struct parse_chunk *chunks, int n)
+{
+	struct scan_pos pos = { 0, 1, 1 };
+	size_t i, j, beg, size;
+	int depth = 0, k = 0;
+
+	beg = t->open + 1;
+	size = t->close - beg;
+	advance_pos(&pos, buf, beg);
+	chunks[k++].pos = pos;
+	for (i = beg; i < t->close; ++i) {
+		switch (buf[i]) {
+		case '"':
+		case '\'':
+			j = skip_literal(buf, t->close, i);
+			if (!j) {
+				return -1;
+			}
+			i = j - 1;
+			break;
+		case '/':
+			if (buf[i + 1] == '/') {
+				i = skip_comment(buf, t->close, i) - 1;
+			}
+			break;
+		case '{':
+		case '[':
+			++depth;
+			break;
+		case '}':
+		case ']':
+			if (--depth < 0) {
+				return -1;
+			}
+			break;
+		case ',':
+			if (depth == 0 && k < n && i + 1 - beg >= size / n * k) {
+				advance_pos(&pos, buf, i + 1);
+				chunks[k++].pos = pos;
+			}
+			break;
+		}
+	}
+	return depth ? -1 : k;
+}
+
+static void *parse_chunk_thread(void *arg)
+{
+	struct parse_chunk *c = arg;
+	struct node_elems *e;
+	struct mem_elem *m;
+
+	init_pass_to_bison(&c->opaque, &c->pool);
+	c->opaque.path = c->path;
+	/* the leading '[' is not part of the file */
+	c->opaque.first_line = c->opaque.last_line = c->pos.line;
+	c->opaque.first_column = c->opaque.last_column = c->pos.column - 1;
+	c->ret = yacc_parse_string(c->text, &c->err_msg, &c->opaque);
+	if (!c->ret && c->opaque.output->type != VAL_ELEMS) {
+		c->ret = -EINVAL;
+	}
+	if (!c->ret) {
+		for (e = c->opaque.output->elems; e && e->next; e = e->next) {
+			;
+		}
+		c->tail = e;
+	}
+	for (m = c->pool.list; m && m->next; m = m->next) {
+		;
+	}
+	c->pool_tail = m;
+	return NULL;
+}
+
+static struct node_value *find_placeholder(struct node_value *output,
+		const struct split_target *t)
+{
+	struct node_members *m;
+	struct node_value *found = NULL;
+
+	if (!t->name) {
+		return output->type == VAL_ELEMS && !output->elems ?
+			output : NULL;
+	}
+	if (output->type != VAL_MEMBERS) {
+		return NULL;
+	}
+	for (m = output->members; m; m = m->next) {
+		if (strlen(m->name) == t->name_len &&
+				!memcmp(m->name, t->name, t->name_len) &&
+				m->value->type == VAL_ELEMS &&
+				!m->value->elems) {
+			if (found) {
+				return NULL;
+			}
+			found = m->value;
+		}
+	}
+	return found;
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+	FILE *fp;
+	long size;
+	char *buf = NULL;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 ||
+			fseek(fp, 0, SEEK_SET)) {
+		goto out;
+	}
+	buf = malloc(size + 1);
+	if (!buf) {
+		goto out;
+	}
+	if (fread(buf, 1, size, fp) != (size_t)size) {
+		free(buf);
+		buf = NULL;
+		goto out;
+	}
+	buf[size] = '\0';
+	*len = size;
+out:
+	fclose(fp);
+	return buf;
+}
+
+int yacc_parse_file_parallel(const char *path, const char **err_msg,
+		struct pass_to_bison *ctx, int nthreads)
+{
+	struct split_target target = {};
+	struct parse_chunk *chunks = NULL;
+	struct parse_cache *cache;
+	struct node_value *holder;
+	struct node_elems *head = NULL, *tail = NULL;
+	char *buf = NULL;
+	size_t len, beg, end, i;
+	int n = 0, k, ret;
+
+	if (nthreads <= 1) {
+		goto serial;
+	}
+	buf = read_file(path, &len);
+	if (!buf || memchr(buf, '\0', len) ||
+			find_split_target(buf, len, &target)) {
+		goto serial;
+	}
+	chunks = calloc(nthreads, sizeof(*chunks));
+	if (!chunks) {
+		goto serial;
+	}
+	n = split_chunks(buf, &target, chunks, nthreads);
+	if (n <= 0) {
+		n = 0;
+		goto serial;
+	}
+	for (k = 0; k < n; ++k) {
+		mem_pool_init(&chunks[k].pool);
+		beg = chunks[k].pos.off;
+		end = k + 1 < n ? chunks[k + 1].pos.off : target.close;
+		chunks[k].text = malloc(end - beg + 3);
+		if (!chunks[k].text) {
+			goto fallback;
+		}
+		chunks[k].path = path;
+		chunks[k].text[0] = '[';
+		memcpy(chunks[k].text + 1, buf + beg, end - beg);
+		chunks[k].text[end - beg + 1] = ']';
+		chunks[k].text[end - beg + 2] = '\0';
+	}
+	for (k = 0; k < n; ++k) {
+		chunks[k].started = !pthread_create(&chunks[k].thread, NULL,
+				parse_chunk_thread, &chunks[k]);
+		if (!chunks[k].started) {
+			parse_chunk_thread(&chunks[k]);
+		}
+	}
+
+	/* parse the skeleton meanwhile, keeping line numbers */
+	for (i = target.open + 1; i < target.close; ++i) {
+		if (buf[i] != '\n') {
+			buf[i] = ' ';
+		}
+	}
+	ctx->path = path;
+	ret = yacc_parse_string(buf, err_msg, ctx);
+
+	for (k = 0; k < n; ++k) {
+		if (chunks[k].started) {
+			pthread_join(chunks[k].thread, NULL);
+		}
+	}
+	if (ret) {
+		free((char *)*err_msg);
+		goto fallback;
+	}
+	for (k = 0; k < n; ++k) {
+		if (chunks[k].ret) {
+			if (!chunks[k].err_msg) {
+				goto fallback;
+			}
+			/* the first failed chunk holds the first error */
+			*err_msg = chunks[k].err_msg;
+			chunks[k].err_msg = NULL;
+			ret = chunks[k].ret;
+			goto out;
+		}
+	}
+	holder = find_placeholder(ctx->output, &target);
+	if (!holder) {
+		goto fallback;
+	}
+
+	for (k = 0; k < n; ++k) {
+		if (!chunks[k].opaque.output->elems) {
+			continue;
+		}
+		if (tail) {
+			tail->next = chunks[k].opaque.output->elems;
+		} else {
+			head = chunks[k].opaque.output->elems;
+		}
+		tail = chunks[k].tail;
+	}
+	if (count_node_elems(head) < 0) {
+		goto fallback;	/* too large, the serial parse says so */
+	}
+	holder->elems = head;
+	set_parent_elems(head, holder);
+
+	/* the chunk pools now belong to the caller's pool */
+	for (k = 0; k < n; ++k) {
+		if (!chunks[k].pool_tail) {
+			continue;
+		}
+		chunks[k].pool_tail->next = ctx->pool->list;
+		ctx->pool->list = chunks[k].pool.list;
+		chunks[k].pool.list = NULL;
+	}
+	for (k = 0; k < n; ++k) {
+		free(chunks[k].text);
+		free((char *)chunks[k].err_msg);
+	}
+	free(chunks);
+	free(buf);
+	return 0;
+
+fallback:
+	cache = ctx->cache;
+	init_pass_to_bison(ctx, ctx->pool);
+	ctx->cache = cache;
+serial:
+	ret = 1; /* not an error, parse it serially */
+out:
+	for (k = 0; k < n; ++k) {
+		mem_pool_destroy(&chunks[k].pool);
+		free(chunks[k].text);
+		free((char *)chunks[k].err_msg);
+	}
+	free(chunks);
+	free(buf);
+	return ret > 0 ? yacc_parse_file(path, err_msg, ctx) : ret;
+}
+
+/* FNV-1a of the content of path, 0 if it can not be read */
+static uint64_t file_fingerprint(const char *path)
+{
+	uint64_t h = CONFIG_HASH_BASIS;
+	unsigned char buf[4096];
+	ssize_t n;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		h = config_hash_bytes(h, buf, n);
+	}
+	close(fd);
+	return n < 0 ? 0 : h;
+}
+
+#define WATCH_DEBOUNCE_MS	100
+
+struct config_watch {
+	char *path;
+	struct config_rcu *rcu;
+	int (*reload)(const char *path, const char **err_msg);
+	void (*notify)(const void *value, void *arg);
+	void *arg;
+	uint64_t fingerprint;
+	int inotify_fd;
+	int stop_fd[2];
+	pthread_t thread;
+};
+
+#ifdef __linux__
+static void config_watch_check(struct config_watch *w)
+{
+	struct config_pin pin;
+	const char *err_msg = NULL;
+	const void *value;
+	uint64_t fp = file_fingerprint(w->path);
+
+	/* missing while being replaced, or not changed */
+	if (!fp || fp == w->fingerprint) {
+		return;
+	}
+	/* a broken file is not parsed again until it changes */
+	w->fingerprint = fp;
+	if (w->reload(w->path, &err_msg)) {
+		free((char *)err_msg);
+		return;
+	}
+	value = config_rcu_pin(w->rcu, &pin);
+	if (value) {
+		w->notify(value, w->arg);
+	}
+	config_rcu_unpin(&pin);
+}
+
+static void *config_watch_thread(void *arg)
+{
+	struct config_watch *w = arg;
+	struct pollfd fds[2];
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int pending = 0, ret;
+
+	fds[0].fd = w->inotify_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = w->stop_fd[0];
+	fds[1].events = POLLIN;
+	for (;;) {
+		ret = poll(fds, 2, pending ? WATCH_DEBOUNCE_MS : -1);
+		if (ret < 0 && errno != EINTR) {
+			break;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+		if (ret > 0 && fds[0].revents) {
+			/* any event restarts the quiet period */
+			while (read(w->inotify_fd, buf, sizeof(buf)) > 0) {
+				;
+			}
+			pending = 1;
+			continue;
+		}
+		if (!ret && pending) {
+			pending = 0;
+			config_watch_check(w);
+		}
+	}
+	return NULL;
+}
+
+struct config_watch *config_watch_start(const char *path,
+		struct config_rcu *rcu,
+		int (*reload)(const char *path, const char **err_msg),
+		void (*notify)(const void *value, void *arg), void *arg,
+		const char **err_msg)
+{
+	struct config_watch *w;
+	const char *slash;
+	char *dir;
+	int ret;
+
+	*err_msg = NULL;
+	w = calloc(1, sizeof(*w));
+	if (!w) {
+		*err_msg = make_message("failed to allocate watch");
+		return NULL;
+	}
+	w->rcu = rcu;
+	w->reload = reload;
+	w->notify = notify;
+	w->arg = arg;
+	w->inotify_fd = -1;
+	w->stop_fd[0] = w->stop_fd[1] = -1;
+	w->path = strdup(path);
+	slash = strrchr(path, '/');
+	dir = slash ? strndup(path, slash == path ? 1 : slash - path) :
+		strdup(".");
+	if (!w->path || !dir) {
+		*err_msg = make_message("failed to allocate watch");
+		goto err;
+	}
+
+	ret = reload(path, err_msg);
+	if (ret) {
+		goto err;
+	}
+	w->fingerprint = file_fingerprint(path);
+
+	/*
+	 * The directory is watched rather than the file, so that a file
+	 * replaced by rename, by an editor or by a symlink swap is followed.
+	 */
+	w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->inotify_fd < 0 || inotify_add_watch(w->inotify_fd, dir,
+				IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+				IN_DELETE | IN_ATTRIB) < 0) {
+		*err_msg = make_message("failed to watch %s: %s", dir,
+				strerror(errno));
+		goto err;
+	}
+	if (pipe(w->stop_fd)) {
+		*err_msg = make_message("failed to create pipe: %s",
+				strerror(errno));
+		goto err;
+	}
+	ret = pthread_create(&w->thread, NULL, config_watch_thread, w);
+	if (ret) {
+		*err_msg = make_message("failed to create thread: %s",
+				strerror(ret));
+		goto err;
+	}
+	free(dir);
+	return w;
+
+err:
+	if (w->stop_fd[0] >= 0) {
+		close(w->stop_fd[0]);
+		close(w->stop_fd[1]);
+	}
+	if (w->inotify_fd >= 0) {
+		close(w->inotify_fd);
+	}
+	free(dir);
+	free(w->path);
+	free(w);
+	return NULL;
+}
+#else
+struct config_watch *config_watch_start(const char *path,
+		struct config_rcu *rcu,
+		int (*reload)(const char *path, const char **err_msg),
+		void (*notify)(const void *value, void *arg), void *arg,
+		const char **err_msg)
+{
+	*err_msg = make_message("watching %s: inotify is not supported", path);
+	return NULL;
+}
+#endif
+
+void *config_watch_stop(struct config_watch *w)
+{
+	void *arg;
+	if (!w) {
+		return NULL;
+	}
+	if (write(w->stop_fd[1], "", 1) == 1) {
+		pthread_join(w->thread, NULL);
+	}
+	close(w->stop_fd[0]);
+	close(w->stop_fd[1]);
+	close(w->inotify_fd);
+	arg = w->arg;
+	free(w->path);
+	free(w);
+	return arg;
+}
+
+/* a file of a loaded directory */
+struct dir_file {
+	char *name;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	uint64_t fp;
+	long idx;		/* of its element, in the last array */
+};
+
+struct config_dir {
+	struct dir_file *files;		/* of the last load, by name */
+	long n;
+	unsigned char *taken;		/* elements of old taken over */
+	long n_taken;
+};
+
+struct config_dir *config_dir_new(void)
+{
+	return calloc(1, sizeof(struct config_dir));
+}
+
+static void dir_files_free(struct dir_file *files, long n)
+{
+	long i;
+	for (i = 0; i < n; ++i) {
+		free(files[i].name);
+	}
+	free(files);
+}
+
+void config_dir_free(struct config_dir *dir)
+{
+	if (dir) {
+		dir_files_free(dir->files, dir->n);
+		free(dir->taken);
+		free(dir);
+	}
+}
+
+static int dir_file_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct dir_file *)a)->name,
+			((const struct dir_file *)b)->name);
+}
+
+static struct dir_file *dir_file_find(const struct config_dir *dir,
+		const char *name)
+{
+	struct dir_file key;
+	key.name = (char *)name;
+	return dir->n ? bsearch(&key, dir->files, dir->n,
+			sizeof(*dir->files), dir_file_cmp) : NULL;
+}
+
+/* the regular files of path by name, without stat information yet */
+static int dir_list(const char *path, struct dir_file **files, long *n,
+		const char **err_msg)
+{
+	DIR *d;
+	struct dirent *ent;
+	struct dir_file *p = NULL, *tmp;
+	long len = 0, cap = 0;
+	int ret;
+
+	d = opendir(path);
+	if (!d) {
+		ret = -errno;
+		*err_msg = make_message("failed to open directory %s: %s",
+				path, strerror(errno));
+		return ret;
+	}
+	while ((errno = 0, ent = readdir(d))) {
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+		if (len == cap) {
+			cap = cap ? cap * 2 : 64;
+			tmp = realloc(p, cap * sizeof(*p));
+			if (!tmp) {
+				goto nomem;
+			}
+			p = tmp;
+		}
+		p[len].name = strdup(ent->d_name);
+		if (!p[len].name) {
+			goto nomem;
+		}
+		++len;
+	}
+	if (errno) {
+		ret = -errno;
+		*err_msg = make_message("failed to read directory %s: %s",
+				path, strerror(errno));
+		goto err;
+	}
+	closedir(d);
+	if (len) {
+		qsort(p, len, sizeof(*p), dir_file_cmp);
+	}
+	*files = p;
+	*n = len;
+	return 0;
+
+nomem:
+	ret = -ENOMEM;
+	*err_msg = make_message("failed to allocate file list of %s", path);
+err:
+	closedir(d);
+	dir_files_free(p, len);
+	return ret;
+}
+
+struct dir_job {
+	char *path;
+	void *elem;
+	int ret;
+	const char *err_msg;
+};
+
+struct dir_jobs {
+	struct dir_job *jobs;
+	long n;
+	long next;
+	int (*convert)(void *elem, const char *path, const char **err_msg);
+};
+
+static void *dir_convert_thread(void *arg)
+{
+	struct dir_jobs *j = arg;
+	struct dir_job *job;
+	long i;
+
+	while ((i = __atomic_fetch_add(&j->next, 1, __ATOMIC_RELAXED)) <
+			j->n) {
+		job = &j->jobs[i];
+		job->err_msg = NULL;
+		job->ret = j->convert(job->elem, job->path, &job->err_msg);
+	}
+	return NULL;
+}
+
+int config_dir_load(struct config_dir *dir, const char *path,
+		const void *old, long old_len, size_t size,
+		int (*convert)(void *elem, const char *path,
+			const char **err_msg),
+		void (*free_elem)(void *elem), int nthreads,
+		void **elems, long *len, const char **err_msg)
+{
+	struct dir_file *files = NULL, *prev;
+	struct dir_jobs j = { NULL, 0, 0, convert };
+	pthread_t *threads = NULL;
+	unsigned char *taken = NULL;
+	unsigned char *out = NULL;
+	struct stat st;
+	char *file = NULL;
+	long n = 0, i, k;
+	int started = 0, ret;
+
+	*err_msg = NULL;
+	ret = dir_list(path, &files, &n, err_msg);
+	if (ret) {
+		return ret;
+	}
+	out = calloc(n ? n : 1, size);
+	j.jobs = calloc(n ? n : 1, sizeof(*j.jobs));
+	taken = calloc(old_len ? old_len : 1, 1);
+	if (!out || !j.jobs || !taken) {
+		goto nomem;
+	}
+
+	/* files that are not regular are dropped, names moved are cleared */
+	for (i = k = 0; i < n; ++i) {
+		free(file);
+		file = (char *)make_message("%s/%s", path, files[i].name);
+		if (!file) {
+			goto nomem;
+		}
+		if (stat(file, &st)) {
+			ret = -errno;
+			*err_msg = make_message("failed to stat %s: %s", file,
+					strerror(errno));
+			goto err;
+		}
+		if (!S_ISREG(st.st_mode)) {
+			free(files[i].name);
+			files[i].name = NULL;
+			continue;
+		}
+		if (k != i) {
+			files[k] = files[i];
+			files[i].name = NULL;
+		}
+		files[k].dev = st.st_dev;
+		files[k].ino = st.st_ino;
+		files[k].size = st.st_size;
+		files[k].mtime = st.st_mtim;
+		files[k].fp = 0;
+		files[k].idx = k;
+
+		/*
+		 * Unchanged if the stat key matches; a touched or copied file
+		 * with the same content is found by its fingerprint.
+		 */
+		prev = old ? dir_file_find(dir, files[k].name) : NULL;
+		if (prev && (prev->idx >= old_len || taken[prev->idx])) {
+			prev = NULL;
+		}
+		if (prev && prev->dev == st.st_dev && prev->ino == st.st_ino &&
+				prev->size == st.st_size &&
+				prev->mtime.tv_sec == st.st_mtim.tv_sec &&
+				prev->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+			files[k].fp = prev->fp;
+		} else {
+			files[k].fp = file_fingerprint(file);
+			if (prev && (!files[k].fp ||
+						files[k].fp != prev->fp)) {
+				prev = NULL;
+			}
+		}
+		if (prev) {
+			memcpy(out + k * size,
+					(const unsigned char *)old +
+					prev->idx * size, size);
+			taken[prev->idx] = 1;
+		} else {
+			j.jobs[j.n].path = file;
+			j.jobs[j.n].elem = out + k * size;
+			j.jobs[j.n].ret = -EINVAL;
+			++j.n;
+			file = NULL;
+		}
+		++k;
+	}
+	free(file);
+	file = NULL;
+
+	if (nthreads > j.n) {
+		nthreads = j.n;
+	}
+	if (nthreads > 1) {
+		threads = malloc((nthreads - 1) * sizeof(*threads));
+	}
+	if (threads) {
+		for (; started < nthreads - 1; ++started) {
+			if (pthread_create(&threads[started], NULL,
+						dir_convert_thread, &j)) {
+				break;
+			}
+		}
+	}
+	dir_convert_thread(&j);
+	for (i = 0; i < started; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+
+	/* the first failure in file order is reported */
+	for (i = 0; i < j.n; ++i) {
+		if (j.jobs[i].ret && !ret) {
+			ret = j.jobs[i].ret;
+			*err_msg = make_message("%s: %s", j.jobs[i].path,
+					j.jobs[i].err_msg ?
+					j.jobs[i].err_msg : strerror(-ret));
+		}
+	}
+	if (ret) {
+		for (i = 0; i < j.n; ++i) {
+			if (!j.jobs[i].ret) {
+				free_elem(j.jobs[i].elem);
+			}
+		}
+		goto err;
+	}
+
+	dir_files_free(dir->files, dir->n);
+	free(dir->taken);
+	dir->files = files;
+	dir->n = k;
+	dir->taken = taken;
+	dir->n_taken = old_len;
+	for (i = 0; i < j.n; ++i) {
+		free(j.jobs[i].path);
+		free((char *)j.jobs[i].err_msg);
+	}
+	free(j.jobs);
+	*elems = out;
+	*len = k;
+	return 0;
+
+nomem:
+	ret = -ENOMEM;
+	*err_msg = make_message("failed to allocate elements of %s", path);
+err:
+	if (j.jobs) {
+		for (i = 0; i < j.n; ++i) {
+			free(j.jobs[i].path);
+			free((char *)j.jobs[i].err_msg);
+		}
+	}
+	free(j.jobs);
+	free(file);
+	free(taken);
+	free(out);
+	dir_files_free(files, n);
+	return ret;
+}
+
+long config_dir_untaken(struct config_dir *dir, void *old, long old_len,
+		size_t size)
+{
+	unsigned char *p = old;
+	long i, n = 0;
+
+	for (i = 0; i < old_len; ++i) {
+		if (i < dir->n_taken && dir->taken[i]) {
+			continue;
+		}
+		if (n != i) {
+			memcpy(p + n * size, p + i * size, size);
+		}
+		++n;
+	}
+	free(dir->taken);
+	dir->taken = NULL;
+	dir->n_taken = 0;
+	return n;
+}
@@ -7,9 +7,13 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 /* type for numerical types, pre-convert */
 
@@ -17,6 +21,11 @@ struct malloc_list;
 struct node_value;
 struct node_members;
 struct node_elems;
+struct node_run;
+struct node_anchor;
+struct conv_share;
+struct parse_cache;
+struct cache_dep;
 
 enum val_type {
 	VAL_SCALE_CHAR,
@@ -24,8 +33,11 @@ enum val_type {
 	VAL_SCALE_FLOAT,
 	VAL_SCALE_IDEN,
 	VAL_SCALE_STRING,
+	VAL_BLOB_HEX,
+	VAL_BLOB_BASE64,
 	VAL_MEMBERS,
 	VAL_ELEMS,
+	VAL_RUN,	/* only as an element of VAL_ELEMS */
 };
 
 struct node_value {
@@ -35,10 +47,17 @@ struct node_value {
 		const char *float_str;
 		const char *enum_str;
 		const char *string_str;
+		const char *blob_str;
 		struct node_members *members;
 		struct node_elems *elems;
+		struct node_run *run;
 	};
 	enum val_type type;
+	unsigned int anchored : 1;	/* referenced by *name or repeated,
+					   see conv_share */
+	unsigned int merged : 1;	/* members of several layers */
+	unsigned int lower : 1;		/* member from a lower layer of a
+					   merged value */
 	const struct node_value *parent;
 	union {
 		const char *name_copy;
@@ -74,6 +93,17 @@ struct node_elems {
 rev_list(rev_node_members, struct node_members, next)
 rev_list(rev_node_elems, struct node_elems, next)
 
+/*
+ * "value * count" repeats a value, "first ... last" is a range of integers.
+ * Either is kept as a single element and expanded while converting.
+ */
+struct node_run {
+	struct node_value *value;	/* the repeated value or first */
+	long count;
+	long long first;
+	int step;			/* 0 if repeated, 1 or -1 for a range */
+};
+
 #define len_list(name, type, pnext) \
 	static inline long name(type *p) \
 	{ \
@@ -86,7 +116,31 @@ rev_list(rev_node_elems, struct node_elems, next)
 	}
 
 len_list(len_node_members, struct node_members, next)
-len_list(len_node_elems, struct node_elems, next)
+
+static inline long len_node_elems(struct node_elems *p)
+{
+	long i = 0;
+	while (p) {
+		i += p->value->type == VAL_RUN ? p->value->run->count : 1;
+		p = p->next;
+	}
+	return i;
+}
+
+/* len_node_elems, or -1 if the number of elements does not fit in a long */
+static inline long count_node_elems(const struct node_elems *p)
+{
+	long i = 0, k;
+	while (p) {
+		k = p->value->type == VAL_RUN ? p->value->run->count : 1;
+		if (k > LONG_MAX - i) {
+			return -1;
+		}
+		i += k;
+		p = p->next;
+	}
+	return i;
+}
 
 static inline void set_parent_members(struct node_members *p, struct node_value *parent)
 {
@@ -99,15 +153,77 @@ static inline void set_parent_members(struct node_members *p, struct node_value
 
 static inline void set_parent_elems(struct node_elems *p, struct node_value *parent)
 {
+	struct node_run *run;
 	long i = 0;
 	while (p) {
 		p->value->parent = parent;
 		p->value->index = i;
+		if (p->value->type == VAL_RUN) {
+			run = p->value->run;
+			run->value->parent = parent;
+			run->value->index = i;
+			i += run->count;
+		} else {
+			++i;
+		}
 		p = p->next;
-		++i;
 	}
 }
 
+/*
+ * walks the elements of an array, expanding runs; a range element is
+ * built in cur, valid until the next call, the tree is not written
+ */
+struct elems_iter {
+	const struct node_elems *elem;
+	long k;		/* index in the current run */
+	int same;	/* the last value repeats the one before */
+	struct node_value cur;
+	char cur_str[24];
+};
+
+extern const struct node_value *elems_iter_run(struct elems_iter *it);
+
+static inline void elems_iter_init(struct elems_iter *it,
+		const struct node_elems *elems)
+{
+	it->elem = elems;
+	it->k = 0;
+	it->same = 0;
+	it->cur.type = VAL_SCALE_INT;
+	it->cur.int_str = it->cur_str;
+	it->cur.anchored = 0;
+	it->cur.merged = 0;
+	it->cur.lower = 0;
+}
+
+static inline const struct node_value *elems_iter_next(struct elems_iter *it)
+{
+	const struct node_value *val = it->elem->value;
+	if (val->type == VAL_RUN) {
+		return elems_iter_run(it);
+	}
+	it->elem = it->elem->next;
+	it->same = 0;
+	return val;
+}
+
+/* the range at the iterator, NULL if it is not at the start of one */
+static inline const struct node_run *elems_iter_range(const struct elems_iter *it)
+{
+	const struct node_value *val = it->elem->value;
+	return val->type == VAL_RUN && val->run->step && !it->k ?
+		val->run : NULL;
+}
+
+/* skip the rest of the current element or run */
+static inline void elems_iter_skip(struct elems_iter *it)
+{
+	it->elem = it->elem->next;
+	it->k = 0;
+	it->same = 0;
+}
+
 struct mem_elem;
 struct mem_pool {
 	struct mem_elem *list;
@@ -117,12 +233,180 @@ extern void mem_pool_init(struct mem_pool *p);
 extern void *mem_pool_alloc(struct mem_pool *p, size_t s); 
 extern void mem_pool_destroy(struct mem_pool *p);
 
+/*
+ * Allocator of converted values, user is passed back to each function and
+ * blocks are aligned as from malloc(). free and realloc get the size the
+ * block was allocated with, so sized pools work without headers. calloc and
+ * realloc may be NULL, they are then done with alloc, memset, memcpy and free.
+ * bytes, peak and blocks account what is in use through this allocator, so
+ * one per config tells what each one costs.
+ */
+struct config_allocator {
+	void *(*alloc)(void *user, size_t size);
+	void *(*calloc)(void *user, size_t n, size_t size);
+	void *(*realloc)(void *user, void *p, size_t old_size, size_t size);
+	void (*free)(void *user, void *p, size_t size);
+	void *user;
+	size_t bytes;
+	size_t peak;
+	size_t blocks;
+};
+
+/* n elements of size bytes, zeroed if zero; NULL on ENOMEM or overflow */
+extern void *config_allocator_alloc(struct config_allocator *a, size_t n,
+		size_t size, int zero);
+extern void *config_allocator_realloc(struct config_allocator *a, void *p,
+		size_t old_size, size_t size);
+extern void config_allocator_free(struct config_allocator *a, void *p,
+		size_t size);
+
+/*
+ * Storage of a value converted by a struct with the arena attribute: its
+ * arrays and strings are carved from chunks, which config_arena_free() frees
+ * at once. The chunks come from alloc, or from malloc() if it is NULL.
+ */
+struct config_arena;
+
+extern struct config_arena *config_arena_new(struct config_allocator *alloc);
+extern void config_arena_free(struct config_arena *arena);
+/* size bytes aligned to align, a power of two; NULL on ENOMEM */
+extern void *config_arena_alloc(struct config_arena *arena, size_t size,
+		size_t align);
+/* bytes of the chunks */
+extern size_t config_arena_size(const struct config_arena *arena);
+
+struct node_fps;
+
 struct pass_to_conv {
 	struct mem_pool *pool;
 	const struct node_value *node;
 	const char *msg;
+	struct conv_share *shared;
+	struct node_fps *fps;	/* see node_fingerprint */
+	struct config_arena *arena;	/* storage of the result, may be NULL */
+	struct config_allocator *alloc;	/* NULL for malloc() */
+	struct node_value node_copy;	/* see elems_iter_keep */
+};
+
+/* node is a range element of it, keep it beyond the iterator */
+static inline void elems_iter_keep(struct elems_iter *it,
+		struct pass_to_conv *ctx)
+{
+	if (ctx->node == &it->cur) {
+		ctx->node_copy = it->cur;
+		ctx->node_copy.int_str = NULL;
+		ctx->node = &ctx->node_copy;
+	}
+}
+
+/*
+ * Storage of converted values: n elements of size bytes from ctx->arena if
+ * any, otherwise from ctx->alloc, or malloc() without one. conv_free() and
+ * conv_realloc() take the size the block has, conv_free() leaves arena
+ * storage to the arena.
+ */
+static inline void *conv_alloc(struct pass_to_conv *ctx, size_t n,
+		size_t size)
+{
+	size_t align = size & -size;
+
+	if (size && n > SIZE_MAX / size) {
+		return NULL;
+	}
+	if (!ctx->arena) {
+		if (ctx->alloc) {
+			return config_allocator_alloc(ctx->alloc, n, size, 0);
+		}
+		return malloc(n * size);
+	}
+	if (align > __alignof__(max_align_t)) {
+		align = __alignof__(max_align_t);
+	}
+	return config_arena_alloc(ctx->arena, n * size, align ? align : 1);
+}
+
+static inline void *conv_calloc(struct pass_to_conv *ctx, size_t n,
+		size_t size)
+{
+	void *p;
+
+	if (!ctx->arena) {
+		if (ctx->alloc) {
+			return config_allocator_alloc(ctx->alloc, n, size, 1);
+		}
+		return calloc(n, size);
+	}
+	p = conv_alloc(ctx, n, size);
+	if (p) {
+		memset(p, 0, n * size);
+	}
+	return p;
+}
+
+static inline void *conv_realloc(struct pass_to_conv *ctx, void *p,
+		size_t old_size, size_t size)
+{
+	void *q;
+
+	if (!ctx->arena) {
+		if (ctx->alloc) {
+			return config_allocator_realloc(ctx->alloc, p,
+					old_size, size);
+		}
+		return realloc(p, size);
+	}
+	if (size <= old_size) {
+		return p;
+	}
+	q = conv_alloc(ctx, 1, size);
+	if (q && old_size) {
+		memcpy(q, p, old_size);
+	}
+	return q;
+}
+
+static inline void conv_free(struct pass_to_conv *ctx, void *p, size_t size)
+{
+	if (!ctx->arena) {
+		if (ctx->alloc) {
+			config_allocator_free(ctx->alloc, p, size);
+		} else {
+			free(p);
+		}
+	}
+}
+
+/* the value of a member declared [<= cap spill], inline or spilled */
+#define CONFIG_BOUNDED(value, member) \
+	((value)->member##_spill ? (value)->member##_spill : (value)->member)
+
+/*
+ * "&name value" defines an anchor, "*name" is a copy of its node sharing
+ * the members or elements, so the subtree is parsed only once.
+ */
+struct node_anchor {
+	struct node_anchor *next;
+	const char *name;
+	struct node_value *value;
+};
+
+/*
+ * Conversions of anchored values of shared structs, an anchored value
+ * converted again is copied from here instead.
+ */
+struct conv_share {
+	struct conv_share *next;
+	const void *node;	/* members of the anchored value */
+	const char *type;
+	void *value;
 };
 
+extern void *conv_share_find(struct pass_to_conv *ctx,
+		const struct node_value *input, const char *type);
+extern int conv_share_add(struct pass_to_conv *ctx,
+		const struct node_value *input, const char *type,
+		void *value);
+
 struct pass_to_bison {
 	struct mem_pool *pool;
 	int ok;
@@ -136,6 +420,12 @@ struct pass_to_bison {
 	const char *err_reason;
 	
 	struct node_value *output;
+	struct node_anchor *anchors;
+
+	const char *path;		/* file being parsed, NULL for a string */
+	struct parse_cache *cache;	/* for included files, may be NULL */
+	struct cache_dep *deps;		/* files included, for the cache */
+	int depth;			/* of nested includes */
 };
 
 extern void init_pass_to_bison(struct pass_to_bison *ctx, 
@@ -149,16 +439,372 @@ union vvstype {
 	const char *int_str;
 	const char *float_str;
 	const char *string_str;
+	const char *blob_str;
 	struct node_value *value;
 	struct node_members *members;
 	struct node_elems *elems;
 };
 
+/*
+ * hex"..." and b64"..." literals hold the bytes of an array of fixed-width
+ * elements, each element stored little-endian.
+ * blob_elems() returns the number of elements of elem_size bytes, or
+ * -EINVAL with ctx->node and ctx->msg set if the size does not fit.
+ * blob_decode() then stores n elements into out.
+ */
+static inline int is_blob_value(const struct node_value *val)
+{
+	return val->type == VAL_BLOB_HEX || val->type == VAL_BLOB_BASE64;
+}
+
+extern long blob_elems(struct pass_to_conv *ctx, const struct node_value *val,
+		size_t elem_size);
+extern void blob_decode(void *out, const struct node_value *val, long n,
+		size_t elem_size);
+
 extern const char *make_msg_loc(const struct node_value *pos, const char *fmt, ...);
 
+/* converts input into value, old is the value it replaces if any */
+typedef int (*conv_func)(struct pass_to_conv *ctx, void *value,
+		const void *old, const struct node_value *input);
+/*
+ * converts tree, parsed into pool, by func with the allocator and the arena
+ * of the value; a failure is located in *err_msg
+ */
+extern int conv_parsed(struct mem_pool *pool, const struct node_value *tree,
+		struct config_allocator *alloc, struct config_arena *arena,
+		conv_func func, void *value, const void *old,
+		const char **err_msg);
+
 extern int yacc_parse_file(const char *filename, const char **err_msg, 
 		struct pass_to_bison *ctx);
 extern int yacc_parse_string(const char *str, const char **err_msg,
 		struct pass_to_bison *ctx);
+/*
+ * include "path" parses another file as a value, a relative path is relative
+ * to the including file. A parse cache keeps parsed files by path across
+ * parses, checked by device, inode, size and mtime of the file and of the
+ * files it includes, so a file included by many configs is parsed once.
+ * A cache must not be used by several threads at once.
+ */
+extern struct parse_cache *parse_cache_new(void);
+extern void parse_cache_free(struct parse_cache *cache);
+extern struct node_value *include_file(struct pass_to_bison *opaque,
+		const char *name);
+/*
+ * Layers are parsed in order and merged into one tree: a struct or union value
+ * is merged member by member with the one of the lower layer, any other value
+ * including an array replaces it. Members of a merged value are in the order
+ * of the upper layer followed by the rest of the lower one.
+ */
+extern struct node_value *merge_node_value(struct mem_pool *pool,
+		struct node_value *base, struct node_value *over);
+extern int yacc_parse_layers(const char *const *paths, int n,
+		const char **err_msg, struct pass_to_bison *ctx);
+/*
+ * A fragment is a list of members of the top-level struct, each may be given
+ * by a path: .a.b = 1, .a.c = 2 is .a = { .b = 1, .c = 2, }. Members of the
+ * same name are merged as layers, the last one wins.
+ */
+extern int yacc_parse_fragment(const char *text, const char **err_msg,
+		struct pass_to_bison *ctx);
+/* parse the largest array of the file with up to nthreads threads */
+extern int yacc_parse_file_parallel(const char *path, const char **err_msg,
+		struct pass_to_bison *ctx, int nthreads);
+
+/*
+ * A published snapshot of a config, read without locks.
+ * A reader pins the current snapshot, which stays valid until it is unpinned.
+ * A writer publishes a new one and waits until the readers of the old one
+ * have unpinned it before freeing it: readers count themselves in one of two
+ * counters chosen by the epoch, the writer flips the epoch and waits for the
+ * counter of the old one to drop to zero, twice, so that a reader that read
+ * the epoch just before a flip is also waited for.
+ * Pinning costs an atomic add and two loads, unpinning an atomic sub.
+ * Writers are serialized by the lock, a reader must not publish while it
+ * holds a pin.
+ */
+struct config_rcu {
+	void *current;
+	unsigned long epoch;
+	unsigned long readers[2];
+	pthread_mutex_t lock;
+	void (*free_func)(void *);
+};
+
+#define CONFIG_RCU_INITIALIZER(free_func) \
+	{ NULL, 0, { 0, 0 }, PTHREAD_MUTEX_INITIALIZER, free_func }
+
+struct config_pin {
+	struct config_rcu *rcu;
+	unsigned long idx;
+};
+
+static inline void *config_rcu_pin(struct config_rcu *rcu,
+		struct config_pin *pin)
+{
+	pin->rcu = rcu;
+	pin->idx = __atomic_load_n(&rcu->epoch, __ATOMIC_RELAXED) & 1;
+	__atomic_fetch_add(&rcu->readers[pin->idx], 1, __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&rcu->current, __ATOMIC_SEQ_CST);
+}
+
+static inline void config_rcu_unpin(struct config_pin *pin)
+{
+	__atomic_fetch_sub(&pin->rcu->readers[pin->idx], 1, __ATOMIC_RELEASE);
+}
+
+/* publishes value, NULL to retire, and frees the old snapshot */
+extern void config_rcu_publish(struct config_rcu *rcu, void *value);
+
+/*
+ * Reloads path into rcu when its content changes. The directory of path is
+ * watched with inotify; once events have stopped for 100ms, the file is
+ * fingerprinted and, if it changed, reloaded by reload() on the thread of the
+ * watch, then notify() is called with the new value pinned. path is loaded
+ * once before config_watch_start() returns. config_watch_stop() returns arg.
+ */
+struct config_watch;
+
+extern struct config_watch *config_watch_start(const char *path,
+		struct config_rcu *rcu,
+		int (*reload)(const char *path, const char **err_msg),
+		void (*notify)(const void *value, void *arg), void *arg,
+		const char **err_msg);
+extern void *config_watch_stop(struct config_watch *w);
+
+/*
+ * Output buffer of config_dump_*_to_buffer.
+ * A growable buffer is realloc()ed as needed, the caller frees data.
+ * A fixed buffer is never reallocated, the output is truncated instead.
+ * The output is always terminated by '\0', which is not counted in len.
+ */
+#define DUMP_BUFFER_GROW	(1 << 0)
+#define DUMP_BUFFER_COMPACT	(1 << 1)	/* no indentation and newlines */
+
+struct dump_buffer {
+	char *data;
+	size_t len;
+	size_t cap;
+	int flags;
+	int err;
+};
+
+struct dump_context;
+
+extern void dump_buffer_init(struct dump_buffer *buf, char *mem, size_t size,
+		int flags);
+extern int dump_buffer_grow(struct dump_buffer *buf, size_t n);
+extern int dump_buffer_finish(struct dump_buffer *buf);
+extern void dump_buffer_indent(struct dump_buffer *buf, int indents);
+extern void dump_buffer_put_ll(struct dump_buffer *buf, long long val);
+extern void dump_buffer_put_ull(struct dump_buffer *buf, unsigned long long val);
+/* put_func for dump functions without a buffered version */
+extern void dump_buffer_printf(struct dump_context *ctx, const char *fmt, ...);
+
+static inline void dump_buffer_put(struct dump_buffer *buf, const char *s,
+		size_t n)
+{
+	if (buf->cap - buf->len <= n && dump_buffer_grow(buf, n)) {
+		n = buf->cap > buf->len ? buf->cap - buf->len - 1 : 0;
+	}
+	memcpy(buf->data + buf->len, s, n);
+	buf->len += n;
+}
+
+#define dump_buffer_puts(buf, str) dump_buffer_put(buf, str, sizeof(str) - 1)
+
+static inline void dump_buffer_putc(struct dump_buffer *buf, char c)
+{
+	if (buf->cap - buf->len > 1 || !dump_buffer_grow(buf, 1)) {
+		buf->data[buf->len++] = c;
+	}
+}
+
+static inline void dump_buffer_newline(struct dump_buffer *buf)
+{
+	if (!(buf->flags & DUMP_BUFFER_COMPACT)) {
+		dump_buffer_putc(buf, '\n');
+	}
+}
+
+/*
+ * A converted value packed into one block, see config_pack_<name>.
+ * pack__* is called to size the block (base is NULL), to copy the arrays and
+ * strings of the value into it, and by config_clone_packed_<name> to move the
+ * pointers of a copy of a block by delta (reloc).
+ */
+struct config_pack {
+	char *base;
+	size_t len;
+	intptr_t delta;
+	int reloc;
+};
+
+/*
+ * where the size bytes at src go in the block, aligned to align; they are
+ * copied unless sizing, when NULL is returned. A pack hook sets its pointer
+ * to the result if base is not NULL.
+ */
+static inline void *config_pack_ptr(struct config_pack *p, const void *src,
+		size_t size, size_t align)
+{
+	void *dst;
+
+	if (!src) {
+		return NULL;
+	}
+	if (p->reloc) {
+		return (void *)((uintptr_t)src + p->delta);
+	}
+	p->len = (p->len + align - 1) & ~(align - 1);
+	dst = p->base ? p->base + p->len : NULL;
+	if (dst) {
+		memcpy(dst, src, size);
+	}
+	p->len += size;
+	return dst;
+}
+
+/*
+ * Structural hashes of converted values, see config_hash_<name>.
+ * A tree keeps the hash of each struct, union and array of them in
+ * pre-order, with the index of the node after its subtree, so that a diff
+ * of two trees skips the subtrees whose hashes are equal.
+ */
+#define CONFIG_HASH_BASIS	14695981039346656037ULL
+
+struct config_hash {
+	uint64_t *hash;
+	long *next;
+	long n;
+	long cap;
+	int err;	/* -ENOMEM if a node could not be added */
+};
+
+#define CONFIG_HASH_INITIALIZER { NULL, NULL, 0, 0, 0 }
+
+extern void config_hash_free(struct config_hash *tree);
+/* index of a new node, -1 without a tree or on error */
+extern long config_hash_push(struct config_hash *tree);
+/* FNV-1a of n bytes, continued from h */
+extern uint64_t config_hash_bytes(uint64_t h, const void *p, size_t n);
+
+static inline void config_hash_set(struct config_hash *tree, long i,
+		uint64_t h)
+{
+	if (i >= 0) {
+		tree->hash[i] = h;
+		tree->next[i] = tree->n;
+	}
+}
+
+/* combines the hash of the next child into h */
+static inline uint64_t config_hash_mix(uint64_t h, uint64_t v)
+{
+	v *= 0x87c37b91114253d5ULL;
+	v = v << 31 | v >> 33;
+	v *= 0x4cf5ad432745937fULL;
+	h ^= v;
+	h = h << 27 | h >> 37;
+	return h * 5 + 0x52dce729;
+}
+
+/*
+ * Fingerprint of the syntax tree of value: the same for the same text,
+ * whatever the file or the position in it, and never 0. A converted struct
+ * depends only on its syntax tree, so config_reparse_<name> takes over the
+ * struct converted from a tree of the same fingerprint.
+ * The fingerprints of lists of members are kept in ctx->fps, allocated from
+ * ctx->pool, so that nested structs are walked once.
+ */
+extern uint64_t node_fingerprint(struct pass_to_conv *ctx,
+		const struct node_value *value);
+
+/*
+ * State of config_diff_<name>: the trees of both sides, the path of the
+ * value being compared, and the callback for each changed path.
+ */
+struct config_diff {
+	const struct config_hash *a;
+	const struct config_hash *b;
+	char *path;
+	size_t len;
+	size_t cap;
+	long count;
+	int err;
+	void (*changed)(const char *path, void *arg);
+	void *arg;
+};
+
+/* appends to the path, returns the length to restore */
+extern size_t config_diff_enter(struct config_diff *d, const char *fmt, ...);
+extern void config_diff_leave(struct config_diff *d, size_t len);
+/* reports the path followed by fmt, which may be NULL */
+extern void config_diff_report(struct config_diff *d, const char *fmt, ...);
+
+
+/*
+ * Subscriptions to subtrees of a published config, see
+ * config_subscribe_<name>. lock serializes reloads and changes to the list,
+ * tree is the hash tree of the current snapshot, kept while there are
+ * subscriptions.
+ */
+struct config_sub;
+
+struct config_subs {
+	pthread_mutex_t lock;
+	struct config_sub *list;
+	struct config_hash tree;
+};
+
+#define CONFIG_SUBS_INITIALIZER \
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, CONFIG_HASH_INITIALIZER }
+
+extern struct config_sub *config_sub_add(struct config_subs *subs,
+		const char *path, void (*notify)(const void *value, void *arg),
+		void *arg);
+/* returns arg */
+extern void *config_sub_remove(struct config_subs *subs,
+		struct config_sub *sub);
+/*
+ * changed() of config_diff_<name>: marks the subscriptions to path, to a
+ * member of it or to a value containing it; all of them if path is NULL
+ */
+extern void config_sub_changed(const char *path, void *subs);
+/* calls notify() of the marked subscriptions with the value of rcu pinned */
+extern void config_subs_notify(struct config_subs *subs,
+		struct config_rcu *rcu);
+
+
+/*
+ * Elements converted from the files of a directory, see
+ * config_load_dir_<name>_<member>. Each file is remembered with its device,
+ * inode, size, mtime, content fingerprint and the index of its element.
+ */
+struct config_dir;
+
+extern struct config_dir *config_dir_new(void);
+extern void config_dir_free(struct config_dir *dir);
+/*
+ * Converts the regular files of path, except those whose name starts with
+ * '.', to an array of elements of size bytes ordered by file name. A file
+ * unchanged since the last load takes over its element of old, the array of
+ * that load; the other files are converted by convert() on up to nthreads
+ * threads. On success *elems is malloc()ed and the elements taken over are
+ * remembered until config_dir_untaken(); on failure dir is unchanged.
+ */
+extern int config_dir_load(struct config_dir *dir, const char *path,
+		const void *old, long old_len, size_t size,
+		int (*convert)(void *elem, const char *path,
+			const char **err_msg),
+		void (*free_elem)(void *elem), int nthreads,
+		void **elems, long *len, const char **err_msg);
+/*
+ * moves the elements of old not taken over by the last load to the front,
+ * returns their number
+ */
+extern long config_dir_untaken(struct config_dir *dir, void *old,
+		long old_len, size_t size);
 
 #endif
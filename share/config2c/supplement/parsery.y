@@ -1,6 +1,8 @@
 %{
 
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include "parser.h"
 
 #undef PARSE_DEBUG
@@ -23,6 +25,9 @@ struct node_value *create_node_val(struct pass_to_bison *opaque,
 		return NULL;
 	}
 	ret->parent = NULL;
+	ret->anchored = 0;
+	ret->merged = 0;
+	ret->lower = 0;
 	switch (type) {
 	case VAL_SCALE_IDEN:
 		ret->type = VAL_SCALE_IDEN;
@@ -49,15 +54,227 @@ struct node_value *create_node_val(struct pass_to_bison *opaque,
 		ret->string_str = val_str;
 		PDBG("value:str:%p, str:%p\n", ret, ret->string_str);
 		break;
+	case VAL_BLOB_HEX:
+	case VAL_BLOB_BASE64:
+		ret->type = type;
+		ret->blob_str = val_str;
+		PDBG("value:blob:%p, str:%p\n", ret, ret->blob_str);
+		break;
 	default: /* should never reach here */
 		PDBG("impossible");
 	}
 	return ret;
 }
 
+static void run_error(struct pass_to_bison *opaque, const char *msg)
+{
+	opaque->ok = 0;
+	opaque->myerrno = -EINVAL;
+	opaque->err_reason = make_message("%d:%d : %s",
+			opaque->first_line, opaque->first_column, msg);
+}
+
+/* integer literal of a run, the lexer only passes C integer syntax */
+static int run_int(const char *str, long long *out)
+{
+	char *end;
+	errno = 0;
+	*out = strtoll(str, &end, 0);
+	return errno || strspn(end, "uUlL") != strlen(end) ? -1 : 0;
+}
+
+struct node_value *create_node_run(struct pass_to_bison *opaque,
+		struct node_value *value, long count, long long first, int step)
+{
+	struct node_value *ret;
+	struct node_run *run;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
+	run = mem_pool_alloc(opaque->pool, sizeof(*run));
+	if (!ret || !run) {
+		opaque->ok = 0;
+		opaque->myerrno = -ENOMEM;
+		return NULL;
+	}
+	ret->type = VAL_RUN;
+	ret->run = run;
+	ret->parent = NULL;
+	ret->anchored = 0;
+	ret->merged = 0;
+	ret->lower = 0;
+	run->value = value;
+	run->count = count;
+	run->first = first;
+	run->step = step;
+	PDBG("value:run:%p, value:%p, count:%ld\n", ret, value, count);
+	return ret;
+}
+
+struct node_value *create_node_repeat(struct pass_to_bison *opaque,
+		struct node_value *value, const char *count_str)
+{
+	long long count;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	if (run_int(count_str, &count) || count < 1 || count > LONG_MAX) {
+		run_error(opaque, "invalid repeat count");
+		return NULL;
+	}
+	value->anchored = 1;	/* converted once for shared structs */
+	return create_node_run(opaque, value, count, 0, 0);
+}
+
+struct node_value *create_node_range(struct pass_to_bison *opaque,
+		const char *first_str, const char *last_str)
+{
+	long long first, last;
+	unsigned long long count;
+	struct node_value *first_val;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	if (run_int(first_str, &first) || run_int(last_str, &last)) {
+		run_error(opaque, "range out of bounds");
+		return NULL;
+	}
+	count = first <= last ? (unsigned long long)last - first :
+		(unsigned long long)first - last;
+	if (count >= LONG_MAX) {
+		run_error(opaque, "range too large");
+		return NULL;
+	}
+	first_val = create_node_val(opaque, VAL_SCALE_INT, first_str);
+	return create_node_run(opaque, first_val, count + 1, first,
+			first <= last ? 1 : -1);
+}
+
+static struct node_anchor *lookup_anchor(struct pass_to_bison *opaque,
+		const char *name)
+{
+	struct node_anchor *p;
+	for (p = opaque->anchors; p; p = p->next) {
+		if (!strcmp(p->name, name)) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+struct node_value *create_node_anchor(struct pass_to_bison *opaque,
+		const char *name, struct node_value *value)
+{
+	struct node_anchor *ret;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	if (lookup_anchor(opaque, name)) { /* defined inside its own value */
+		run_error(opaque, "anchor is already defined");
+		return NULL;
+	}
+	ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
+	if (!ret) {
+		opaque->ok = 0;
+		opaque->myerrno = -ENOMEM;
+		return NULL;
+	}
+	ret->name = name;
+	ret->value = value;
+	ret->next = opaque->anchors;
+	opaque->anchors = ret;
+	value->anchored = 1;
+	PDBG("anchor:%p, name:%s, value:%p\n", ret, name, value);
+	return value;
+}
+
+/* a new node for the place of the reference, sharing the subtree */
+struct node_value *create_node_ref(struct pass_to_bison *opaque,
+		const char *name)
+{
+	struct node_anchor *anchor;
+	struct node_value *ret;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	anchor = lookup_anchor(opaque, name);
+	if (!anchor) {
+		run_error(opaque, "undefined anchor");
+		return NULL;
+	}
+	ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
+	if (!ret) {
+		opaque->ok = 0;
+		opaque->myerrno = -ENOMEM;
+		return NULL;
+	}
+	*ret = *anchor->value;
+	ret->parent = NULL;
+	PDBG("value:ref:%p, anchor:%p\n", ret, anchor->value);
+	return ret;
+}
+
 void yyerror(void * scanner, struct pass_to_bison *opaque, const char *msg);
 #pragma GCC diagnostic ignored "-Wimplicit-function-declaration"
 
+
+/* names of a member path, the last one first */
+static struct node_members *create_path(struct pass_to_bison *opaque,
+		struct node_members *path, const char *name)
+{
+	struct node_members *ret;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
+	if (!ret) {
+		opaque->ok = 0;
+		opaque->myerrno = -ENOMEM;
+		return NULL;
+	}
+	ret->next = path;
+	ret->name = name;
+	ret->value = NULL;
+	return ret;
+}
+
+/* .a.b.c = value is the member a = { .b = { .c = value, }, } */
+static struct node_members *create_node_member(struct pass_to_bison *opaque,
+		struct node_members *list, struct node_members *path,
+		struct node_value *value)
+{
+	struct node_members *next;
+	struct node_value *wrap;
+	if (!opaque->ok) {
+		return NULL;
+	}
+	while (path->next) {
+		next = path->next;
+		wrap = mem_pool_alloc(opaque->pool, sizeof(*wrap));
+		if (!wrap) {
+			opaque->ok = 0;
+			opaque->myerrno = -ENOMEM;
+			return NULL;
+		}
+		path->next = NULL;
+		path->value = value;
+		wrap->type = VAL_MEMBERS;
+		wrap->members = path;
+		wrap->anchored = 0;
+		wrap->merged = 0;
+		wrap->lower = 0;
+		wrap->parent = NULL;
+		set_parent_members(path, wrap);
+		value = wrap;
+		path = next;
+	}
+	path->value = value;
+	path->next = list;
+	PDBG("members:cons:%p, name:%p, value:%p, next:%p\n",
+			path, path->name, path->value, path->next);
+	return path;
+}
 %}
 
 %define api.pure full
@@ -69,14 +286,19 @@ void yyerror(void * scanner, struct pass_to_bison *opaque, const char *msg);
 %lex-param {struct pass_to_bison *opaque}
 
 %token ERROR;
+%token ELLIPSIS
 %token <iden_str> IDEN
 %token <char_str> CHAR
 %token <int_str> INT
 %token <float_str> FLOAT
 %token <string_str> STRING
+%token <blob_str> HEX_BLOB
+%token <blob_str> B64_BLOB
 
 %type <members> members
+%type <members> path
 %type <elems> elems
+%type <value> elem
 %type <value> value
 %type <value> scale
 
@@ -97,25 +319,17 @@ members
 		$$ = NULL;
 		PDBG("members:nil\n");
 	}
-	| members '.' IDEN '=' value ',' {
-		if (opaque->ok) {
-			struct node_members *ret = mem_pool_alloc(opaque->pool, sizeof(*ret));
-			PDBG("ok: %d, myerrno: %d, output: %p\n", opaque->ok,
-					opaque->myerrno, opaque->output);
-			if (!ret) {
-				opaque->ok = 0;
-				opaque->myerrno = -ENOMEM;
-			} else {
-				ret->next = $1;
-				ret->name = $3;
-				ret->value = $5;
-				PDBG("members:cons:%p, name:%p, value:%p, next:%p\n",
-						ret, ret->name, ret->value, ret->next);
-			}
-			$$ = ret;
-		} else {
-			$$ = NULL;
-		}
+	| members '.' path '=' value ',' {
+		$$ = create_node_member(opaque, $1, $3, $5);
+	}
+	;
+
+path
+	: IDEN {
+		$$ = create_path(opaque, NULL, $1);
+	}
+	| path '.' IDEN {
+		$$ = create_path(opaque, $1, $3);
 	}
 	;
 
@@ -124,7 +338,7 @@ elems
 		$$ = NULL;
 		PDBG("elems:nil\n");
 	}
-	| elems value ',' {
+	| elems elem ',' {
 		if (opaque->ok) {
 			struct node_elems *ret =
 				mem_pool_alloc(opaque->pool, sizeof(*ret));
@@ -146,10 +360,42 @@ elems
 	}
 	;
 
+elem
+	: value {
+		$$ = $1;
+	}
+	| value '*' INT {
+		$$ = create_node_repeat(opaque, $1, $3);
+	}
+	| INT ELLIPSIS INT {
+		$$ = create_node_range(opaque, $1, $3);
+	}
+	;
+
 value
 	: scale {
 		$$ = $1;
 	}
+	| '&' IDEN {
+		if (opaque->ok && lookup_anchor(opaque, $2)) {
+			run_error(opaque, "anchor is already defined");
+		}
+	} value {
+		$$ = create_node_anchor(opaque, $2, $4);
+	}
+	| '*' IDEN {
+		$$ = create_node_ref(opaque, $2);
+	}
+	| IDEN STRING {
+		if (!opaque->ok) {
+			$$ = NULL;
+		} else if (strcmp($1, "include")) {
+			run_error(opaque, "syntax error, unexpected STRING");
+			$$ = NULL;
+		} else {
+			$$ = include_file(opaque, $2);
+		}
+	}
 	| '{' members '}' {
 		if (opaque->ok) {
 			struct node_value *ret;
@@ -165,6 +411,9 @@ value
 				ret->members = rev_node_members($2);
 				set_parent_members(ret->members, ret);
 				ret->parent = NULL;
+				ret->anchored = 0;
+				ret->merged = 0;
+				ret->lower = 0;
 				PDBG("value:members:%p, members:%p\n",
 						ret, ret->members);
 				PDBG("list: ");
@@ -189,10 +438,16 @@ value
 				opaque->ok = 0;
 				opaque->myerrno = -ENOMEM;
 			} else {
+				if (count_node_elems($2) < 0) {
+					run_error(opaque, "array too large");
+				}
 				ret->type = VAL_ELEMS;
 				ret->elems = rev_node_elems($2);
 				set_parent_elems(ret->elems, ret);
 				ret->parent = NULL;
+				ret->anchored = 0;
+				ret->merged = 0;
+				ret->lower = 0;
 				PDBG("value:elems:%p, elems:%p\n",
 						ret, ret->elems);
 				PDBG("list: ");
@@ -225,6 +480,12 @@ scale
 	| STRING {
 		$$ = create_node_val(opaque, VAL_SCALE_STRING, $1);
 	}
+	| HEX_BLOB {
+		$$ = create_node_val(opaque, VAL_BLOB_HEX, $1);
+	}
+	| B64_BLOB {
+		$$ = create_node_val(opaque, VAL_BLOB_BASE64, $1);
+	}
 	;
 
 %%